@@ -0,0 +1,296 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación del piloto automático.
+ */
+
+#include "autopilot.hpp"
+
+//Bits de la matriz de objetos utilizados durante la búsqueda
+#define SCRATCH_VISITED 0x04
+#define SCRATCH_PARENT_SHIFT 3
+#define SCRATCH_PARENT_MASK 0x18
+#define SCRATCH_FRONT_A 0x20
+#define SCRATCH_FRONT_B 0x40
+
+Autopilot::Autopilot(Board* board, bool bitmaps){
+	this->matrix = (byte*)board->itemMatrix;
+	this->horizontalCount = board->horizontalCount;
+	this->verticalCount = board->verticalCount;
+	this->totalCount = board->totalCount;
+	this->board = board;
+	this->snake = &board->snakes[0];
+	this->reach = bitmaps ? new Reachability(horizontalCount, verticalCount, false) : null;
+	//El zigzag atraviesa todas las celdas, así que no sirve si hay muros
+	this->cycleAvailable = board->openCount == totalCount && hamiltonian(0) != None;
+}
+
+Autopilot::~Autopilot(){
+	delete reach;
+}
+
+Direction Autopilot::decide(Direction current, int coin){
+	unsigned long start = micros();
+	int head = snake->headIndex;
+	Direction result = None;
+
+	if (snake->blocks->size() != lastLength){
+		lastLength = snake->blocks->size();
+		hungrySteps = 0;
+	}
+
+	//Si la serpiente lleva demasiado tiempo sin comer, es que está dando vueltas
+	//sin llegar a la moneda: en cuanto sea seguro, pasa a seguir el ciclo
+	//hamiltoniano, que acaba pasando por todas las celdas, hasta el final de la
+	//partida. Una vez que todo el cuerpo está sobre el ciclo, detrás de la
+	//cabeza, seguirlo nunca choca.
+	if (hungrySteps > totalCount && cycleAvailable && !onCycle && cycleSafe(coin)){
+		onCycle = true;
+	}
+	if (onCycle){
+		Direction d = hamiltonian(head);
+		if (passable(neighbor(head, d))){
+			result = d;
+		}else{
+			//Una moneda nueva ha retrasado la cola más de lo previsto
+			onCycle = false;
+		}
+	}
+
+	//1. Camino más corto hasta la moneda, si es seguro
+	if (result == None && hungrySteps <= totalCount){
+		if (coin >= 0 && search(head, coin)){
+			Direction d = firstStep(head, coin);
+			clearScratch();
+			if (safeMove(neighbor(head, d))){
+				result = d;
+			}
+		}else{
+			clearScratch();
+		}
+	}
+
+	//Sin camino seguro a la moneda, el ciclo es la mejor opción si ya se puede seguir
+	if (result == None && cycleAvailable && cycleSafe(coin)){
+		onCycle = true;
+		result = hamiltonian(head);
+	}
+
+	//2. Cualquier movimiento tras el que se pueda seguir alcanzando la cola,
+	//empezando por el del ciclo hamiltoniano. 3. Cualquier movimiento que no
+	//sea mortal en este mismo paso.
+	if (result == None){
+		Direction fallback = None;
+		Direction ham = cycleAvailable ? hamiltonian(head) : None;
+		for (byte i = 0; i <= Down && result == None; i++){
+			Direction d = i == 0 ? ham : (Direction)i;
+			if (d == None || d == direction_opposite(current)) continue;
+
+			int next = neighbor(head, d);
+			if (next < 0 || !passable(next)) continue;
+			if (fallback == None){
+				fallback = d;
+			}
+			if (safeMove(next)){
+				result = d;
+			}
+		}
+		if (result == None){
+			result = fallback != None ? fallback : current;
+		}
+	}
+	hungrySteps++;
+
+	unsigned long elapsed = micros() - start;
+	if (elapsed > maxDecisionTime){
+		maxDecisionTime = elapsed;
+	}
+	return result;
+}
+
+int Autopilot::neighbor(int index, Direction d){
+	switch(d){
+	case Left:
+		return index % horizontalCount == 0 ? -1 : index - 1;
+	case Right:
+		return index % horizontalCount == horizontalCount - 1 ? -1 : index + 1;
+	case Up:
+		return index < horizontalCount ? -1 : index - horizontalCount;
+	case Down:
+		return index >= totalCount - horizontalCount ? -1 : index + horizontalCount;
+	default:
+		return -1;
+	}
+}
+
+bool Autopilot::passable(int index){
+	return (matrix[index] & ITEM_TYPE_MASK) < SnakeObject;
+}
+
+/*
+ * Búsqueda en anchura desde from hasta target (que se considera libre aunque
+ * sea parte de la serpiente). Cada celda alcanzada guarda la dirección desde
+ * la que se llegó a ella. Las marcas deben borrarse con clearScratch.
+ */
+bool Autopilot::search(int from, int target){
+	matrix[from] |= SCRATCH_VISITED | SCRATCH_FRONT_A;
+	byte front = SCRATCH_FRONT_A;
+	byte nextFront = SCRATCH_FRONT_B;
+
+	//Rango de índices del frente actual, para no recorrer toda la matriz
+	int lo = from;
+	int hi = from;
+	while (lo <= hi){
+		int nextLo = totalCount;
+		int nextHi = -1;
+		//La columna se mantiene de forma incremental para no dividir en cada celda
+		int x = lo % horizontalCount;
+		for (int i = lo; i <= hi; i++, x = x == horizontalCount - 1 ? 0 : x + 1){
+			if (!(matrix[i] & front)) continue;
+			matrix[i] &= ~front;
+
+			for (byte d = Left; d <= Down; d++){
+				int n;
+				switch(d){
+				case Left: n = x == 0 ? -1 : i - 1; break;
+				case Right: n = x == horizontalCount - 1 ? -1 : i + 1; break;
+				case Up: n = i - horizontalCount; break;
+				default: n = i + horizontalCount; if (n >= totalCount) n = -1; break;
+				}
+				if (n < 0 || (matrix[n] & SCRATCH_VISITED)) continue;
+				if (n != target && !passable(n)) continue;
+
+				matrix[n] |= SCRATCH_VISITED | nextFront | ((d - 1) << SCRATCH_PARENT_SHIFT);
+				if (n == target) return true;
+				if (n < nextLo) nextLo = n;
+				if (n > nextHi) nextHi = n;
+			}
+		}
+		lo = nextLo;
+		hi = nextHi;
+		byte b = front;
+		front = nextFront;
+		nextFront = b;
+	}
+	return false;
+}
+
+/*
+ * Indica si, tras mover la cabeza a la celda next, la serpiente aún puede
+ * alcanzar su cola (véase Reachability::safeMove). Sin el núcleo, lo comprueba
+ * con la búsqueda en anchura.
+ */
+bool Autopilot::safeMove(int next){
+	if (reach != null){
+		return reach->safeMove(board, snake, next);
+	}
+	int tail = board->indexOf(*snake->blocks->peek());
+	bool safe = search(next, tail);
+	clearScratch();
+	//Si no come, la cola deja libre su celda: también basta con llegar al bloque
+	//siguiente sin pasar por ella (si se pasa, ya se ha llegado a la cola)
+	if (!safe && (matrix[next] & ITEM_TYPE_MASK) != Coin){
+		safe = search(next, board->indexOf(*snake->blocks->itemAtHeadOffset(1)));
+		clearScratch();
+	}
+	return safe;
+}
+
+/*
+ * Reconstruye, tras una búsqueda con éxito, la dirección del primer paso
+ * desde from hacia target.
+ */
+Direction Autopilot::firstStep(int from, int target){
+	int cell = target;
+	while (true){
+		Direction d = (Direction)(((matrix[cell] & SCRATCH_PARENT_MASK) >> SCRATCH_PARENT_SHIFT) + 1);
+		int prev = neighbor(cell, direction_opposite(d));
+		if (prev == from) return d;
+		cell = prev;
+	}
+}
+
+void Autopilot::clearScratch(){
+	for (int i = 0; i < totalCount; i++){
+		matrix[i] &= ITEM_TYPE_MASK;
+	}
+}
+
+/*
+ * Devuelve la posición de la celda index en el ciclo hamiltoniano, contando
+ * desde la esquina superior izquierda en el sentido de hamiltonian().
+ */
+int Autopilot::cyclePosition(int index){
+	int x = index % horizontalCount;
+	int y = index / horizontalCount;
+	int w = horizontalCount;
+	int h = verticalCount;
+	if (h % 2 != 0){
+		//El ciclo es el mismo con los ejes intercambiados
+		int t = x; x = y; y = t;
+		t = w; w = h; h = t;
+	}
+
+	if (x > 0){
+		return 1 + y * (w - 1) + (y % 2 == 0 ? x - 1 : w - 1 - x);
+	}
+	return y == 0 ? 0 : h * (w - 1) + h - y;
+}
+
+/*
+ * Indica si la serpiente puede seguir el ciclo desde la cabeza sin chocar: el
+ * bloque i (desde la cola) se libera en el paso i + 1, y la cabeza solo puede
+ * entrar en él en un paso posterior. Comer la moneda retrasa la cola un paso.
+ */
+bool Autopilot::cycleSafe(int coin){
+	int head = cyclePosition(snake->headIndex);
+	int coinDistance = coin >= 0 ? (cyclePosition(coin) - head + totalCount) % totalCount : totalCount;
+	BufferedQueue<Cell>* blocks = snake->blocks;
+	for (size_t i = 0; i + 1 < blocks->size(); i++){
+		int distance = (cyclePosition(board->indexOf(*blocks->itemAtHeadOffset(i))) - head + totalCount) % totalCount;
+		if ((int)i + 2 + (coinDistance < distance ? 1 : 0) > distance){
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Devuelve la dirección que seguiría la celda index en un ciclo hamiltoniano
+ * del tablero (un recorrido en zigzag que vuelve por la primera columna o fila).
+ * Solo existe si alguna de las dimensiones del tablero es par.
+ */
+Direction Autopilot::hamiltonian(int index){
+	int x = index % horizontalCount;
+	int y = index / horizontalCount;
+	int w = horizontalCount;
+	int h = verticalCount;
+
+	if (h % 2 == 0){
+		if (x == 0) return y == 0 ? Right : Up;
+		if (y % 2 == 0) return x < w - 1 ? Right : Down;
+		return x > 1 || y == h - 1 ? Left : Down;
+	}else if (w % 2 == 0){
+		if (y == 0) return x == 0 ? Down : Left;
+		if (x % 2 == 0) return y < h - 1 ? Down : Right;
+		return y > 1 || x == w - 1 ? Up : Right;
+	}
+	return None;
+}
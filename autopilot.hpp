@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración del piloto automático, que juega solo
+ * para el modo demostración del menú principal y para las pruebas de larga
+ * duración.
+ *
+ * En cada paso, el piloto busca el camino más corto hasta la moneda (búsqueda
+ * en anchura) y solo lo sigue si, después de dar el primer paso, la serpiente
+ * todavía puede alcanzar su propia cola (véase reach.hpp). Si no, elige
+ * cualquier movimiento tras el que siga alcanzándola. Si lleva demasiado tiempo
+ * sin comer, pasa a seguir un ciclo hamiltoniano del tablero (un zigzag) hasta
+ * el final de la partida, lo que le garantiza llenar el tablero. En los niveles
+ * con muros y en los tableros con las dos dimensiones impares no hay zigzag: si
+ * el piloto se queda dando vueltas, stalled() lo indica.
+ *
+ * La búsqueda no reserva memoria adicional: sus marcas se guardan en los bits
+ * libres de cada celda de la matriz de objetos del juego (los tipos de objeto
+ * solo usan los dos bits inferiores), y se borran al terminar. La búsqueda se
+ * realiza por frentes de onda, recorriendo la matriz una vez por cada nivel de
+ * distancia, por lo que no necesita una cola. La comprobación de seguridad
+ * utiliza los mapas de bits del núcleo de alcanzabilidad, que sí reservan
+ * memoria (Reachability::ramNeeded); si no hay bastante, se hace con la misma
+ * búsqueda en anchura, más lenta, y sin reservar nada.
+ */
+
+#ifndef autopilot_hpp
+#define autopilot_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "board.hpp"
+#include "reach.hpp"
+
+//Pasos sin comer, en múltiplos del número de celdas, tras los que el piloto se da por atascado
+#define AUTOPILOT_STALL_FACTOR 4
+
+class Autopilot {
+public:
+	//Si bitmaps es false, no se reserva el núcleo de alcanzabilidad
+	Autopilot(Board* board, bool bitmaps = true);
+	~Autopilot();
+
+	//Decide la dirección del siguiente paso, conociendo la dirección actual y
+	//la celda de la moneda (-1 si no hay moneda)
+	Direction decide(Direction current, int coin);
+
+	/*
+	 * Indica si la serpiente lleva AUTOPILOT_STALL_FACTOR veces el número de
+	 * celdas del tablero sin comer. Siguiendo el ciclo come siempre antes, así
+	 * que solo ocurre en los tableros sin ciclo (con muros, o con las dos
+	 * dimensiones impares); quien use el piloto debe terminar la partida.
+	 */
+	inline bool stalled(){
+		return hungrySteps > AUTOPILOT_STALL_FACTOR * totalCount;
+	}
+
+	//El tiempo máximo, en microsegundos, que ha tardado una decisión
+	unsigned long maxDecisionTime = 0;
+
+	//El tiempo máximo, en microsegundos, que ha tardado un relleno del núcleo de
+	//alcanzabilidad (0 si no se utiliza)
+	inline unsigned long maxFillTime(){
+		return reach != null ? reach->maxFillTime : 0;
+	}
+private:
+	byte* matrix;
+	int horizontalCount;
+	int verticalCount;
+	int totalCount;
+	Board* board;
+	//La serpiente que controla el piloto (la primera del tablero)
+	Snake* snake;
+	//Como la búsqueda, no cruza los bordes aunque el tablero no los tenga. Es
+	//null si no había memoria para él
+	Reachability* reach;
+
+	//Pasos desde la última vez que la serpiente comió
+	size_t lastLength = 0;
+	int hungrySteps = 0;
+	//El tablero tiene ciclo hamiltoniano, y la serpiente lo está siguiendo
+	bool cycleAvailable;
+	bool onCycle = false;
+
+	int neighbor(int index, Direction d);
+	bool passable(int index);
+	bool search(int from, int target);
+	bool safeMove(int next);
+	Direction firstStep(int from, int target);
+	void clearScratch();
+	Direction hamiltonian(int index);
+	int cyclePosition(int index);
+	bool cycleSafe(int coin);
+};
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de las reglas del juego.
+ */
+
+#include "board.hpp"
+
+//Tamaño aproximado de la cola de una serpiente sin su buffer (objeto + cabecera de malloc)
+#define BOARD_QUEUE_OVERHEAD 16
+
+Board::Board(int horizontalCount, int verticalCount, bool wrap, byte snakeCount){
+	this->horizontalCount = horizontalCount;
+	this->verticalCount = verticalCount;
+	this->totalCount = horizontalCount * verticalCount;
+	this->wrap = wrap;
+	this->snakeCount = snakeCount;
+
+	//Al salir por un borde, la coordenada pasa al extremo opuesto del eje
+	int lastColumn = horizontalCount - 1;
+	int lastRow = verticalCount - 1;
+	edges[None] = {false, 0, 0, 0xFF, 0, 0};
+	edges[Left] = {false, -1, -1, 0, (byte)lastColumn, lastColumn};
+	edges[Right] = {false, 1, 1, (byte)lastColumn, 0, -lastColumn};
+	edges[Up] = {true, -1, -horizontalCount, 0, (byte)lastRow, lastRow * horizontalCount};
+	edges[Down] = {true, 1, horizontalCount, (byte)lastRow, 0, -lastRow * horizontalCount};
+
+	for (byte i = 0; i < snakeCount; i++){
+		snakes[i].blocks = new BufferedQueue<Cell>(totalCount);
+	}
+	itemMatrix = new InGameItemType[totalCount];
+}
+
+Board::~Board(){
+	delete[] itemMatrix;
+	for (byte i = 0; i < snakeCount; i++){
+		delete snakes[i].blocks;
+	}
+}
+
+unsigned int Board::ramNeeded(unsigned int cells, byte snakeCount){
+	return cells * (sizeof(InGameItemType) + snakeCount * sizeof(Cell)) + snakeCount * BOARD_QUEUE_OVERHEAD;
+}
+
+void Board::reset(uint32_t seed, byte level){
+	rng.seed(seed);
+	memset(itemMatrix, 0, totalCount);
+
+	//Los muros se leen de la memoria flash por tramos, sin copiar el mapa
+	openCount = totalCount;
+	LevelDecoder walls(level, horizontalCount, verticalCount);
+	WallRun run;
+	while (walls.next(&run)){
+		for (byte y = run.y; y < run.y + run.h; y++){
+			memset(itemMatrix + y * horizontalCount + run.x, Wall, run.w);
+		}
+		openCount -= run.w * run.h;
+	}
+
+	//Introducir 3 bloques iniciales por serpiente: la primera en la esquina
+	//superior izquierda hacia la derecha, y la segunda en la inferior derecha
+	//hacia la izquierda. En los tableros pequeños, los muros del nivel pueden
+	//caer sobre ellos o sobre la celda siguiente: esos muros se quitan.
+	for (byte s = 0; s < snakeCount; s++){
+		Snake* snake = &snakes[s];
+		while (snake->blocks->size() > 0){
+			snake->blocks->pop();
+		}
+		Cell cell = {0, (byte)(s == 0 ? 0 : verticalCount - 1)};
+		for (byte i = 0; i < 4; i++){
+			cell.x = s == 0 ? i : horizontalCount - 1 - i;
+			int index = indexOf(cell);
+			if (itemMatrix[index] == Wall){
+				itemMatrix[index] = Empty;
+				openCount++;
+			}
+			if (i < 3){
+				snake->blocks->push(cell);
+				itemMatrix[index] = SnakeObject;
+				snake->head = cell;
+				snake->headIndex = index;
+			}
+		}
+		snake->direction = s == 0 ? Right : Left;
+		snake->tailFreed = false;
+		snake->score = 0;
+	}
+	occupied = 3 * snakeCount;
+	steps = 0;
+	movementDelay = maxMovementDelay;
+	regenCoin();
+}
+
+StepResult Board::step(Direction dir){
+	StepResult result;
+	stepAll(&dir, &result);
+	return result;
+}
+
+void Board::stepAll(const Direction* dirs, StepResult* results){
+	steps++;
+
+	//1. La siguiente celda de cada cabeza, comprobada contra el tablero actual
+	Cell next[BOARD_MAX_SNAKES];
+	int nextIndex[BOARD_MAX_SNAKES];
+	bool collision = false;
+	for (byte s = 0; s < snakeCount; s++){
+		Snake* snake = &snakes[s];
+		snake->direction = dirs[s];
+		snake->tailFreed = false;
+		next[s] = snake->head;
+		nextIndex[s] = snake->headIndex;
+
+		//Borde, serpiente o muro
+		if (!neighbor(dirs[s], &next[s], &nextIndex[s]) || itemMatrix[nextIndex[s]] >= SnakeObject){
+			results[s] = Collision;
+			collision = true;
+		}else{
+			results[s] = itemMatrix[nextIndex[s]] == Coin ? CoinEaten : Moved;
+		}
+	}
+
+	//2. Dos cabezas que entran en la misma celda chocan ambas (empate)
+	for (byte s = 1; s < snakeCount; s++){
+		for (byte o = 0; o < s; o++){
+			if (nextIndex[s] == nextIndex[o] && results[s] != Collision && results[o] != Collision){
+				results[s] = results[o] = Collision;
+				collision = true;
+			}
+		}
+	}
+	if (collision) return;
+
+	//3. Mover las serpientes. Las que no comen liberan la celda de su cola.
+	bool coinEaten = false;
+	for (byte s = 0; s < snakeCount; s++){
+		Snake* snake = &snakes[s];
+		snake->blocks->push(next[s]);
+		snake->head = next[s];
+		snake->headIndex = nextIndex[s];
+
+		if (results[s] == CoinEaten){
+			snake->score += 20 * snake->blocks->size();
+			occupied++;
+			coinEaten = true;
+		}else{
+			snake->score += snake->blocks->size();
+			snake->freedTail = *snake->blocks->pop();
+			snake->tailFreed = true;
+			itemMatrix[indexOf(snake->freedTail)] = Empty;
+		}
+		itemMatrix[snake->headIndex] = SnakeObject;
+	}
+
+	if (coinEaten){
+		//Resetear la coin, una vez que todas las cabezas ocupan su celda
+		regenCoin();
+
+		//Disminuir el delay, para aumentar la velocidad del juego
+		if ((movementDelay += movementDelta) < minMovementDelay){
+			movementDelay = minMovementDelay;
+		}
+	}
+
+	if (occupied == openCount){
+		//Pantalla sin espacio (El jugador ha ganado (olé sus huevos))
+		for (byte s = 0; s < snakeCount; s++){
+			results[s] = BoardFull;
+		}
+	}
+}
+
+void Board::clearSnake(byte s){
+	Snake* snake = &snakes[s];
+	while (snake->blocks->size() > 0){
+		itemMatrix[indexOf(*snake->blocks->pop())] = Empty;
+		occupied--;
+	}
+	snake->tailFreed = false;
+}
+
+void Board::growSnake(byte s, Cell cell, Direction direction){
+	Snake* snake = &snakes[s];
+	snake->blocks->push(cell);
+	snake->head = cell;
+	snake->headIndex = indexOf(cell);
+	snake->direction = direction;
+	itemMatrix[snake->headIndex] = SnakeObject;
+	occupied++;
+}
+
+void Board::placeCoin(Cell cell){
+	if (coinIndex != -1){
+		itemMatrix[coinIndex] = Empty;
+	}
+	coin = cell;
+	coinIndex = indexOf(cell);
+	itemMatrix[coinIndex] = Coin;
+}
+
+//FNV-1a de 32 bits
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+
+static inline uint32_t fnv_add(uint32_t hash, byte value){
+	return (hash ^ value) * FNV_PRIME;
+}
+
+//Los números se añaden byte a byte (big endian), para obtener el mismo hash en cualquier plataforma
+static inline uint32_t fnv_add_long(uint32_t hash, uint32_t value){
+	for (int8_t shift = 24; shift >= 0; shift -= 8){
+		hash = fnv_add(hash, value >> shift);
+	}
+	return hash;
+}
+
+uint32_t Board::hash(){
+	uint32_t h = FNV_OFFSET;
+	for (int i = 0; i < totalCount; i++){
+		h = fnv_add(h, itemMatrix[i]);
+	}
+	for (byte s = 0; s < snakeCount; s++){
+		Snake* snake = &snakes[s];
+		h = fnv_add(h, snake->head.x);
+		h = fnv_add(h, snake->head.y);
+		h = fnv_add(h, snake->direction);
+		h = fnv_add_long(h, snake->score);
+	}
+	return fnv_add_long(h, rng.state);
+}
+
+void Board::regenCoin(){
+	int randIndex = rng.range(openCount - occupied);
+	int c = 0;
+
+	/*
+	 * Teniendo en cuenta que la moneda no puede aparecer sobre un bloque ocupado
+	 * por una parte de la serpiente o por un muro, en los momentos avanzados de la partida,
+	 * cuando la serpiente es muy larga, un algoritmo que genere posiciones aleatorias
+	 * puede producir retrasos en el juego debido al elevado número de posibilidades
+	 * de que las coordenadas generadas puedan chocar con los bloques de la serpiente.
+	 *
+	 * Como alternativa se utilizará este método que, pese a que su complejidad es de O(n),
+	 * donde n es el número de bloques máximo de la pantalla de juego, consigue buenos
+	 * resultados en cuanto a rendimiento (En la Arduino Mega rev3 tarda < 1 ms).
+	 */
+	coinIndex = -1;
+	Cell cell = {0, 0};
+	for (int i = 0; i < totalCount; i++){
+		if (itemMatrix[i] == Empty){
+			if ((c++) == randIndex) {
+				coinIndex = i;
+				coin = cell;
+				break;
+			}
+		}
+		if (++cell.x == horizontalCount){
+			cell.x = 0;
+			cell.y++;
+		}
+	}
+
+	//Si el tablero está lleno no hay sitio para la moneda
+	if (coinIndex != -1){
+		itemMatrix[coinIndex] = Coin;
+	}
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de la clase Board, que implementa las
+ * reglas del juego (movimiento de las serpientes, colisiones, monedas, puntuación
+ * y velocidad) sin dibujar nada. GameScreen la utiliza para jugar en la pantalla,
+ * y, como no depende de la librería TFT ni del hardware, también puede compilarse
+ * fuera de Arduino (véase la carpeta host).
+ */
+
+#ifndef board_hpp
+#define board_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "levels.hpp"
+
+/*
+ * Define los posibles resultados de un paso de la serpiente
+ */
+enum StepResult : byte {
+	//La serpiente ha avanzado sin comer
+	Moved = 0,
+			//La serpiente ha comido una moneda
+			CoinEaten = 1,
+			//La serpiente ha chocado contra un borde, un muro, una serpiente o,
+			//en las partidas de dos jugadores, contra la cabeza de la otra
+			Collision = 2,
+			//Las serpientes ocupan todo el tablero (el jugador ha ganado)
+			BoardFull = 3
+};
+
+//Número máximo de serpientes en un tablero (partidas de dos jugadores)
+#define BOARD_MAX_SNAKES 2
+
+/*
+ * El estado de una serpiente. La cabeza es el final de la cola.
+ */
+typedef struct {
+	BufferedQueue<Cell>* blocks;
+	Cell head;
+	int headIndex;
+	Direction direction;
+	//La celda que liberó la cola en el último paso, si tailFreed es true
+	Cell freedTail;
+	bool tailFreed;
+	unsigned long score;
+} Snake;
+
+/*
+ * Describe cómo se mueve la cabeza en una dirección: en qué eje, cuánto cambian
+ * la coordenada y el índice lineal, en qué coordenada se sale del tablero y, en
+ * el modo sin bordes, dónde reaparece.
+ */
+typedef struct {
+	bool vertical;
+	int8_t delta;
+	int indexDelta;
+	//0xFF => la dirección nunca sale del tablero (None)
+	byte edge;
+	byte wrapped;
+	int wrapIndexDelta;
+} EdgeRule;
+
+class Board {
+public:
+	/*
+	 * Las dimensiones no pueden superar las 255 celdas (véase Cell). Si wrap es
+	 * true, la serpiente que sale por un borde reaparece por el opuesto. Con dos
+	 * serpientes, la segunda empieza en la última fila, avanzando hacia la izquierda.
+	 */
+	Board(int horizontalCount, int verticalCount, bool wrap = false, byte snakeCount = 1);
+	~Board();
+
+	//La memoria, en bytes, que necesita un tablero de cells celdas con el número
+	//de serpientes especificado: la matriz de objetos y la cola de cada serpiente
+	static unsigned int ramNeeded(unsigned int cells, byte snakeCount);
+
+	//Coloca los muros del nivel (0 => sin muros), las serpientes en su posición
+	//inicial y genera la primera moneda
+	void reset(uint32_t seed, byte level = 0);
+	//Avanza la (única) serpiente un bloque en la dirección especificada
+	StepResult step(Direction dir);
+	/*
+	 * Avanza todas las serpientes a la vez, cada una en su dirección, y guarda
+	 * el resultado de cada una. Las colisiones se comprueban contra el tablero
+	 * anterior al paso, por lo que el orden de las serpientes no importa; dos
+	 * cabezas que entran en la misma celda chocan ambas. Si alguna serpiente
+	 * choca, el tablero no cambia.
+	 */
+	void stepAll(const Direction* dirs, StepResult* results);
+	void regenCoin();
+
+	/*
+	 * Permiten reconstruir una partida guardada (véase snapshot.hpp): vaciar una
+	 * serpiente, añadirle celdas por la cabeza y colocar la moneda. No comprueban
+	 * que las celdas estén libres.
+	 */
+	void clearSnake(byte snake);
+	void growSnake(byte snake, Cell cell, Direction direction);
+	void placeCoin(Cell cell);
+
+	/*
+	 * Hash (FNV-1a de 32 bits) del estado de la partida: las celdas, las cabezas,
+	 * las direcciones y las puntuaciones de las serpientes y el estado del generador
+	 * aleatorio. Dos tableros con el mismo hash están, casi con seguridad, en el
+	 * mismo estado, así que sirve para comparar la placa con una simulación.
+	 */
+	uint32_t hash();
+
+	//Constantes
+	static const int minMovementDelay = 50;
+	static const int maxMovementDelay = 500;
+	static constexpr float movementDelta = -10.0f;
+
+	//Tablero
+	int horizontalCount;
+	int verticalCount;
+	int totalCount;
+	bool wrap;
+	//Celdas que no son muros
+	int openCount;
+	InGameItemType* itemMatrix;
+
+	//Reglas de movimiento para cada dirección (indexadas por Direction)
+	EdgeRule edges[Down + 1];
+
+	//Índice lineal de una celda en itemMatrix
+	inline int indexOf(Cell cell){
+		return cell.y * horizontalCount + cell.x;
+	}
+
+	/*
+	 * Mueve la celda cell, cuyo índice lineal es index, un bloque en la dirección
+	 * dir. La celda y el índice se actualizan a la vez a partir de la tabla de
+	 * bordes, sin divisiones, y ambos modos comparten el mismo camino. Devuelve
+	 * false si la celda sale del tablero (solo cuando wrap es false).
+	 */
+	inline bool neighbor(Direction dir, Cell* cell, int* index){
+		const EdgeRule* rule = &edges[dir];
+		byte* coord = rule->vertical ? &cell->y : &cell->x;
+		if (*coord == rule->edge){
+			if (!wrap) return false;
+			*coord = rule->wrapped;
+			*index += rule->wrapIndexDelta;
+		}else{
+			*coord += rule->delta;
+			*index += rule->indexDelta;
+		}
+		return true;
+	}
+
+	//Serpientes
+	Snake snakes[BOARD_MAX_SNAKES];
+	byte snakeCount;
+	//La suma de las longitudes de todas las serpientes
+	int occupied;
+
+	//Moneda (coinIndex es -1 si no hay moneda)
+	Cell coin;
+	int coinIndex = -1;
+	Random rng;
+
+	unsigned long steps = 0;
+	float movementDelay = maxMovementDelay;
+};
+
+#endif
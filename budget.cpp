@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación del presupuesto de tiempo de los pasos.
+ */
+
+#include "budget.hpp"
+
+void FrameBudget::measured(BudgetTask task, unsigned long us){
+	if (costs[task] == 0){
+		costs[task] = us << 3;
+	}else{
+		costs[task] += us - (costs[task] >> 3);
+	}
+	if (task != BudgetStep) return;
+
+	//El paso y el marcador deben caber en cada paso; el parpadeo puede esperar
+	unsigned long needed = (cost(BudgetStep) + cost(BudgetScore)) * FRAME_BUDGET_MARGIN / 8;
+	unsigned int period = (needed + 999) / 1000;
+	if (period > minDelay){
+		minDelay = period;
+	}else if (minDelay > Board::minMovementDelay && period * 4 < minDelay * 3){
+		//Solo se vuelve a acelerar si sobra bastante, para no oscilar
+		minDelay = period > Board::minMovementDelay ? period : Board::minMovementDelay;
+	}
+}
+
+unsigned long FrameBudget::cost(BudgetTask task){
+	return costs[task] >> 3;
+}
+
+bool FrameBudget::fits(BudgetTask task, unsigned long deadline){
+	long left = (long)(deadline - millis());
+	return left > 0 && (unsigned long)left * 1000 >= cost(task);
+}
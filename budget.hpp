@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración del presupuesto de tiempo de los pasos
+ * de la partida. El retraso mínimo entre pasos (Board::minMovementDelay) supone
+ * que el dibujo de un paso cabe en él, lo que no se cumple en todas las
+ * pantallas: en una más lenta, los pasos se retrasan de forma irregular.
+ *
+ * GameScreen mide con micros() lo que tarda cada tarea y FrameBudget guarda su
+ * coste medio. El trabajo de un paso (reglas, cola y cabeza) se hace siempre a
+ * su hora; el marcador y el parpadeo de la moneda solo se dibujan si caben
+ * antes del siguiente paso. Si el paso y el marcador juntos no caben en el
+ * retraso mínimo, éste se alarga lo justo, sin cambiar el retraso de las reglas.
+ */
+
+#ifndef budget_hpp
+#define budget_hpp
+
+#include "Arduino.h"
+#include "board.hpp"
+
+//Margen sobre el coste medido, en octavos (9 => 12.5% más)
+#define FRAME_BUDGET_MARGIN 9
+
+enum BudgetTask : byte {
+	//Trabajo obligatorio de un paso, incluidas las franjas de SMOOTH_MOVEMENT
+	BudgetStep,
+			//Tareas aplazables
+			BudgetScore,
+			BudgetCoinBlink,
+			BudgetTaskCount
+};
+
+class FrameBudget {
+public:
+	//Anota lo que ha tardado una tarea, en microsegundos
+	void measured(BudgetTask task, unsigned long us);
+	//Coste medio de una tarea, en microsegundos
+	unsigned long cost(BudgetTask task);
+	//Indica si una tarea cabe antes del instante deadline (según millis())
+	bool fits(BudgetTask task, unsigned long deadline);
+
+	//El retraso mínimo entre pasos, en milisegundos, que permite la pantalla
+	unsigned int minDelay = Board::minMovementDelay;
+private:
+	//Medias móviles exponenciales (1/8 de cada medida nueva), en octavos de microsegundo
+	unsigned long costs[BudgetTaskCount] = {0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de la fuente que utiliza Context para
+ * dibujar el texto sin pasar por la librería TFT.
+ *
+ * Cada carácter ocupa FONT_GLYPH_WIDTH bytes en la memoria flash, uno por
+ * columna, con la fila superior en el bit 0. Solo se incluyen los caracteres
+ * ASCII imprimibles; el resto se dibuja como FONT_FALLBACK_CHAR.
+ */
+
+#ifndef font_hpp
+#define font_hpp
+
+#include "Arduino.h"
+#include <avr/pgmspace.h>
+
+#define FONT_GLYPH_WIDTH 5
+#define FONT_GLYPH_HEIGHT 8
+//Ancho de un carácter más la separación con el siguiente (véase Context::getTextSize)
+#define FONT_ADVANCE 6
+#define FONT_FIRST_CHAR ' '
+#define FONT_LAST_CHAR '~'
+#define FONT_FALLBACK_CHAR '?'
+
+extern const byte FONT_GLYPHS[] PROGMEM;
+
+/*
+ * Devuelve la dirección en la flash de las columnas del carácter c.
+ */
+extern inline const byte* font_glyph(char c){
+	if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR){
+		c = FONT_FALLBACK_CHAR;
+	}
+	return FONT_GLYPHS + (c - FONT_FIRST_CHAR) * FONT_GLYPH_WIDTH;
+}
+
+#endif
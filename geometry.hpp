@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la geometría del tablero de juego (el rectángulo de
+ * juego, el número de bloques y la conversión entre celdas y píxeles).
+ *
+ * StaticGeometry la calcula en tiempo de compilación a partir del tamaño de la
+ * pantalla y del bloque. Los AVR no pueden dividir por hardware, y cada / o %
+ * por una variable llama a una rutina de división por software. Como aquí todos
+ * los divisores son constantes, el compilador sustituye esas divisiones por
+ * multiplicaciones y desplazamientos.
+ *
+ * RuntimeGeometry ofrece las mismas operaciones sobre celdas para un tamaño de
+ * bloque y de tablero elegidos durante la ejecución (véase BOARD_SETTINGS). Las
+ * divisiones solo se hacen al inicializarla; pasar de una celda a píxeles solo
+ * necesita una multiplicación, que los AVR sí hacen por hardware.
+ */
+
+#ifndef geometry_hpp
+#define geometry_hpp
+
+#include "types.hpp"
+
+/*
+ * Geometría de un tablero de bloques de BlockSize píxeles dentro de una pantalla
+ * de ScreenWidth x ScreenHeight, dejando TopMargin píxeles en la parte superior
+ * (para la puntuación). El rectángulo de juego incluye un borde de 1 píxel y se
+ * centra horizontalmente; el espacio vertical sobrante se suma al margen superior.
+ */
+template <int ScreenWidth, int ScreenHeight, int BlockSize, int TopMargin>
+class StaticGeometry {
+public:
+	static const int blockSize = BlockSize;
+
+	//Número de bloques que caben en la pantalla (-2 => los bordes del rectángulo)
+	static const int horizontalCount = (ScreenWidth - 2) / BlockSize;
+	static const int verticalCount = (ScreenHeight - TopMargin - 2) / BlockSize;
+	static const int totalCount = horizontalCount * verticalCount;
+
+	//Rectángulo de juego, bordes incluidos
+	static const int width = horizontalCount * BlockSize + 2;
+	static const int height = verticalCount * BlockSize + 2;
+	static const int x = (ScreenWidth - width) / 2;
+	static const int y = ScreenHeight - height;
+
+	static_assert(horizontalCount >= 4 && verticalCount >= 1, "The screen is too small for this block size");
+
+	static inline Rect rect(){
+		return {x, y, width, height};
+	}
+
+	static inline int column(unsigned int index){
+		return index % (unsigned int)horizontalCount;
+	}
+	static inline int row(unsigned int index){
+		return index / (unsigned int)horizontalCount;
+	}
+
+	//Esquina superior izquierda, en píxeles, de la celda index
+	static inline Point point(unsigned int index){
+		return {column(index) * BlockSize + x + 1, row(index) * BlockSize + y + 1};
+	}
+	static inline Rect cellRect(unsigned int index){
+		Point p = point(index);
+		return {p.x, p.y, BlockSize, BlockSize};
+	}
+
+	//Lo mismo, a partir de la columna y la fila (sin divisiones)
+	static inline Point point(Cell cell){
+		return {cell.x * BlockSize + x + 1, cell.y * BlockSize + y + 1};
+	}
+	static inline Rect cellRect(Cell cell){
+		Point p = point(cell);
+		return {p.x, p.y, BlockSize, BlockSize};
+	}
+
+	//Celda que contiene el píxel (px, py)
+	static inline int indexAt(int px, int py){
+		return (unsigned int)(py - y - 1) / BlockSize * horizontalCount + (unsigned int)(px - x - 1) / BlockSize;
+	}
+	static inline Cell cellAt(int px, int py){
+		return {(byte)((unsigned int)(px - x - 1) / BlockSize), (byte)((unsigned int)(py - y - 1) / BlockSize)};
+	}
+};
+
+/*
+ * Geometría de un tablero de columns x rows bloques de blockSize píxeles. El
+ * tablero se coloca como en StaticGeometry y, si es más pequeño que la pantalla,
+ * se centra en el espacio disponible.
+ */
+class RuntimeGeometry {
+public:
+	//El número máximo de bloques que caben en la pantalla con el tamaño especificado
+	static inline int maxColumns(int screenWidth, int blockSize){
+		return (screenWidth - 2) / blockSize;
+	}
+	static inline int maxRows(int screenHeight, int topMargin, int blockSize){
+		return (screenHeight - topMargin - 2) / blockSize;
+	}
+
+	void init(int screenWidth, int screenHeight, int topMargin, byte blockSize, byte columns, byte rows){
+		this->blockSize = blockSize;
+		horizontalCount = columns;
+		verticalCount = rows;
+		totalCount = columns * rows;
+		width = columns * blockSize + 2;
+		height = rows * blockSize + 2;
+		x = (screenWidth - width) / 2;
+		y = screenHeight - height - (maxRows(screenHeight, topMargin, blockSize) - rows) * blockSize / 2;
+	}
+
+	int blockSize;
+	int horizontalCount;
+	int verticalCount;
+	int totalCount;
+	int width;
+	int height;
+	int x;
+	int y;
+
+	inline Rect rect(){
+		return {x, y, width, height};
+	}
+	inline Point point(Cell cell){
+		return {cell.x * blockSize + x + 1, cell.y * blockSize + y + 1};
+	}
+	inline Rect cellRect(Cell cell){
+		Point p = point(cell);
+		return {p.x, p.y, blockSize, blockSize};
+	}
+	//Celda que contiene el píxel (px, py), que debe estar dentro del tablero
+	inline Cell cellAt(int px, int py){
+		return {(byte)((px - x - 1) / blockSize), (byte)((py - y - 1) / blockSize)};
+	}
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de la tabla de mejores puntuaciones.
+ */
+
+#include "highscores.hpp"
+#include "storage.hpp"
+
+//Valor del primer byte de la cabecera cuando la tabla está presente en la EEPROM.
+//Las versiones anteriores guardaban un 1 seguido de la puntuación máxima.
+#define HIGHSCORE_FORMAT 0x5C
+#define HIGHSCORE_LEGACY_FORMAT 1
+
+//El tamaño máximo de una entrada empaquetada (5 + 3 + 3 + 4)
+#define HIGHSCORE_MAX_ENTRY_SIZE 15
+
+static byte write_varint(byte* dst, unsigned long value){
+	byte n = 0;
+	while (value >= 0x80){
+		dst[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	dst[n++] = value;
+	return n;
+}
+
+static byte read_varint(const byte* src, unsigned long* value){
+	byte n = 0;
+	byte shift = 0;
+	unsigned long v = 0;
+	byte b;
+	do {
+		b = src[n++];
+		v |= ((unsigned long)(b & 0x7F)) << shift;
+		shift += 7;
+	}while (b & 0x80);
+	*value = v;
+	return n;
+}
+
+static byte encode_entry(byte* dst, HighScore* entry){
+	byte n = write_varint(dst, entry->score);
+	n += write_varint(dst + n, entry->length);
+	n += write_varint(dst + n, entry->duration);
+	pack_long(dst + n, entry->seed);
+	return n + 4;
+}
+
+void HighScoreTable::load(unsigned int offset){
+	this->offset = offset;
+	header[0] = eeprom_read_byte_safe(offset);
+
+	if (header[0] == HIGHSCORE_FORMAT){
+		header[1] = eeprom_read_byte_safe(offset + 1);
+		header[2] = eeprom_read_byte_safe(offset + 2);
+		if (header[1] <= HIGHSCORE_COUNT && header[2] <= HIGHSCORE_BUFFER_SIZE){
+			for (byte i = 0; i < header[2]; i++){
+				data[i] = eeprom_read_byte_safe(offset + 3 + i);
+			}
+			return;
+		}
+	}
+
+	unsigned long legacyScore = 0;
+	if (header[0] == HIGHSCORE_LEGACY_FORMAT){
+		legacyScore = eeprom_read_long(offset + 1);
+	}
+
+	clear();
+	if (legacyScore > 0){
+		HighScore entry = {legacyScore, 0, 0, 0};
+		insert(&entry);
+	}
+}
+
+byte HighScoreTable::read(byte pos, HighScore* out){
+	unsigned long v;
+	pos += read_varint(data + pos, &out->score);
+	pos += read_varint(data + pos, &v);
+	out->length = v;
+	pos += read_varint(data + pos, &v);
+	out->duration = v;
+	out->seed = ((unsigned long)data[pos]) << 24 | ((unsigned long)data[pos + 1]) << 16
+			| ((unsigned long)data[pos + 2]) << 8 | data[pos + 3];
+	return pos + 4;
+}
+
+unsigned long HighScoreTable::best(){
+	if (count() == 0) return 0;
+	unsigned long score;
+	read_varint(data, &score);
+	return score;
+}
+
+byte HighScoreTable::insert(HighScore* entry){
+	byte encoded[HIGHSCORE_MAX_ENTRY_SIZE];
+	byte size = encode_entry(encoded, entry);
+
+	//Buscar la posición de la nueva entrada. Los empates se quedan detrás
+	//de las entradas que ya estaban.
+	byte index = 0;
+	byte pos = 0;
+	HighScore current;
+	while (index < count()){
+		byte next = read(pos, &current);
+		if (current.score < entry->score) break;
+		pos = next;
+		index++;
+	}
+
+	if (index >= HIGHSCORE_COUNT || pos + size > HIGHSCORE_BUFFER_SIZE){
+		return HIGHSCORE_COUNT;
+	}
+
+	//Calcular cuántas de las entradas siguientes se conservan, descartando
+	//las que ya no quepan en la tabla.
+	byte keptCount = 0;
+	byte keptEnd = pos;
+	while (index + keptCount < count() && index + keptCount + 1 < HIGHSCORE_COUNT){
+		byte next = read(keptEnd, &current);
+		if (next + size > HIGHSCORE_BUFFER_SIZE) break;
+		keptEnd = next;
+		keptCount++;
+	}
+
+	memmove(data + pos + size, data + pos, keptEnd - pos);
+	memcpy(data + pos, encoded, size);
+	header[1] = index + keptCount + 1;
+	header[2] = keptEnd + size;
+
+	save(pos);
+	return index;
+}
+
+void HighScoreTable::clear(){
+	header[1] = 0;
+	header[2] = 0;
+	save(0);
+}
+
+/*
+ * Envía a la EEPROM la cabecera y las entradas a partir de la posición from
+ * (las anteriores no han cambiado).
+ */
+void HighScoreTable::save(byte from){
+	header[0] = HIGHSCORE_FORMAT;
+	//Las entradas y la cabecera deben escribirse juntas o no escribirse
+	if (eeprom_queue_room() < 2) return;
+	if (header[2] > from){
+		eeprom_queue_write(offset + 3 + from, data + from, header[2] - from);
+	}
+	eeprom_queue_write(offset, header, 3);
+}
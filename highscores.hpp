@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de la tabla de mejores puntuaciones.
+ * La tabla se guarda en la EEPROM (y en una copia en RAM) con un formato
+ * empaquetado de longitud variable: cada número se codifica en grupos de 7 bits
+ * (el bit más significativo de cada byte indica si quedan más bytes), excepto la
+ * semilla, que ocupa siempre 4 bytes. Así, una entrada típica ocupa unos 9 bytes
+ * en lugar de los 12 de la estructura HighScore.
+ */
+
+#ifndef highscores_hpp
+#define highscores_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+
+//El número máximo de entradas de la tabla
+#define HIGHSCORE_COUNT 10
+
+/*
+ * El tamaño máximo, en bytes, de las entradas empaquetadas. Si una nueva entrada
+ * no cabe, se descartan las últimas de la tabla.
+ */
+#define HIGHSCORE_BUFFER_SIZE 128
+
+//El tamaño de la tabla en la EEPROM (cabecera + entradas)
+#define HIGHSCORE_EEPROM_SIZE (HIGHSCORE_BUFFER_SIZE + 3)
+
+/*
+ * Representa una partida guardada en la tabla de puntuaciones.
+ */
+typedef struct {
+	unsigned long score;
+	//La longitud final de la serpiente, en bloques
+	unsigned int length;
+	//La duración de la partida, en segundos
+	unsigned int duration;
+	//La semilla con la que se generó la partida
+	unsigned long seed;
+} HighScore;
+
+/*
+ * Representa la tabla de mejores puntuaciones, ordenada de mayor a menor.
+ */
+class HighScoreTable {
+public:
+	void load(unsigned int offset);
+
+	/*
+	 * Inserta una nueva entrada en la tabla y la envía a la EEPROM. Devuelve la
+	 * posición (empezando en 0) en la que ha quedado, o HIGHSCORE_COUNT si la
+	 * puntuación no es suficiente para entrar en la tabla.
+	 */
+	byte insert(HighScore* entry);
+	void clear();
+
+	inline byte count(){
+		return header[1];
+	}
+	unsigned long best();
+
+	/*
+	 * Decodifica la entrada que comienza en la posición pos del buffer y devuelve
+	 * la posición de la siguiente. Para recorrer la tabla:
+	 *
+	 * for (byte i = 0, pos = 0; i < table.count(); i++) pos = table.read(pos, &entry);
+	 */
+	byte read(byte pos, HighScore* out);
+private:
+	unsigned int offset;
+	//Cabecera: formato, número de entradas y bytes ocupados
+	byte header[3];
+	byte data[HIGHSCORE_BUFFER_SIZE];
+
+	void save(byte from);
+};
+
+#endif
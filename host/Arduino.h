@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Sustituto de "Arduino.h" para compilar el Sketch en un ordenador. Solo declara
+ * lo que utiliza el programa. El tiempo es virtual (solo avanza con delay o con
+ * host_advance_time), y los pines de entrada toman los valores que indique el
+ * programa anfitrión, de forma que una misma secuencia de controles produce
+ * siempre exactamente la misma partida. La implementación está en arduino.cpp.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+//Mismo generador que avr-libc, para obtener las mismas semillas que en la placa
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+char* ultoa(unsigned long value, char* buffer, int radix);
+
+//Puerto serial, con un buffer de salida del mismo tamaño que en la placa
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial {
+public:
+	void begin(unsigned long baud);
+	int available();
+	int read();
+	int availableForWrite();
+	size_t write(const uint8_t* data, size_t len);
+};
+extern HardwareSerial Serial;
+
+//Control del entorno desde el programa anfitrión
+void host_advance_time(unsigned long ms);
+void host_advance_micros(unsigned long us);
+void host_set_digital(uint8_t pin, int value);
+void host_set_analog(uint8_t pin, int value);
+//Bytes que recibe la placa por el puerto serial y bytes que ha enviado
+void host_serial_send(const uint8_t* data, size_t len);
+size_t host_serial_receive(uint8_t* data, size_t max);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * EEPROM simulada de 1 KB (la de un Arduino UNO), inicialmente borrada (0xFF).
+ */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+public:
+	uint8_t memory[E2END + 1];
+
+	EEPROMClass();
+	uint8_t read(int offset){
+		return memory[offset];
+	}
+	void write(int offset, uint8_t value){
+		memory[offset] = value;
+	}
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
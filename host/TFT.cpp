@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Implementación del sustituto de la librería TFT.
+ */
+
+#include "TFT.h"
+#include <stdio.h>
+
+TFT::TFT(uint8_t cs, uint8_t dc, uint8_t rst){
+	memset(framebuffer, 0, sizeof(framebuffer));
+}
+
+void TFT::begin(){}
+
+int16_t TFT::width(){
+	return HOST_TFT_WIDTH;
+}
+
+int16_t TFT::height(){
+	return HOST_TFT_HEIGHT;
+}
+
+uint16_t TFT::newColor(uint8_t r, uint8_t g, uint8_t b){
+	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+void TFT::background(uint8_t r, uint8_t g, uint8_t b){
+	fillArea(0, 0, HOST_TFT_WIDTH, HOST_TFT_HEIGHT, newColor(r, g, b));
+}
+
+void TFT::stroke(uint8_t r, uint8_t g, uint8_t b){
+	useStroke = true;
+	strokeColor = newColor(r, g, b);
+}
+
+void TFT::noStroke(){
+	useStroke = false;
+}
+
+void TFT::fill(uint8_t r, uint8_t g, uint8_t b){
+	useFill = true;
+	fillColor = newColor(r, g, b);
+}
+
+void TFT::noFill(){
+	useFill = false;
+}
+
+void TFT::textSize(uint8_t size){
+	this->size = size > 0 ? size : 1;
+}
+
+void TFT::rect(int16_t x, int16_t y, int16_t w, int16_t h){
+	if (useFill){
+		fillArea(x, y, w, h, fillColor);
+	}
+	if (useStroke && w > 0 && h > 0){
+		fillArea(x, y, w, 1, strokeColor);
+		fillArea(x, y + h - 1, w, 1, strokeColor);
+		fillArea(x, y, 1, h, strokeColor);
+		fillArea(x + w - 1, y, 1, h, strokeColor);
+	}
+}
+
+void TFT::setAddrWindow(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1){
+	windowX0 = x0;
+	windowX1 = x1;
+	windowY1 = y1;
+	cursorX = x0;
+	cursorY = y0;
+}
+
+void TFT::pushColor(uint16_t color){
+	if (cursorY > windowY1) return;
+	fillArea(cursorX, cursorY, 1, 1, color);
+	if (cursorX++ == windowX1){
+		cursorX = windowX0;
+		cursorY++;
+	}
+}
+
+void TFT::text(const char* text, int16_t x, int16_t y){
+	if (!useStroke) return;
+	int cx = x;
+	int cy = y;
+	for (; *text != 0; text++){
+		if (*text == '\n'){
+			cx = 0;
+			cy += size * 8;
+			continue;
+		}
+		if (*text == '\r') continue;
+		if (cx + size * 6 > HOST_TFT_WIDTH){
+			cx = 0;
+			cy += size * 8;
+		}
+		drawChar(cx, cy, *text);
+		cx += size * 6;
+	}
+}
+
+void TFT::drawChar(int x, int y, char c){
+	if (c == ' ') return;
+
+	//Patrón de 5x7 píxeles derivado del código del carácter
+	uint32_t bits = (uint8_t)c * 2654435761u;
+	bits ^= bits >> 15;
+	bits *= 2246822519u;
+	bits ^= bits >> 13;
+	for (int i = 0; i < 5; i++){
+		uint8_t column = ((bits >> (i * 6)) & 0x7F) | 0x01;
+		for (int j = 0; j < 7; j++){
+			if (column & (1 << j)){
+				fillArea(x + i * size, y + j * size, size, size, strokeColor);
+			}
+		}
+	}
+}
+
+void TFT::fillArea(int x, int y, int w, int h, uint16_t color){
+	if (x < 0){
+		w += x;
+		x = 0;
+	}
+	if (y < 0){
+		h += y;
+		y = 0;
+	}
+	if (x + w > HOST_TFT_WIDTH) w = HOST_TFT_WIDTH - x;
+	if (y + h > HOST_TFT_HEIGHT) h = HOST_TFT_HEIGHT - y;
+	if (w <= 0 || h <= 0) return;
+
+	for (int j = y; j < y + h; j++){
+		for (int i = x; i < x + w; i++){
+			framebuffer[j * HOST_TFT_WIDTH + i] = color;
+		}
+	}
+	pixelsWritten += w * h;
+
+	pendingNs += nsPerWindow + (unsigned long)(w * h) * nsPerPixel;
+	host_advance_micros(pendingNs / 1000);
+	pendingNs %= 1000;
+}
+
+uint64_t TFT::hash(){
+	uint64_t h = 0xCBF29CE484222325ull;
+	const uint8_t* data = (const uint8_t*)framebuffer;
+	for (size_t i = 0; i < sizeof(framebuffer); i++){
+		h ^= data[i];
+		h *= 0x100000001B3ull;
+	}
+	return h;
+}
+
+bool TFT::save(const char* path){
+	FILE* f = fopen(path, "wb");
+	if (!f) return false;
+	fprintf(f, "P6\n%d %d\n255\n", HOST_TFT_WIDTH, HOST_TFT_HEIGHT);
+	for (int i = 0; i < HOST_TFT_WIDTH * HOST_TFT_HEIGHT; i++){
+		uint16_t c = framebuffer[i];
+		uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)((c << 3) & 0xF8)};
+		fwrite(rgb, 1, 3, f);
+	}
+	fclose(f);
+	return true;
+}
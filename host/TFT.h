@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Sustituto de la librería TFT que dibuja en un framebuffer en memoria (RGB565)
+ * en lugar de en la pantalla. Reproduce el comportamiento de la librería
+ * original: rect() rellena y después dibuja el borde, text() solo pinta los
+ * píxeles encendidos de cada carácter (6x8 píxeles por tamaño, con salto de
+ * línea automático en el borde derecho) y noStroke() desactiva el texto.
+ * setAddrWindow() y pushColor() (de la clase Adafruit_ST7735 de la que deriva
+ * la original) escriben los píxeles de una ventana por filas, de izquierda a
+ * derecha.
+ *
+ * La fuente no es la de la librería: cada carácter se dibuja con un patrón fijo
+ * obtenido a partir de su código. Para comparar fotogramas basta con que el
+ * dibujo sea determinista y dependa del texto, la posición y el color.
+ */
+
+#ifndef TFT_h
+#define TFT_h
+
+#include "Arduino.h"
+
+#define HOST_TFT_WIDTH 160
+#define HOST_TFT_HEIGHT 128
+
+class TFT {
+public:
+	TFT(uint8_t cs, uint8_t dc, uint8_t rst);
+
+	void begin();
+	int16_t width();
+	int16_t height();
+
+	void background(uint8_t r, uint8_t g, uint8_t b);
+	void stroke(uint8_t r, uint8_t g, uint8_t b);
+	void noStroke();
+	void fill(uint8_t r, uint8_t g, uint8_t b);
+	void noFill();
+	void textSize(uint8_t size);
+	void text(const char* text, int16_t x, int16_t y);
+	void rect(int16_t x, int16_t y, int16_t w, int16_t h);
+	void setAddrWindow(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+	void pushColor(uint16_t color);
+
+	static uint16_t newColor(uint8_t r, uint8_t g, uint8_t b);
+
+	//Hash FNV-1a del contenido de la pantalla
+	uint64_t hash();
+	//Guarda la pantalla en formato PPM
+	bool save(const char* path);
+
+	uint16_t framebuffer[HOST_TFT_WIDTH * HOST_TFT_HEIGHT];
+	//Píxeles escritos en el framebuffer desde el inicio
+	unsigned long pixelsWritten = 0;
+	/*
+	 * Velocidad simulada de la pantalla: el tiempo virtual, en nanosegundos, que
+	 * tarda en abrir cada ventana de escritura y en recibir cada píxel. Por
+	 * defecto la pantalla es instantánea.
+	 */
+	unsigned long nsPerWindow = 0;
+	unsigned long nsPerPixel = 0;
+private:
+	//Nanosegundos simulados que aún no suman un microsegundo
+	unsigned long pendingNs = 0;
+	bool useStroke = true;
+	bool useFill = true;
+	uint16_t strokeColor = 0xFFFF;
+	uint16_t fillColor = 0xFFFF;
+	uint8_t size = 1;
+	//La ventana de setAddrWindow() y el siguiente píxel que escribirá pushColor()
+	uint8_t windowX0 = 0;
+	uint8_t windowX1 = 0;
+	uint8_t windowY1 = 0;
+	uint8_t cursorX = 0;
+	uint8_t cursorY = 0;
+
+	void fillArea(int x, int y, int w, int h, uint16_t color);
+	void drawChar(int x, int y, char c);
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Implementación del entorno Arduino simulado: reloj virtual, pines y generador
+ * de números aleatorios. La EEPROM está en eeprom.cpp.
+ */
+
+#include "Arduino.h"
+
+//Tiempo
+static unsigned long hostMicros = 0;
+
+unsigned long millis(){
+	return hostMicros / 1000;
+}
+
+unsigned long micros(){
+	return hostMicros;
+}
+
+void delay(unsigned long ms){
+	hostMicros += ms * 1000;
+}
+
+void host_advance_time(unsigned long ms){
+	hostMicros += ms * 1000;
+}
+
+void host_advance_micros(unsigned long us){
+	hostMicros += us;
+}
+
+void host_sleep(){
+	hostMicros += 1000 - hostMicros % 1000;
+}
+
+//Pines
+static int pins[32];
+
+void pinMode(uint8_t pin, uint8_t mode){}
+
+int digitalRead(uint8_t pin){
+	return pins[pin & 31] ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin){
+	return pins[pin & 31];
+}
+
+void host_set_digital(uint8_t pin, int value){
+	pins[pin & 31] = value;
+}
+
+void host_set_analog(uint8_t pin, int value){
+	pins[pin & 31] = value;
+}
+
+//Números aleatorios (generador de Park-Miller de avr-libc)
+static uint32_t randomState = 1;
+
+static int32_t next_random(){
+	int32_t x = randomState;
+	if (x == 0) x = 123459876L;
+	int32_t hi = x / 127773L;
+	int32_t lo = x % 127773L;
+	x = 16807L * lo - 2836L * hi;
+	if (x < 0) x += 0x7FFFFFFFL;
+	randomState = x;
+	return x % 0x80000000L;
+}
+
+long random(long max){
+	if (max == 0) return 0;
+	return next_random() % max;
+}
+
+long random(long min, long max){
+	if (min >= max) return min;
+	return random(max - min) + min;
+}
+
+void randomSeed(unsigned long seed){
+	if (seed != 0) randomState = seed;
+}
+
+char* ultoa(unsigned long value, char* buffer, int radix){
+	char digits[33];
+	int n = 0;
+	do{
+		int d = value % radix;
+		digits[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+	}while((value /= radix) != 0);
+
+	for (int i = 0; i < n; i++){
+		buffer[i] = digits[n - 1 - i];
+	}
+	buffer[n] = 0;
+	return buffer;
+}
+
+/*
+ * Puerto serial. La transmisión es instantánea, así que el buffer de salida solo
+ * se vacía cuando el programa anfitrión lee lo que ha enviado la placa. Si está
+ * lleno, write() espera como en la placa: el byte más antiguo pasa a la línea
+ * (que el programa anfitrión lee antes que el buffer) y el reloj avanza lo que
+ * tarda en enviarse a la velocidad de begin().
+ */
+#define HOST_SERIAL_RX_SIZE 1024
+#define HOST_SERIAL_LINE_SIZE 65536
+
+HardwareSerial Serial;
+
+static uint8_t serialRx[HOST_SERIAL_RX_SIZE];
+static size_t serialRxHead = 0;
+static size_t serialRxCount = 0;
+static uint8_t serialTx[SERIAL_TX_BUFFER_SIZE];
+static size_t serialTxCount = 0;
+static uint8_t serialLine[HOST_SERIAL_LINE_SIZE];
+static size_t serialLineHead = 0;
+static size_t serialLineCount = 0;
+static unsigned long serialBaud = 0;
+//Tiempo de envío que aún no suma un microsegundo, en millonésimas de bit
+static unsigned long serialPendingBits = 0;
+
+void HardwareSerial::begin(unsigned long baud){
+	serialBaud = baud;
+}
+
+int HardwareSerial::available(){
+	return serialRxCount;
+}
+
+int HardwareSerial::read(){
+	if (serialRxCount == 0) return -1;
+	uint8_t value = serialRx[serialRxHead];
+	serialRxHead = (serialRxHead + 1) % HOST_SERIAL_RX_SIZE;
+	serialRxCount--;
+	return value;
+}
+
+int HardwareSerial::availableForWrite(){
+	return SERIAL_TX_BUFFER_SIZE - serialTxCount;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len){
+	for (size_t i = 0; i < len; i++){
+		if (serialTxCount == SERIAL_TX_BUFFER_SIZE){
+			//Un byte son 10 bits en la línea (inicio, 8 bits de datos y parada)
+			if (serialBaud != 0){
+				serialPendingBits += 10000000UL;
+				host_advance_micros(serialPendingBits / serialBaud);
+				serialPendingBits %= serialBaud;
+			}
+			if (serialLineCount < HOST_SERIAL_LINE_SIZE){
+				serialLine[(serialLineHead + serialLineCount++) % HOST_SERIAL_LINE_SIZE] = serialTx[0];
+			}
+			memmove(serialTx, serialTx + 1, --serialTxCount);
+		}
+		serialTx[serialTxCount++] = data[i];
+	}
+	return len;
+}
+
+void host_serial_send(const uint8_t* data, size_t len){
+	for (size_t i = 0; i < len && serialRxCount < HOST_SERIAL_RX_SIZE; i++){
+		serialRx[(serialRxHead + serialRxCount++) % HOST_SERIAL_RX_SIZE] = data[i];
+	}
+}
+
+size_t host_serial_receive(uint8_t* data, size_t max){
+	size_t received = 0;
+	while (received < max && serialLineCount > 0){
+		data[received++] = serialLine[serialLineHead];
+		serialLineHead = (serialLineHead + 1) % HOST_SERIAL_LINE_SIZE;
+		serialLineCount--;
+	}
+	data += received;
+	max -= received;
+
+	size_t len = serialTxCount < max ? serialTxCount : max;
+	memcpy(data, serialTx, len);
+	memmove(serialTx, serialTx + len, serialTxCount - len);
+	serialTxCount -= len;
+	return received + len;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Registros de la EEPROM simulados. EECR es un objeto que reacciona a las
+ * escrituras igual que el hardware: EERE carga EEDR, EEPE escribe EEDR en la
+ * memoria (de forma instantánea) y, mientras EERIE esté activo, se ejecuta la
+ * interrupción EE_READY. La memoria simulada está en eeprom.cpp.
+ */
+
+#ifndef io_h
+#define io_h
+
+#include <stdint.h>
+
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+
+#define _BV(bit) (1 << (bit))
+
+void EE_READY_vect(void);
+
+class EepromControlRegister {
+public:
+	operator uint8_t() const {
+		return value;
+	}
+	EepromControlRegister& operator|=(uint8_t bits);
+	EepromControlRegister& operator&=(uint8_t bits);
+private:
+	uint8_t value = 0;
+	bool inInterrupt = false;
+};
+
+extern EepromControlRegister EECR;
+extern volatile uint16_t EEAR;
+extern volatile uint8_t EEDR;
+
+#endif
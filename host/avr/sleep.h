@@ -0,0 +1,35 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Modos de bajo consumo. En el entorno simulado, dormir equivale a esperar a
+ * la siguiente interrupción del reloj de millis(), que salta cada milisegundo.
+ */
+
+#ifndef sleep_h
+#define sleep_h
+
+#define SLEEP_MODE_IDLE 0
+
+void host_sleep();
+
+#define set_sleep_mode(mode)
+#define sleep_mode() host_sleep()
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Implementación del entorno por lotes (véase batch.hpp).
+ */
+
+#include "batch.hpp"
+
+BatchBoard::BatchBoard(int envCount, int horizontalCount, int verticalCount, byte level, bool wrap){
+	this->envCount = envCount;
+	this->horizontalCount = horizontalCount;
+	this->verticalCount = verticalCount;
+	this->totalCount = horizontalCount * verticalCount;
+	this->wrap = wrap;
+	words = (totalCount + 63) / 64;
+	lastWordMask = totalCount % 64 == 0 ? ~0ULL : (1ULL << (totalCount % 64)) - 1;
+
+	//Los muros son los mismos en todas las partidas
+	wallBits = new uint64_t[words]();
+	openCount = totalCount;
+	LevelDecoder walls(level, horizontalCount, verticalCount);
+	WallRun run;
+	while (walls.next(&run)){
+		for (int y = run.y; y < run.y + run.h; y++){
+			for (int x = run.x; x < run.x + run.w; x++){
+				int cell = y * horizontalCount + x;
+				wallBits[cell >> 6] |= 1ULL << (cell & 63);
+			}
+		}
+		openCount -= run.w * run.h;
+	}
+	//Como Board::reset, quitar los muros bajo la serpiente inicial y la celda siguiente
+	for (int cell = 0; cell < 4; cell++){
+		if (wallBits[0] & (1ULL << cell)){
+			wallBits[0] &= ~(1ULL << cell);
+			openCount++;
+		}
+	}
+
+	//Las mismas reglas de bordes que Board::neighbor, precalculadas por celda
+	neighbors = new uint16_t[(Down + 1) * totalCount];
+	for (int cell = 0; cell < totalCount; cell++){
+		int x = cell % horizontalCount;
+		int y = cell / horizontalCount;
+		int lastColumn = horizontalCount - 1;
+		int lastRow = verticalCount - 1;
+		neighbors[None * totalCount + cell] = cell;
+		neighbors[Left * totalCount + cell] = x > 0 ? cell - 1 : wrap ? cell + lastColumn : BATCH_NO_CELL;
+		neighbors[Right * totalCount + cell] = x < lastColumn ? cell + 1 : wrap ? cell - lastColumn : BATCH_NO_CELL;
+		neighbors[Up * totalCount + cell] = y > 0 ? cell - horizontalCount : wrap ? cell + lastRow * horizontalCount : BATCH_NO_CELL;
+		neighbors[Down * totalCount + cell] = y < lastRow ? cell + horizontalCount : wrap ? cell - lastRow * horizontalCount : BATCH_NO_CELL;
+	}
+	for (byte d = None; d <= Down; d++){
+		for (byte t = Straight; t <= TurnRight; t++){
+			turns[d][t] = direction_turn((Direction)d, (Turn)t);
+		}
+	}
+
+	head = new uint16_t[envCount];
+	direction = new byte[envCount];
+	length = new uint16_t[envCount];
+	score = new uint32_t[envCount];
+	reward = new uint32_t[envCount];
+	rng = new uint32_t[envCount];
+	coin = new uint16_t[envCount];
+	steps = new uint32_t[envCount];
+	snakeBits = new uint64_t[envCount * words];
+	body = new uint16_t[envCount * totalCount];
+	tail = new uint16_t[envCount];
+	nextCell = new uint16_t[envCount];
+	blocked = new byte[envCount];
+	eaten = new int[envCount];
+
+	for (int env = 0; env < envCount; env++){
+		reset(env, env + 1);
+	}
+}
+
+BatchBoard::~BatchBoard(){
+	delete[] wallBits;
+	delete[] neighbors;
+	delete[] head;
+	delete[] direction;
+	delete[] length;
+	delete[] score;
+	delete[] reward;
+	delete[] rng;
+	delete[] coin;
+	delete[] steps;
+	delete[] snakeBits;
+	delete[] body;
+	delete[] tail;
+	delete[] nextCell;
+	delete[] blocked;
+	delete[] eaten;
+}
+
+void BatchBoard::reset(int env, uint32_t seed){
+	rng[env] = seed == 0 ? 1 : seed;
+	memset(snakeBits + env * words, 0, words * sizeof(uint64_t));
+
+	//Los 3 bloques iniciales, en la esquina superior izquierda hacia la derecha
+	uint16_t* blocks = body + env * totalCount;
+	for (int i = 0; i < 3; i++){
+		blocks[i] = i;
+		snakeBits[env * words] |= 1ULL << i;
+	}
+	tail[env] = 0;
+	length[env] = 3;
+	head[env] = 2;
+	direction[env] = Right;
+	score[env] = 0;
+	reward[env] = 0;
+	steps[env] = 0;
+	regenCoin(env);
+}
+
+void BatchBoard::step(const Turn* actions, StepResult* results){
+	//1. La siguiente celda de cada cabeza y si está bloqueada (borde, muro o
+	//serpiente), contra el tablero anterior al paso. Sin saltos ni dependencias
+	//entre partidas, para que el compilador pueda vectorizar el bucle.
+	for (int env = 0; env < envCount; env++){
+		byte dir = turns[direction[env]][actions[env]];
+		uint16_t next = neighbors[dir * totalCount + head[env]];
+		bool outside = next == BATCH_NO_CELL;
+		int cell = outside ? 0 : next;
+		uint64_t occupied = wallBits[cell >> 6] | snakeBits[env * words + (cell >> 6)];
+		direction[env] = dir;
+		nextCell[env] = next;
+		blocked[env] = outside | ((occupied >> (cell & 63)) & 1);
+		steps[env]++;
+	}
+
+	//2. Mover las serpientes. Las que no comen liberan la celda de su cola.
+	int eatenCount = 0;
+	for (int env = 0; env < envCount; env++){
+		if (blocked[env]){
+			results[env] = Collision;
+			reward[env] = 0;
+			continue;
+		}
+		uint16_t next = nextCell[env];
+		uint16_t* blocks = body + env * totalCount;
+		uint64_t* bits = snakeBits + env * words;
+		int last = tail[env] + length[env];
+		blocks[last >= totalCount ? last - totalCount : last] = next;
+		uint32_t size = ++length[env];
+		head[env] = next;
+
+		if (next == coin[env]){
+			reward[env] = 20 * size;
+			results[env] = CoinEaten;
+			eaten[eatenCount++] = env;
+		}else{
+			reward[env] = size;
+			results[env] = Moved;
+			uint16_t freed = blocks[tail[env]];
+			bits[freed >> 6] &= ~(1ULL << (freed & 63));
+			if (++tail[env] == totalCount) tail[env] = 0;
+			length[env]--;
+		}
+		score[env] += reward[env];
+		bits[next >> 6] |= 1ULL << (next & 63);
+	}
+
+	//3. Las monedas de todas las partidas que han comido, una vez que las
+	//cabezas ocupan su celda
+	for (int i = 0; i < eatenCount; i++){
+		int env = eaten[i];
+		regenCoin(env);
+		if (length[env] == openCount){
+			results[env] = BoardFull;
+		}
+	}
+}
+
+void BatchBoard::regenCoin(int env){
+	//El mismo número que Random::range, y la misma celda libre que Board::regenCoin
+	//(la randIndex-ésima en orden de índice), pero contando bits por palabras
+	uint32_t freeCount = openCount - length[env];
+	coin[env] = BATCH_NO_CELL;
+	if (freeCount == 0) return;
+	Random random = {rng[env]};
+	uint32_t randIndex = random.range(freeCount);
+	rng[env] = random.state;
+
+	const uint64_t* bits = snakeBits + env * words;
+	for (int w = 0; w < words; w++){
+		uint64_t free = ~(bits[w] | wallBits[w]);
+		if (w == words - 1) free &= lastWordMask;
+		uint32_t count = __builtin_popcountll(free);
+		if (randIndex >= count){
+			randIndex -= count;
+			continue;
+		}
+		while (randIndex-- > 0){
+			free &= free - 1;
+		}
+		coin[env] = w * 64 + __builtin_ctzll(free);
+		return;
+	}
+}
+
+//FNV-1a de 32 bits, con los mismos datos y en el mismo orden que Board::hash
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+
+static inline uint32_t fnv_add(uint32_t hash, byte value){
+	return (hash ^ value) * FNV_PRIME;
+}
+
+static inline uint32_t fnv_add_long(uint32_t hash, uint32_t value){
+	for (int8_t shift = 24; shift >= 0; shift -= 8){
+		hash = fnv_add(hash, value >> shift);
+	}
+	return hash;
+}
+
+uint32_t BatchBoard::hash(int env){
+	const uint64_t* bits = snakeBits + env * words;
+	uint32_t h = FNV_OFFSET;
+	for (int cell = 0; cell < totalCount; cell++){
+		InGameItemType item = Empty;
+		if (isSet(bits, cell)) item = SnakeObject;
+		else if (isSet(wallBits, cell)) item = Wall;
+		else if (cell == coin[env]) item = Coin;
+		h = fnv_add(h, item);
+	}
+	h = fnv_add(h, head[env] % horizontalCount);
+	h = fnv_add(h, head[env] / horizontalCount);
+	h = fnv_add(h, direction[env]);
+	h = fnv_add_long(h, score[env]);
+	return fnv_add_long(h, rng[env]);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Entorno por lotes para entrenar políticas en el ordenador: avanza N partidas
+ * independientes de una serpiente a la vez, con un giro (véase el enum Turn) por
+ * partida. Las reglas son exactamente las de la clase Board (colisiones contra el
+ * tablero anterior al paso, puntuación, generación de monedas con el mismo
+ * generador y el mismo orden de celdas), de forma que una política entrenada aquí
+ * se comporta igual en la placa; hash() devuelve el mismo valor que Board::hash.
+ *
+ * El estado se guarda como estructura de arrays: un array por campo, indexado por
+ * partida, y la ocupación de cada partida como un mapa de bits de 64 bits por
+ * palabra. Así, el cálculo de la siguiente celda y la comprobación de colisiones
+ * son bucles sin dependencias entre partidas que el compilador puede vectorizar,
+ * y solo la actualización de la cola y la generación de monedas (que se hace
+ * al final del paso, para todas las partidas que han comido) recorren las
+ * partidas una a una.
+ *
+ * Es solo para el ordenador (la placa no tiene instrucciones SIMD ni memoria
+ * para más de un tablero); véase batchbench.cpp.
+ */
+
+#ifndef batch_hpp
+#define batch_hpp
+
+#include "Arduino.h"
+#include "board.hpp"
+
+//Índice de celda que indica que no hay celda (fuera del tablero o sin moneda)
+#define BATCH_NO_CELL 0xFFFF
+
+class BatchBoard {
+public:
+	//Todas las partidas comparten las dimensiones, el nivel y el modo de bordes
+	BatchBoard(int envCount, int horizontalCount, int verticalCount, byte level = 0, bool wrap = false);
+	~BatchBoard();
+
+	//Igual que Board::reset, para una sola partida
+	void reset(int env, uint32_t seed);
+	/*
+	 * Avanza cada partida con su giro y guarda su resultado en results y los
+	 * puntos obtenidos en reward. Las partidas que chocan no cambian (igual que
+	 * en Board) y, como las que llenan el tablero, deben reiniciarse con reset
+	 * antes del siguiente paso.
+	 */
+	void step(const Turn* actions, StepResult* results);
+
+	//Hash del estado de una partida, igual al de un Board en el mismo estado
+	uint32_t hash(int env);
+
+	//Tablero (común a todas las partidas)
+	int envCount;
+	int horizontalCount;
+	int verticalCount;
+	int totalCount;
+	bool wrap;
+	int openCount;
+	//Palabras de 64 bits del mapa de bits de cada partida
+	int words;
+	uint64_t* wallBits;
+
+	//Estado de cada partida, un array por campo
+	uint16_t* head;
+	byte* direction;
+	uint16_t* length;
+	uint32_t* score;
+	uint32_t* reward;
+	uint32_t* rng;
+	uint16_t* coin;
+	uint32_t* steps;
+	//envCount * words palabras: las celdas ocupadas por la serpiente
+	uint64_t* snakeBits;
+	//envCount * totalCount celdas: cola circular con los bloques de cada serpiente
+	uint16_t* body;
+	//Posición de la cola (el bloque más antiguo) en la cola circular
+	uint16_t* tail;
+
+private:
+	//(Down + 1) * totalCount celdas: la siguiente celda de cada celda en cada
+	//dirección, o BATCH_NO_CELL si sale del tablero
+	uint16_t* neighbors;
+	//La dirección resultante de cada giro desde cada dirección
+	byte turns[Down + 1][3];
+	//Bits de las celdas que existen en la última palabra del mapa de bits
+	uint64_t lastWordMask;
+	//Resultados intermedios del paso, uno por partida
+	uint16_t* nextCell;
+	byte* blocked;
+	//Partidas que han comido en el paso actual
+	int* eaten;
+
+	void regenCoin(int env);
+
+	inline bool isSet(const uint64_t* bits, int cell){
+		return (bits[cell >> 6] >> (cell & 63)) & 1;
+	}
+};
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Mide cuántos pasos por segundo da el entorno por lotes (véase batch.hpp) con
+ * una política de giros aleatorios, repartiendo las partidas entre todos los
+ * núcleos, y comprueba que sigue exactamente las reglas de la clase Board.
+ *
+ * Compilar desde la carpeta raíz del Sketch:
+ *
+ *   g++ -O3 -march=native -std=c++11 -pthread -Ihost -I. host/batchbench.cpp host/batch.cpp host/arduino.cpp board.cpp levels.cpp -o batchbench
+ *
+ * Uso:
+ *
+ *   ./batchbench [-n partidas] [-k pasos] [-j hilos] [-s semilla]
+ *                [-x columnas] [-y filas] [-l nivel] [-w] [-v]
+ *
+ * Cada hilo tiene su propio BatchBoard con su parte de las partidas, y da k
+ * pasos con todas ellas, reiniciando las que terminan. Con -v, en lugar de medir,
+ * juega las mismas partidas con un Board por partida, evitando los choques
+ * inmediatos para que las partidas sean largas, y compara los hashes tras cada paso.
+ * Antes, comprueba en todos los niveles y en tableros de 4 a 40 columnas por 2 a
+ * 30 filas, con una y dos serpientes, que Board::reset cuenta bien las celdas
+ * libres (openCount), que se descuadra si una serpiente empieza sobre un muro.
+ */
+
+#include "Arduino.h"
+#include "board.hpp"
+#include "batch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+struct Config {
+	int envs = 4096;
+	unsigned long steps = 10000;
+	unsigned threads = 0;
+	uint32_t seed = 1;
+	int columns = 19;
+	int rows = 14;
+	byte level = 0;
+	bool wrap = false;
+	bool verify = false;
+};
+
+static uint32_t gameSeed(uint32_t base, uint32_t index){
+	//Mezcla de bits (splitmix32) para que semillas consecutivas no se parezcan
+	uint32_t z = base + index * 0x9E3779B9u;
+	z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+	z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+	z ^= z >> 16;
+	return z == 0 ? 1 : z;
+}
+
+static void worker(const Config* config, unsigned id, std::atomic<uint64_t>* games){
+	int first = (uint64_t)config->envs * id / config->threads;
+	int count = (uint64_t)config->envs * (id + 1) / config->threads - first;
+	BatchBoard batch(count, config->columns, config->rows, config->level, config->wrap);
+	Turn* actions = new Turn[count];
+	StepResult* results = new StepResult[count];
+	uint32_t index = first;
+	for (int env = 0; env < count; env++){
+		batch.reset(env, gameSeed(config->seed, index++));
+	}
+
+	Random random;
+	random.seed(gameSeed(~config->seed, id));
+	uint64_t finished = 0;
+	for (unsigned long step = 0; step < config->steps; step++){
+		for (int env = 0; env < count; env++){
+			actions[env] = (Turn)random.range(3);
+		}
+		batch.step(actions, results);
+		for (int env = 0; env < count; env++){
+			if (results[env] >= Collision){
+				//Los índices de partida no se repiten entre hilos
+				batch.reset(env, gameSeed(config->seed, index + (uint32_t)env * config->envs));
+				finished++;
+			}
+		}
+		index += config->envs * count;
+	}
+	games->fetch_add(finished);
+	delete[] actions;
+	delete[] results;
+}
+
+//Un giro aleatorio entre los que no chocan en el siguiente paso (Straight si chocan todos)
+static Turn safeTurn(Board* board, Random* random){
+	Turn safe[3];
+	byte count = 0;
+	Snake* snake = &board->snakes[0];
+	for (byte t = Straight; t <= TurnRight; t++){
+		Cell cell = snake->head;
+		int index = snake->headIndex;
+		if (board->neighbor(direction_turn(snake->direction, (Turn)t), &cell, &index) && board->itemMatrix[index] < SnakeObject){
+			safe[count++] = (Turn)t;
+		}
+	}
+	return count == 0 ? Straight : safe[random->range(count)];
+}
+
+/*
+ * Devuelve el número de tableros en los que, tras reset(), openCount no coincide
+ * con las celdas sin muro.
+ */
+static int checkResets(){
+	int mismatches = 0;
+	for (byte level = 0; level <= LEVEL_COUNT; level++){
+		for (int columns = 4; columns <= 40; columns++){
+			for (int rows = 2; rows <= 30; rows++){
+				for (byte snakeCount = 1; snakeCount <= BOARD_MAX_SNAKES; snakeCount++){
+					Board board(columns, rows, false, snakeCount);
+					board.reset(1, level);
+					int open = 0;
+					for (int i = 0; i < board.totalCount; i++){
+						if (board.itemMatrix[i] != Wall) open++;
+					}
+					if (open != board.openCount){
+						fprintf(stderr, "nivel %d, %dx%d, %d serpientes: openCount %d, celdas sin muro %d\n",
+								level, columns, rows, snakeCount, board.openCount, open);
+						mismatches++;
+					}
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+static int verify(const Config& config){
+	int resetMismatches = checkResets();
+	if (resetMismatches > 0){
+		printf("%d tableros con openCount DISTINTO de las celdas sin muro\n", resetMismatches);
+		return 1;
+	}
+
+	BatchBoard batch(config.envs, config.columns, config.rows, config.level, config.wrap);
+	std::vector<Board*> boards;
+	Turn* actions = new Turn[config.envs];
+	StepResult* results = new StepResult[config.envs];
+	uint32_t index = 0;
+	for (int env = 0; env < config.envs; env++){
+		boards.push_back(new Board(config.columns, config.rows, config.wrap));
+		uint32_t seed = gameSeed(config.seed, index++);
+		boards[env]->reset(seed, config.level);
+		batch.reset(env, seed);
+	}
+
+	Random random;
+	random.seed(config.seed);
+	unsigned long mismatches = 0;
+	uint64_t coins = 0, full = 0, games = 0;
+	for (unsigned long step = 0; step < config.steps && mismatches == 0; step++){
+		for (int env = 0; env < config.envs; env++){
+			actions[env] = safeTurn(boards[env], &random);
+		}
+		batch.step(actions, results);
+		for (int env = 0; env < config.envs; env++){
+			Board* board = boards[env];
+			StepResult expected = board->step(direction_turn(board->snakes[0].direction, actions[env]));
+			if (expected != results[env] || board->hash() != batch.hash(env)){
+				fprintf(stderr, "partida %d, paso %lu: resultado %d (esperado %d), hash %08lx (esperado %08lx)\n",
+						env, board->steps, results[env], expected, (unsigned long)batch.hash(env), (unsigned long)board->hash());
+				mismatches++;
+				continue;
+			}
+			if (expected == CoinEaten) coins++;
+			if (expected >= Collision){
+				if (expected == BoardFull) full++;
+				games++;
+				uint32_t seed = gameSeed(config.seed, index++);
+				board->reset(seed, config.level);
+				batch.reset(env, seed);
+			}
+		}
+	}
+
+	printf("%d partidas en paralelo, %llu terminadas (%llu con el tablero lleno), %llu monedas: %s\n",
+			config.envs, (unsigned long long)games, (unsigned long long)full, (unsigned long long)coins,
+			mismatches == 0 ? "igual que Board" : "DISTINTO de Board");
+	for (int env = 0; env < config.envs; env++){
+		delete boards[env];
+	}
+	delete[] actions;
+	delete[] results;
+	return mismatches == 0 ? 0 : 1;
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "Uso: %s [-n partidas] [-k pasos] [-j hilos] [-s semilla]\n"
+			"          [-x columnas] [-y filas] [-l nivel] [-w] [-v]\n", name);
+}
+
+int main(int argc, char** argv){
+	Config config;
+	for (int i = 1; i < argc; i++){
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : null;
+		if (strcmp(arg, "-v") == 0){
+			config.verify = true;
+			continue;
+		}
+		if (strcmp(arg, "-w") == 0){
+			config.wrap = true;
+			continue;
+		}
+		if (value == null || arg[0] != '-' || arg[2] != 0){
+			usage(argv[0]);
+			return 1;
+		}
+		switch(arg[1]){
+		case 'n': config.envs = atoi(value); break;
+		case 'k': config.steps = strtoul(value, null, 10); break;
+		case 'j': config.threads = strtoul(value, null, 10); break;
+		case 's': config.seed = strtoul(value, null, 10); break;
+		case 'x': config.columns = atoi(value); break;
+		case 'y': config.rows = atoi(value); break;
+		case 'l': config.level = atoi(value); break;
+		default: usage(argv[0]); return 1;
+		}
+		i++;
+	}
+
+	if (config.envs < 1 || config.columns < 4 || config.rows < 1 || config.level > LEVEL_COUNT){
+		usage(argv[0]);
+		return 1;
+	}
+	if (config.verify){
+		return verify(config);
+	}
+
+	if (config.threads == 0){
+		config.threads = std::thread::hardware_concurrency();
+		if (config.threads == 0) config.threads = 1;
+	}
+	if (config.threads > (unsigned)config.envs){
+		config.threads = config.envs;
+	}
+
+	std::atomic<uint64_t> games(0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < config.threads; i++){
+		threads.push_back(std::thread(worker, &config, i, &games));
+	}
+	for (unsigned i = 0; i < threads.size(); i++){
+		threads[i].join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double total = (double)config.envs * config.steps;
+	printf("board %dx%d%s, level %d, %d envs x %lu steps, %u threads, %.2f s\n",
+			config.columns, config.rows, config.wrap ? " (wrap)" : "", config.level, config.envs, config.steps,
+			config.threads, elapsed);
+	printf("%.1f M env-steps/s, %llu games finished\n", elapsed > 0 ? total / elapsed / 1e6 : 0.0,
+			(unsigned long long)games.load());
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Mide la regularidad de los pasos de la partida con una pantalla lenta. Juega
+ * partidas del modo demostración con el programa entero (como golden.cpp), pero
+ * con una pantalla simulada que tarda un tiempo virtual en cada escritura, y
+ * compara el tiempo entre pasos con el retraso previsto (el de las reglas o, si
+ * la pantalla no da para tanto, el mínimo de FrameBudget).
+ *
+ * Compilar desde la carpeta raíz del Sketch:
+ *
+ *   g++ -O2 -std=c++11 -Ihost -I. host/cadence.cpp host/arduino.cpp host/eeprom.cpp host/TFT.cpp \
+ *       snake.cpp screens.cpp storage.cpp highscores.cpp replay.cpp board.cpp autopilot.cpp reach.cpp settings.cpp levels.cpp font.cpp snapshot.cpp stats.cpp budget.cpp remote.cpp spectator.cpp -o cadence
+ *
+ * Uso:
+ *
+ *   ./cadence [-p ns por píxel] [-w ns por ventana] [-n pasos] [-s semilla]
+ *
+ * Una pantalla ST7735 a 8 MHz tarda unos 2000 ns por píxel (16 bits por SPI) y
+ * unos 10000 ns en abrir cada ventana de escritura.
+ */
+
+#include "snake.hpp"
+#include "screens.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv){
+	unsigned long nsPerPixel = 2000;
+	unsigned long nsPerWindow = 10000;
+	unsigned long maxSteps = 5000;
+	int seed = 345;
+	for (int i = 1; i < argc; i++){
+		if (i + 1 < argc && argv[i][0] == '-'){
+			switch (argv[i][1]){
+			case 'p': nsPerPixel = strtoul(argv[++i], null, 10); continue;
+			case 'w': nsPerWindow = strtoul(argv[++i], null, 10); continue;
+			case 'n': maxSteps = strtoul(argv[++i], null, 10); continue;
+			case 's': seed = atoi(argv[++i]); continue;
+			}
+		}
+		fprintf(stderr, "Uso: %s [-p ns por pixel] [-w ns por ventana] [-n pasos] [-s semilla]\n", argv[0]);
+		return 1;
+	}
+
+	host_set_analog(RANDOM_ANALOG_PIN, seed);
+	Game* game = new Game();
+	game->init();
+	Context* ctx = game->context;
+	ctx->screen->nsPerPixel = nsPerPixel;
+	ctx->screen->nsPerWindow = nsPerWindow;
+
+	//Desviación de cada intervalo entre pasos respecto al retraso previsto
+	unsigned long steps = 0;
+	unsigned long games = 0;
+	unsigned long irregular = 0;
+	unsigned long slowed = 0;
+	long maxLate = 0;
+	double totalDeviation = 0;
+	unsigned int maxFloor = 0;
+	unsigned long stepCost = 0;
+	unsigned long scoreCost = 0;
+
+	GameScreen* screen = null;
+	unsigned long lastSteps = 0;
+	unsigned long lastStart = 0;
+	unsigned int lastDelay = 0;
+	while (steps < maxSteps){
+		if (game->cscreen != screen){
+			//La demostración termina en el menú; se empieza otra
+			if (dynamic_cast<GameScreen*>(game->cscreen) == null){
+				game->initScreen(new GameScreen(ctx, Demo));
+			}
+			screen = (GameScreen*)game->cscreen;
+			lastSteps = 0;
+			games++;
+		}
+		unsigned long start = micros();
+		game->tick();
+		if (game->cscreen != screen || screen->board->steps == lastSteps) continue;
+
+		if (lastSteps != 0){
+			long deviation = (long)(start - lastStart) - (long)lastDelay * 1000;
+			totalDeviation += labs(deviation);
+			if (labs(deviation) > 2000) irregular++;
+			if (deviation > maxLate) maxLate = deviation;
+			steps++;
+		}
+		if (screen->budget.minDelay > (unsigned int)screen->board->movementDelay) slowed++;
+		if (screen->budget.minDelay > maxFloor) maxFloor = screen->budget.minDelay;
+		stepCost = screen->budget.cost(BudgetStep);
+		scoreCost = screen->budget.cost(BudgetScore);
+		lastSteps = screen->board->steps;
+		lastStart = start;
+		lastDelay = screen->stepDelay();
+	}
+
+	printf("%lu pasos en %lu partidas, pantalla de %lu ns/pixel y %lu ns/ventana\n", steps, games, nsPerPixel, nsPerWindow);
+	printf("coste medio: paso %lu us, marcador %lu us\n", stepCost, scoreCost);
+	printf("desviacion media %.2f ms, maxima %.2f ms; %lu pasos irregulares (> 2 ms)\n",
+			totalDeviation / steps / 1000, maxLate / 1000.0, irregular);
+	printf("retraso minimo de la pantalla: hasta %u ms (%lu pasos mas lentos que las reglas)\n", maxFloor, slowed);
+	return 0;
+}
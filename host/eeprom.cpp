@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Implementación de la EEPROM simulada y de sus registros de control.
+ */
+
+#include "Arduino.h"
+#include <EEPROM.h>
+#include <avr/io.h>
+
+EEPROMClass EEPROM;
+EepromControlRegister EECR;
+volatile uint16_t EEAR = 0;
+volatile uint8_t EEDR = 0;
+
+EEPROMClass::EEPROMClass(){
+	memset(memory, 0xFF, sizeof(memory));
+}
+
+EepromControlRegister& EepromControlRegister::operator|=(uint8_t bits){
+	if (bits & _BV(EERE)){
+		EEDR = EEPROM.memory[EEAR & E2END];
+	}
+	//La escritura se completa al instante, así que EEPE nunca queda activo
+	if ((bits & _BV(EEPE)) && (value & _BV(EEMPE))){
+		EEPROM.memory[EEAR & E2END] = EEDR;
+		value &= ~_BV(EEMPE);
+	}
+	value |= bits & (_BV(EEMPE) | _BV(EERIE));
+
+	//Con la EEPROM siempre libre, la interrupción salta mientras esté habilitada
+	if (!inInterrupt){
+		inInterrupt = true;
+		while (value & _BV(EERIE)){
+			EE_READY_vect();
+		}
+		inInterrupt = false;
+	}
+	return *this;
+}
+
+EepromControlRegister& EepromControlRegister::operator&=(uint8_t bits){
+	value &= bits;
+	return *this;
+}
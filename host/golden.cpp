@@ -0,0 +1,360 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Ejecuta el Sketch completo en el ordenador siguiendo una secuencia fija de
+ * controles (menú, partida, pausa, fin de partida...) y, en cada punto de
+ * control, compara el contenido de la pantalla y el coste de dibujo con los
+ * valores guardados en host/golden.txt.
+ *
+ * La comprobación falla si cambia alguna imagen o si aumentan los píxeles
+ * dibujados, ya sea en total o en el peor fotograma (loop) del tramo. Los
+ * cambios en las primitivas y en los cambios de estado se muestran, pero no
+ * hacen fallar la comprobación.
+ *
+ * Compilar desde la carpeta raíz del Sketch:
+ *
+ *   g++ -O2 -std=c++11 -DDRAW_STATS -Ihost -I. host/golden.cpp host/arduino.cpp host/eeprom.cpp host/TFT.cpp \
+ *       snake.cpp screens.cpp storage.cpp highscores.cpp replay.cpp board.cpp autopilot.cpp reach.cpp settings.cpp levels.cpp font.cpp snapshot.cpp stats.cpp budget.cpp remote.cpp spectator.cpp -o golden
+ *
+ * Con -DSCRIPTED_INPUT, los controles se fijan directamente con ScriptedInput
+ * (véase input.hpp) en lugar de simular los pines del joystick o de los botones.
+ *
+ * Uso:
+ *
+ *   ./golden [-g host/golden.txt] [-u] [-o carpeta]
+ *
+ *   -u  guarda los valores actuales como nuevos valores de referencia
+ *   -o  guarda la imagen de cada punto de control (formato PPM) en la carpeta
+ */
+
+#include "snake.hpp"
+#include <stdio.h>
+
+#ifndef DRAW_STATS
+#error "Compile with -DDRAW_STATS"
+#endif
+
+//Valor de la entrada analógica que se usa como semilla (la partida depende de ella)
+#define GOLDEN_RANDOM_SEED 345
+#define GOLDEN_MAX_CHECKPOINTS 64
+
+/*
+ * Un tramo de la secuencia: mantiene los controles indicados durante ms
+ * milisegundos del reloj virtual y, si tiene nombre, termina con un punto de
+ * control. Los controles se leen cada INPUT_POLL_INTERVAL milisegundos, así que
+ * los tramos más cortos pueden pasar desapercibidos. dir2 es la dirección del
+ * segundo jugador (solo con TWO_PLAYERS).
+ *
+ * En los tramos de partida, el total de píxeles depende de cuántos pasos de la
+ * serpiente caben en el tramo: un cambio en el ritmo de los pasos lo aumenta o
+ * lo reduce sin que cambie el coste de cada paso, que es lo que refleja el pico.
+ * Antes de regenerar los valores de referencia por un aumento del total, hay que
+ * comprobar que se debe a eso y explicarlo.
+ */
+typedef struct {
+	const char* name;
+	unsigned long ms;
+	Direction dir;
+	bool start;
+	Direction dir2;
+} ScriptStep;
+
+static const ScriptStep script[] = {
+	{"splash", 10, None, false},
+	{"menu", 760, None, false},
+	{null, 10, Down, false},
+	{"menu-down", 10, None, false},
+	{null, 10, Up, false},
+	{"menu-up", 10, None, false},
+	{"game-init", 10, None, true},
+	{null, 10, None, false},
+	{"countdown", 4335, None, false},
+	{"play", 3060, None, false},
+	{null, 10, Down, false},
+	{"turn-down", 2040, None, false},
+	{null, 10, Left, false},
+	{"turn-left", 1530, None, false},
+	{null, 10, None, true},
+	{"pause", 10, None, false},
+	{null, 10, Down, false},
+	{"pause-down", 10, None, false},
+	{null, 10, Up, false},
+	{null, 10, None, true},
+	{"resume", 4590, None, false},
+	{"game-over", 20400, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, true},
+	{"menu-scores", 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, true},
+	{"versus-init", 10, None, false},
+	{"versus-countdown", 4335, None, false},
+	{"versus-play", 2040, None, false},
+	{null, 10, Down, false, Up},
+	{"versus-turn", 1530, None, false},
+	{"versus-end", 20400, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, true},
+	{"versus-menu", 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, true},
+	{"board-settings", 10, None, false},
+	{null, 10, Left, false},
+	{"board-block", 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Right, false},
+	{"board-level", 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, false},
+	{null, 10, Right, false},
+	{"board-wrap", 10, None, false},
+	{null, 10, Down, false},
+	{null, 10, None, true},
+	{"board-save", 10, None, false},
+	{null, 10, None, true},
+	{null, 10, None, false},
+	{"board-game", 5100, None, false},
+	{"board-wrapped", 20400, None, false},
+};
+
+typedef struct {
+	char name[32];
+	uint64_t hash;
+	unsigned long pixels;
+	unsigned long peak;
+	unsigned long primitives;
+	unsigned long stateChanges;
+} Checkpoint;
+
+#ifndef SCRIPTED_INPUT
+static void setDirection(Direction dir, const byte* pins){
+#ifdef USE_JOYSTICK
+	int x = X_AXIS_CENTER;
+	int y = Y_AXIS_CENTER;
+	switch(dir){
+	case Left: x -= X_AXIS_MAX_VALUE * X_AXIS_LEFT; break;
+	case Right: x += X_AXIS_MAX_VALUE * X_AXIS_LEFT; break;
+	case Up: y += Y_AXIS_MAX_VALUE * Y_AXIS_UP; break;
+	case Down: y -= Y_AXIS_MAX_VALUE * Y_AXIS_UP; break;
+	default: break;
+	}
+	host_set_analog(pins[0], x);
+	host_set_analog(pins[1], y);
+#else
+	host_set_digital(pins[0], dir == Left);
+	host_set_digital(pins[1], dir == Right);
+	host_set_digital(pins[2], dir == Up);
+	host_set_digital(pins[3], dir == Down);
+#endif
+}
+
+#endif
+
+static void setInput(Direction dir, Direction dir2, bool start){
+#ifdef SCRIPTED_INPUT
+	ScriptedInput::start() = start;
+	ScriptedInput::direction(0) = dir;
+#ifdef TWO_PLAYERS
+	ScriptedInput::direction(1) = dir2;
+#endif
+#else
+	host_set_digital(BUTTON_START_PIN, start);
+#ifdef USE_JOYSTICK
+	static const byte pins[] = {X_AXIS_INPUT, Y_AXIS_INPUT};
+#ifdef TWO_PLAYERS
+	static const byte pins2[] = {X2_AXIS_INPUT, Y2_AXIS_INPUT};
+#endif
+#else
+	static const byte pins[] = {BUTTON_LEFT_PIN, BUTTON_RIGHT_PIN, BUTTON_UP_PIN, BUTTON_DOWN_PIN};
+#ifdef TWO_PLAYERS
+	static const byte pins2[] = {BUTTON2_LEFT_PIN, BUTTON2_RIGHT_PIN, BUTTON2_UP_PIN, BUTTON2_DOWN_PIN};
+#endif
+#endif
+	setDirection(dir, pins);
+#ifdef TWO_PLAYERS
+	setDirection(dir2, pins2);
+#endif
+#endif
+}
+
+static int runScript(Checkpoint* out, const char* imageDir){
+	host_set_analog(RANDOM_ANALOG_PIN, GOLDEN_RANDOM_SEED);
+	Game* game = new Game();
+	game->init();
+	Context* ctx = game->context;
+
+	//El coste de dibujo de init() se suma al primer tramo
+	Checkpoint current = {"", 0, ctx->stats.pixels, ctx->stats.pixels, ctx->stats.primitives, ctx->stats.stateChanges};
+	ctx->resetStats();
+
+	int count = 0;
+	for (size_t s = 0; s < sizeof(script) / sizeof(script[0]); s++){
+		const ScriptStep* step = &script[s];
+		setInput(step->dir, step->dir2, step->start);
+		//Cada iteración del loop es un fotograma; el reloj avanza con las esperas
+		//y cuando el juego duerme
+		unsigned long end = millis() + step->ms;
+		while ((long)(millis() - end) < 0){
+			game->tick();
+
+			current.pixels += ctx->stats.pixels;
+			current.primitives += ctx->stats.primitives;
+			current.stateChanges += ctx->stats.stateChanges;
+			if (ctx->stats.pixels > current.peak){
+				current.peak = ctx->stats.pixels;
+			}
+			ctx->resetStats();
+		}
+
+		if (step->name != null && count < GOLDEN_MAX_CHECKPOINTS){
+			snprintf(current.name, sizeof(current.name), "%s", step->name);
+			current.hash = ctx->screen->hash();
+			out[count++] = current;
+
+			if (imageDir != null){
+				char path[256];
+				snprintf(path, sizeof(path), "%s/%02d-%s.ppm", imageDir, count, step->name);
+				ctx->screen->save(path);
+			}
+			current = {"", 0, 0, 0, 0, 0};
+		}
+	}
+	return count;
+}
+
+static int loadGolden(const char* path, Checkpoint* out){
+	FILE* f = fopen(path, "r");
+	if (f == null) return -1;
+	char line[256];
+	int count = 0;
+	while (fgets(line, sizeof(line), f) != null && count < GOLDEN_MAX_CHECKPOINTS){
+		if (line[0] == '#' || line[0] == '\n') continue;
+		Checkpoint* c = &out[count];
+		unsigned long long hash;
+		if (sscanf(line, "%31s %llx %lu %lu %lu %lu", c->name, &hash, &c->pixels, &c->peak, &c->primitives, &c->stateChanges) == 6){
+			c->hash = hash;
+			count++;
+		}
+	}
+	fclose(f);
+	return count;
+}
+
+static bool saveGolden(const char* path, Checkpoint* checkpoints, int count){
+	FILE* f = fopen(path, "w");
+	if (f == null) return false;
+	fprintf(f, "# Valores de referencia de host/golden.cpp (regenerar con ./golden -u)\n");
+	fprintf(f, "# punto hash pixeles pico primitivas estados\n");
+	for (int i = 0; i < count; i++){
+		Checkpoint* c = &checkpoints[i];
+		fprintf(f, "%s %016llx %lu %lu %lu %lu\n", c->name, (unsigned long long)c->hash, c->pixels, c->peak, c->primitives, c->stateChanges);
+	}
+	fclose(f);
+	return true;
+}
+
+//Devuelve un indicador de la variación de un contador respecto a su referencia
+static char trend(unsigned long value, unsigned long reference){
+	return value > reference ? '+' : (value < reference ? '-' : ' ');
+}
+
+int main(int argc, char** argv){
+	const char* goldenPath = "host/golden.txt";
+	const char* imageDir = null;
+	bool update = false;
+	for (int i = 1; i < argc; i++){
+		if (strcmp(argv[i], "-u") == 0){
+			update = true;
+		}else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc){
+			goldenPath = argv[++i];
+		}else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+			imageDir = argv[++i];
+		}else{
+			fprintf(stderr, "Uso: %s [-g host/golden.txt] [-u] [-o carpeta]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Checkpoint actual[GOLDEN_MAX_CHECKPOINTS];
+	int count = runScript(actual, imageDir);
+
+	if (update){
+		if (!saveGolden(goldenPath, actual, count)){
+			fprintf(stderr, "No se puede escribir %s\n", goldenPath);
+			return 1;
+		}
+		printf("%d puntos de control guardados en %s\n", count, goldenPath);
+		return 0;
+	}
+
+	Checkpoint golden[GOLDEN_MAX_CHECKPOINTS];
+	int goldenCount = loadGolden(goldenPath, golden);
+	if (goldenCount < 0){
+		fprintf(stderr, "No se puede leer %s (utilice -u para crearlo)\n", goldenPath);
+		return 1;
+	}
+
+	int failures = 0;
+	printf("%-14s %-6s %10s %8s %6s %8s\n", "punto", "imagen", "pixeles", "pico", "prim.", "estados");
+	for (int i = 0; i < count; i++){
+		Checkpoint* a = &actual[i];
+		Checkpoint* g = null;
+		for (int j = 0; j < goldenCount; j++){
+			if (strcmp(golden[j].name, a->name) == 0){
+				g = &golden[j];
+				break;
+			}
+		}
+		if (g == null){
+			printf("%-14s sin valor de referencia\n", a->name);
+			failures++;
+			continue;
+		}
+
+		bool same = a->hash == g->hash;
+		bool costlier = a->pixels > g->pixels || a->peak > g->peak;
+		if (!same || costlier) failures++;
+		printf("%-14s %-6s %9lu%c %7lu%c %5lu%c %7lu%c\n", a->name, same ? "ok" : "CAMBIA",
+				a->pixels, trend(a->pixels, g->pixels), a->peak, trend(a->peak, g->peak),
+				a->primitives, trend(a->primitives, g->primitives), a->stateChanges, trend(a->stateChanges, g->stateChanges));
+	}
+	if (goldenCount != count){
+		printf("El número de puntos de control ha cambiado (%d, antes %d)\n", count, goldenCount);
+		failures++;
+	}
+
+	if (failures > 0){
+		printf("\n%d puntos de control no coinciden con la referencia\n", failures);
+		return 1;
+	}
+	printf("\nTodo correcto\n");
+	return 0;
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Espectador del flujo de dibujo de SPECTATOR_STREAM (véase spectator.hpp):
+ * lee las órdenes que envía la placa, las dibuja en un framebuffer igual que
+ * Context dibuja en la pantalla y guarda los fotogramas en formato PPM.
+ *
+ * Compilar desde la carpeta raíz del Sketch:
+ *
+ *   g++ -O2 -std=c++11 -Ihost -I. host/spectate.cpp font.cpp -o spectate
+ *
+ * Uso:
+ *
+ *   ./spectate [-o carpeta | -p] [-n fotogramas] [-l ultimo.ppm] [-h] [fichero]
+ *
+ *   -o  guarda cada fotograma en la carpeta (frame-00000.ppm, ...)
+ *   -p  escribe cada fotograma en la salida estándar, para verlo con
+ *       ffplay -f image2pipe -vcodec ppm -i -
+ *   -n  termina tras este número de fotogramas
+ *   -l  guarda el último fotograma
+ *   -h  escribe el hash de cada fotograma (el mismo que TFT::hash)
+ *
+ * Sin fichero, lee la entrada estándar. Para ver la placa en directo (Linux):
+ *
+ *   stty -F /dev/ttyACM0 115200 raw -echo
+ *   ./spectate -p /dev/ttyACM0 | ffplay -f image2pipe -vcodec ppm -i -
+ *
+ * Al terminar, muestra en la salida de errores los bytes por fotograma.
+ */
+
+#include "spectator.hpp"
+#include "font.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define SPECTATE_MAX_SIZE 1024
+
+static FILE* input;
+static unsigned long bytesRead = 0;
+
+static int next_byte(){
+	int value = fgetc(input);
+	if (value != EOF) bytesRead++;
+	return value;
+}
+
+class Viewer {
+public:
+	int width = 0;
+	int height = 0;
+	byte coordSize = 1;
+	uint16_t palette[SPECTATOR_PALETTE_SIZE];
+	std::vector<uint16_t> framebuffer;
+
+	//Lee y dibuja una orden. Devuelve false al final del flujo o si no es válida.
+	bool command(int op);
+	bool hello();
+
+	void fillArea(int x, int y, int w, int h, uint16_t color);
+	void frameRect(int x, int y, int w, int h, uint16_t color);
+	void glyph(int x, int y, char c, int size, uint16_t fore, const uint16_t* back);
+	uint64_t hash();
+	void save(FILE* f);
+private:
+	bool coord(int* value);
+	bool rect(int* r);
+};
+
+bool Viewer::hello(){
+	byte header[SPECTATOR_HELLO_SIZE - 3];
+	for (byte i = 0; i < sizeof(header); i++){
+		int value = next_byte();
+		if (value == EOF) return false;
+		header[i] = value;
+	}
+	int w = header[2] << 8 | header[3];
+	int h = header[4] << 8 | header[5];
+	if (header[0] != SPECTATOR_VERSION || header[1] < 1 || header[1] > 2
+			|| w < 1 || h < 1 || w > SPECTATE_MAX_SIZE || h > SPECTATE_MAX_SIZE){
+		return false;
+	}
+	coordSize = header[1];
+	width = w;
+	height = h;
+	framebuffer.assign(width * height, 0);
+	for (byte i = 0; i < SPECTATOR_PALETTE_SIZE; i++){
+		palette[i] = 0;
+	}
+	return true;
+}
+
+bool Viewer::coord(int* value){
+	*value = 0;
+	for (byte i = 0; i < coordSize; i++){
+		int b = next_byte();
+		if (b == EOF) return false;
+		*value = *value << 8 | b;
+	}
+	return true;
+}
+
+bool Viewer::rect(int* r){
+	for (byte i = 0; i < 4; i++){
+		if (!coord(&r[i])) return false;
+	}
+	return true;
+}
+
+bool Viewer::command(int op){
+	byte c = op & 0x0F;
+	int r[4];
+	switch (op & 0xF0){
+	case SPECTATOR_PALETTE: {
+		int hi = next_byte();
+		int lo = next_byte();
+		if (lo == EOF || c >= SPECTATOR_PALETTE_SIZE) return false;
+		palette[c] = hi << 8 | lo;
+		return true;
+	}
+	case SPECTATOR_FILL: {
+		int n = next_byte();
+		if (n == EOF || c >= SPECTATOR_PALETTE_SIZE) return false;
+		for (int i = 0; i < n; i++){
+			if (!rect(r)) return false;
+			fillArea(r[0], r[1], r[2], r[3], palette[c]);
+		}
+		return true;
+	}
+	case SPECTATOR_OUTLINE:
+		if (c >= SPECTATOR_PALETTE_SIZE || !rect(r)) return false;
+		frameRect(r[0], r[1], r[2], r[3], palette[c]);
+		return true;
+	case SPECTATOR_FRAMED: {
+		int stroke = next_byte();
+		if (stroke == EOF || stroke >= SPECTATOR_PALETTE_SIZE || c >= SPECTATOR_PALETTE_SIZE || !rect(r)) return false;
+		fillArea(r[0], r[1], r[2], r[3], palette[c]);
+		frameRect(r[0], r[1], r[2], r[3], palette[stroke]);
+		return true;
+	}
+	case SPECTATOR_TEXT: {
+		int style = next_byte();
+		int x, y;
+		if (style == EOF || c >= SPECTATOR_PALETTE_SIZE || !coord(&x) || !coord(&y)) return false;
+		int length = next_byte();
+		if (length == EOF) return false;
+		byte back = style & 0x0F;
+		int size = style >> 4;
+		for (int i = 0; i < length; i++){
+			int ch = next_byte();
+			if (ch == EOF) return false;
+			if (back == SPECTATOR_NO_COLOR){
+				//Como la librería: transparente y con salto de línea en el borde derecho
+				if (x + size * FONT_ADVANCE > width){
+					x = 0;
+					y += size * 8;
+				}
+				glyph(x, y, ch, size, palette[c], null);
+			}else{
+				if (back >= SPECTATOR_PALETTE_SIZE) return false;
+				glyph(x, y, ch, size, palette[c], &palette[back]);
+			}
+			x += size * FONT_ADVANCE;
+		}
+		return true;
+	}
+	case SPECTATOR_CLEAR:
+		if (c >= SPECTATOR_PALETTE_SIZE) return false;
+		fillArea(0, 0, width, height, palette[c]);
+		return true;
+	}
+	return false;
+}
+
+void Viewer::fillArea(int x, int y, int w, int h, uint16_t color){
+	if (x < 0){
+		w += x;
+		x = 0;
+	}
+	if (y < 0){
+		h += y;
+		y = 0;
+	}
+	if (x + w > width) w = width - x;
+	if (y + h > height) h = height - y;
+	for (int j = y; j < y + h; j++){
+		for (int i = x; i < x + w; i++){
+			framebuffer[j * width + i] = color;
+		}
+	}
+}
+
+//El borde de TFT::rect
+void Viewer::frameRect(int x, int y, int w, int h, uint16_t color){
+	if (w <= 0 || h <= 0) return;
+	fillArea(x, y, w, 1, color);
+	fillArea(x, y + h - 1, w, 1, color);
+	fillArea(x, y, 1, h, color);
+	fillArea(x + w - 1, y, 1, h, color);
+}
+
+//Un carácter de la fuente, opaco si back no es null (como Context::drawGlyphs)
+void Viewer::glyph(int x, int y, char c, int size, uint16_t fore, const uint16_t* back){
+	const byte* columns = font_glyph(c);
+	for (int col = 0; col < FONT_GLYPH_WIDTH; col++){
+		byte bits = pgm_read_byte(columns + col);
+		for (int row = 0; row < FONT_GLYPH_HEIGHT; row++){
+			if (bits & (1 << row)){
+				fillArea(x + col * size, y + row * size, size, size, fore);
+			}else if (back != null){
+				fillArea(x + col * size, y + row * size, size, size, *back);
+			}
+		}
+	}
+}
+
+uint64_t Viewer::hash(){
+	uint64_t h = 0xCBF29CE484222325ull;
+	const uint8_t* data = (const uint8_t*)framebuffer.data();
+	for (size_t i = 0; i < framebuffer.size() * sizeof(uint16_t); i++){
+		h ^= data[i];
+		h *= 0x100000001B3ull;
+	}
+	return h;
+}
+
+void Viewer::save(FILE* f){
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	for (uint16_t c : framebuffer){
+		uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)((c << 3) & 0xF8)};
+		fwrite(rgb, 1, 3, f);
+	}
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "Uso: %s [-o carpeta | -p] [-n fotogramas] [-l ultimo.ppm] [-h] [fichero]\n", name);
+}
+
+int main(int argc, char** argv){
+	const char* folder = null;
+	const char* last = null;
+	const char* path = null;
+	bool pipe = false;
+	bool hashes = false;
+	unsigned long maxFrames = 0;
+	for (int i = 1; i < argc; i++){
+		if (argv[i][0] != '-' || argv[i][1] == 0){
+			path = argv[i];
+			continue;
+		}
+		switch (argv[i][1]){
+		case 'p': pipe = true; continue;
+		case 'h': hashes = true; continue;
+		}
+		if (i + 1 < argc){
+			switch (argv[i][1]){
+			case 'o': folder = argv[++i]; continue;
+			case 'l': last = argv[++i]; continue;
+			case 'n': maxFrames = strtoul(argv[++i], null, 10); continue;
+			}
+		}
+		usage(argv[0]);
+		return 1;
+	}
+
+	input = path != null && strcmp(path, "-") != 0 ? fopen(path, "rb") : stdin;
+	if (input == null){
+		perror(path);
+		return 1;
+	}
+
+	Viewer viewer;
+	unsigned long frames = 0;
+	unsigned long errors = 0;
+	unsigned long frameStart = 0;
+	unsigned long maxFrameBytes = 0;
+	//Hasta el primer hello (o tras un error) solo se busca la sincronización
+	bool synced = false;
+	int op;
+	while ((op = next_byte()) != EOF){
+		if (op == SPECTATOR_HELLO){
+			if (next_byte() == 'S' && next_byte() == 'N'){
+				synced = viewer.hello();
+				frameStart = bytesRead;
+			}else if (synced){
+				errors++;
+				synced = false;
+			}
+			continue;
+		}
+		if (!synced) continue;
+
+		if (op == SPECTATOR_FRAME){
+			unsigned long size = bytesRead - frameStart;
+			if (size > maxFrameBytes) maxFrameBytes = size;
+			frameStart = bytesRead;
+			if (folder != null){
+				char name[512];
+				snprintf(name, sizeof(name), "%s/frame-%05lu.ppm", folder, frames);
+				FILE* f = fopen(name, "wb");
+				if (f == null){
+					perror(name);
+					return 1;
+				}
+				viewer.save(f);
+				fclose(f);
+			}
+			if (pipe){
+				viewer.save(stdout);
+				fflush(stdout);
+			}
+			if (hashes){
+				printf("%016llx\n", (unsigned long long)viewer.hash());
+			}
+			if (++frames == maxFrames) break;
+		}else if (!viewer.command(op)){
+			//Orden desconocida o incompleta: esperar al siguiente hello
+			errors++;
+			synced = false;
+		}
+	}
+
+	if (last != null && synced){
+		FILE* f = fopen(last, "wb");
+		if (f == null){
+			perror(last);
+			return 1;
+		}
+		viewer.save(f);
+		fclose(f);
+	}
+	fprintf(stderr, "%lu fotogramas, %lu bytes (%.1f por fotograma, maximo %lu), %lu errores\n",
+			frames, bytesRead, frames > 0 ? (double)bytesRead / frames : 0.0, maxFrameBytes, errors);
+	return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,440 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Ejecuta miles de partidas en el ordenador, repartidas entre todos los núcleos,
+ * utilizando exactamente las mismas reglas que la placa (clase Board) y mostrando
+ * la distribución de puntuaciones, longitudes y pasos. Sirve para evaluar cambios
+ * en las reglas o en la curva de velocidad antes de cargarlos en la placa.
+ *
+ * Compilar desde la carpeta raíz del Sketch:
+ *
+ *   g++ -O2 -std=c++11 -pthread -Ihost -I. host/tournament.cpp host/arduino.cpp board.cpp levels.cpp autopilot.cpp reach.cpp -o tournament
+ *
+ * Uso:
+ *
+ *   ./tournament [-n partidas] [-j hilos] [-s semilla] [-p autopilot|autopilot-bfs|greedy|random]
+ *                [-x columnas] [-y filas] [-l nivel] [-w] [-m pasos máximos] [-H]
+ *
+ * La política autopilot-bfs es el piloto automático tal como juega en una placa
+ * sin memoria para el núcleo de alcanzabilidad.
+ *
+ * Cada trabajador tiene su propio rango de partidas pendientes, que consume por
+ * el principio; cuando se queda sin trabajo, roba la mitad final del rango de
+ * otro trabajador. Tanto el rango como las estadísticas se actualizan con
+ * operaciones atómicas, sin bloqueos.
+ */
+
+#include "Arduino.h"
+#include "board.hpp"
+#include "autopilot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+
+/*
+ * Una política decide la dirección de cada paso de la serpiente.
+ */
+class Policy {
+public:
+	virtual ~Policy(){}
+	virtual void begin(Board* board, uint32_t seed){}
+	virtual Direction decide(Board* board) = 0;
+	//La política no progresa y la partida debe terminar (véase Autopilot::stalled)
+	virtual bool stalled(){
+		return false;
+	}
+};
+
+//El piloto automático de la placa
+class AutopilotPolicy : public Policy {
+public:
+	//Con bitmaps a false, se comporta como en una placa sin memoria para el núcleo
+	AutopilotPolicy(bool bitmaps) : bitmaps(bitmaps){}
+	~AutopilotPolicy(){
+		delete pilot;
+	}
+	void begin(Board* board, uint32_t seed){
+		delete pilot;
+		pilot = new Autopilot(board, bitmaps);
+	}
+	Direction decide(Board* board){
+		return pilot->decide(board->snakes[0].direction, board->coinIndex);
+	}
+	bool stalled(){
+		return pilot->stalled();
+	}
+private:
+	bool bitmaps;
+	Autopilot* pilot = null;
+};
+
+//Avanza hacia la moneda por el eje más alejado, evitando los choques inmediatos
+class GreedyPolicy : public Policy {
+public:
+	Direction decide(Board* board){
+		Snake* snake = &board->snakes[0];
+		int dx = board->coin.x - snake->head.x;
+		int dy = board->coin.y - snake->head.y;
+
+		Direction preferred[4];
+		preferred[0] = abs(dx) >= abs(dy) ? (dx < 0 ? Left : Right) : (dy < 0 ? Up : Down);
+		preferred[1] = abs(dx) >= abs(dy) ? (dy < 0 ? Up : Down) : (dx < 0 ? Left : Right);
+		preferred[2] = direction_opposite(preferred[1]);
+		preferred[3] = direction_opposite(preferred[0]);
+		for (int i = 0; i < 4; i++){
+			if (free(board, preferred[i])) return preferred[i];
+		}
+		return snake->direction;
+	}
+protected:
+	static bool free(Board* board, Direction d){
+		Snake* snake = &board->snakes[0];
+		if (d == direction_opposite(snake->direction)) return false;
+		Cell cell = snake->head;
+		int index = snake->headIndex;
+		if (!board->neighbor(d, &cell, &index)) return false;
+		return board->itemMatrix[index] < SnakeObject;
+	}
+};
+
+//Elige al azar entre los movimientos que no chocan inmediatamente
+class RandomPolicy : public GreedyPolicy {
+public:
+	void begin(Board* board, uint32_t seed){
+		rng.seed(seed ^ 0x9E3779B9);
+	}
+	Direction decide(Board* board){
+		Direction options[4];
+		int count = 0;
+		for (byte d = Left; d <= Down; d++){
+			if (free(board, (Direction)d)) options[count++] = (Direction)d;
+		}
+		return count == 0 ? board->snakes[0].direction : options[rng.range(count)];
+	}
+private:
+	Random rng;
+};
+
+static Policy* createPolicy(const char* name){
+	if (strcmp(name, "autopilot") == 0) return new AutopilotPolicy(true);
+	if (strcmp(name, "autopilot-bfs") == 0) return new AutopilotPolicy(false);
+	if (strcmp(name, "greedy") == 0) return new GreedyPolicy();
+	if (strcmp(name, "random") == 0) return new RandomPolicy();
+	return null;
+}
+
+/*
+ * Histograma con 8 subdivisiones por cada potencia de 2 (error relativo < 12.5%).
+ */
+#define HISTOGRAM_BUCKETS (64 * 8)
+
+static int bucketOf(uint64_t v){
+	if (v < 8) return (int)v;
+	int exp = 63 - __builtin_clzll(v);
+	return (exp - 2) * 8 + (int)((v >> (exp - 3)) & 7);
+}
+
+static uint64_t bucketLow(int b){
+	if (b < 8) return b;
+	int exp = b / 8 + 2;
+	return ((uint64_t)(8 | (b % 8))) << (exp - 3);
+}
+
+struct Distribution {
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> min;
+	std::atomic<uint64_t> max;
+	std::atomic<double> sumSq;
+	std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+
+	Distribution() : sum(0), min(UINT64_MAX), max(0), sumSq(0){
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) buckets[i] = 0;
+	}
+
+	void add(uint64_t v){
+		sum.fetch_add(v, std::memory_order_relaxed);
+		buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t m = min.load(std::memory_order_relaxed);
+		while (v < m && !min.compare_exchange_weak(m, v, std::memory_order_relaxed));
+		m = max.load(std::memory_order_relaxed);
+		while (v > m && !max.compare_exchange_weak(m, v, std::memory_order_relaxed));
+		double s = sumSq.load(std::memory_order_relaxed);
+		while (!sumSq.compare_exchange_weak(s, s + (double)v * v, std::memory_order_relaxed));
+	}
+
+	uint64_t percentile(uint64_t count, double p){
+		uint64_t target = (uint64_t)ceil(count * p);
+		uint64_t acc = 0;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++){
+			acc += buckets[i].load();
+			if (acc >= target && acc > 0) return bucketLow(i);
+		}
+		return max.load();
+	}
+
+	void print(const char* name, uint64_t count){
+		if (count == 0) return;
+		double mean = (double)sum.load() / count;
+		double var = sumSq.load() / count - mean * mean;
+		printf("%-8s mean %10.1f  sd %9.1f  min %8llu  p10 %8llu  p50 %8llu  p90 %8llu  max %8llu\n",
+				name, mean, sqrt(var > 0 ? var : 0), (unsigned long long)min.load(),
+				(unsigned long long)percentile(count, 0.1), (unsigned long long)percentile(count, 0.5),
+				(unsigned long long)percentile(count, 0.9), (unsigned long long)max.load());
+	}
+
+	void printHistogram(const char* name){
+		printf("\n%s (desde, partidas)\n", name);
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++){
+			uint64_t n = buckets[i].load();
+			if (n > 0) printf("  %10llu %8llu\n", (unsigned long long)bucketLow(i), (unsigned long long)n);
+		}
+	}
+};
+
+struct Results {
+	std::atomic<uint64_t> games;
+	std::atomic<uint64_t> wins;
+	std::atomic<uint64_t> collisions;
+	std::atomic<uint64_t> timeouts;
+	std::atomic<uint64_t> stalls;
+	Distribution score;
+	Distribution length;
+	Distribution steps;
+	//Tiempo de juego simulado (suma de movementDelay en cada paso), en segundos
+	Distribution seconds;
+
+	Results() : games(0), wins(0), collisions(0), timeouts(0), stalls(0){}
+};
+
+/*
+ * Rango [begin, end) de partidas pendientes de un trabajador, empaquetado en un
+ * único entero de 64 bits para poder modificarlo con una sola operación atómica.
+ */
+struct alignas(64) WorkRange {
+	std::atomic<uint64_t> range;
+
+	static uint64_t pack(uint32_t begin, uint32_t end){
+		return ((uint64_t)begin << 32) | end;
+	}
+
+	void set(uint32_t begin, uint32_t end){
+		range.store(pack(begin, end));
+	}
+
+	//El propietario toma la primera partida del rango
+	bool take(uint32_t* job){
+		uint64_t r = range.load();
+		while (true){
+			uint32_t begin = r >> 32;
+			uint32_t end = (uint32_t)r;
+			if (begin >= end) return false;
+			if (range.compare_exchange_weak(r, pack(begin + 1, end))){
+				*job = begin;
+				return true;
+			}
+		}
+	}
+
+	//Otro trabajador roba la mitad final del rango
+	bool steal(uint32_t* begin, uint32_t* end){
+		uint64_t r = range.load();
+		while (true){
+			uint32_t b = r >> 32;
+			uint32_t e = (uint32_t)r;
+			if (b >= e) return false;
+			uint32_t mid = b + (e - b) / 2;
+			if (range.compare_exchange_weak(r, pack(b, mid))){
+				*begin = mid;
+				*end = e;
+				return true;
+			}
+		}
+	}
+};
+
+struct Config {
+	uint32_t games = 10000;
+	unsigned threads = 0;
+	uint32_t seed = 1;
+	const char* policy = "autopilot";
+	int columns = 19;
+	int rows = 14;
+	byte level = 0;
+	bool wrap = false;
+	unsigned long maxSteps = 200000;
+	bool histogram = false;
+};
+
+static uint32_t gameSeed(uint32_t base, uint32_t index){
+	//Mezcla de bits (splitmix32) para que semillas consecutivas no se parezcan
+	uint32_t z = base + index * 0x9E3779B9u;
+	z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+	z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+	z ^= z >> 16;
+	return z == 0 ? 1 : z;
+}
+
+static void playGame(const Config& config, Board* board, Policy* policy, uint32_t index, Results* results){
+	uint32_t seed = gameSeed(config.seed, index);
+	board->reset(seed, config.level);
+	policy->begin(board, seed);
+
+	StepResult result = Moved;
+	double millis = 0;
+	bool stalled = false;
+	while (board->steps < config.maxSteps){
+		millis += board->movementDelay;
+		result = board->step(policy->decide(board));
+		if (result == Collision || result == BoardFull) break;
+		if ((stalled = policy->stalled())) break;
+	}
+
+	results->games.fetch_add(1, std::memory_order_relaxed);
+	if (result == BoardFull) results->wins.fetch_add(1, std::memory_order_relaxed);
+	else if (result == Collision) results->collisions.fetch_add(1, std::memory_order_relaxed);
+	else if (stalled) results->stalls.fetch_add(1, std::memory_order_relaxed);
+	else results->timeouts.fetch_add(1, std::memory_order_relaxed);
+
+	results->score.add(board->snakes[0].score);
+	results->length.add(board->snakes[0].blocks->size());
+	results->steps.add(board->steps);
+	results->seconds.add((uint64_t)(millis / 1000));
+}
+
+static void worker(const Config* config, std::vector<WorkRange>* queues, unsigned id, Results* results){
+	Board board(config->columns, config->rows, config->wrap);
+	Policy* policy = createPolicy(config->policy);
+	WorkRange& own = (*queues)[id];
+	unsigned count = queues->size();
+
+	while (true){
+		uint32_t job;
+		if (own.take(&job)){
+			playGame(*config, &board, policy, job, results);
+			continue;
+		}
+
+		//Sin trabajo propio: intentar robar a los demás, empezando por el siguiente
+		bool stolen = false;
+		for (unsigned i = 1; i < count && !stolen; i++){
+			uint32_t begin, end;
+			if ((*queues)[(id + i) % count].steal(&begin, &end)){
+				own.set(begin, end);
+				stolen = true;
+			}
+		}
+		//No se crea trabajo nuevo durante la ejecución, así que si no queda nada
+		//que robar, el resto de partidas ya están en manos de otros trabajadores.
+		if (!stolen) break;
+	}
+	delete policy;
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "Uso: %s [-n partidas] [-j hilos] [-s semilla] [-p autopilot|autopilot-bfs|greedy|random]\n"
+			"          [-x columnas] [-y filas] [-l nivel] [-w] [-m pasos maximos] [-H]\n", name);
+}
+
+int main(int argc, char** argv){
+	Config config;
+	for (int i = 1; i < argc; i++){
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : null;
+		if (strcmp(arg, "-H") == 0){
+			config.histogram = true;
+			continue;
+		}
+		if (strcmp(arg, "-w") == 0){
+			config.wrap = true;
+			continue;
+		}
+		if (value == null || arg[0] != '-' || arg[2] != 0){
+			usage(argv[0]);
+			return 1;
+		}
+		switch(arg[1]){
+		case 'n': config.games = strtoul(value, null, 10); break;
+		case 'j': config.threads = strtoul(value, null, 10); break;
+		case 's': config.seed = strtoul(value, null, 10); break;
+		case 'p': config.policy = value; break;
+		case 'x': config.columns = atoi(value); break;
+		case 'y': config.rows = atoi(value); break;
+		case 'l': config.level = atoi(value); break;
+		case 'm': config.maxSteps = strtoul(value, null, 10); break;
+		default: usage(argv[0]); return 1;
+		}
+		i++;
+	}
+
+	Policy* check = createPolicy(config.policy);
+	if (check == null || config.columns < 4 || config.rows < 1 || config.level > LEVEL_COUNT){
+		usage(argv[0]);
+		return 1;
+	}
+	delete check;
+
+	if (config.threads == 0){
+		config.threads = std::thread::hardware_concurrency();
+		if (config.threads == 0) config.threads = 1;
+	}
+
+	//Repartir las partidas en rangos iguales; el robo equilibra el resto
+	std::vector<WorkRange> queues(config.threads);
+	for (unsigned i = 0; i < config.threads; i++){
+		queues[i].set((uint64_t)config.games * i / config.threads, (uint64_t)config.games * (i + 1) / config.threads);
+	}
+
+	Results* results = new Results();
+	//El reloj de host/arduino.cpp es virtual; el tiempo real se mide aparte
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < config.threads; i++){
+		threads.push_back(std::thread(worker, &config, &queues, i, results));
+	}
+	for (unsigned i = 0; i < threads.size(); i++){
+		threads[i].join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t games = results->games.load();
+	printf("policy %s, board %dx%d%s, level %d, %llu games, %u threads, %.2f s (%.0f games/s)\n",
+			config.policy, config.columns, config.rows, config.wrap ? " (wrap)" : "", config.level, (unsigned long long)games,
+			config.threads, elapsed, elapsed > 0 ? games / elapsed : 0.0);
+	printf("wins %llu, collisions %llu, stalled %llu, step limit %llu\n\n", (unsigned long long)results->wins.load(),
+			(unsigned long long)results->collisions.load(), (unsigned long long)results->stalls.load(),
+			(unsigned long long)results->timeouts.load());
+	results->score.print("score", games);
+	results->length.print("length", games);
+	results->steps.print("steps", games);
+	results->seconds.print("time(s)", games);
+
+	if (config.histogram){
+		results->score.printHistogram("score");
+		results->length.printHistogram("length");
+		results->steps.printHistogram("steps");
+	}
+	delete results;
+	return 0;
+}
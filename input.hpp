@@ -0,0 +1,243 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene los dispositivos de entrada que pueden controlar el juego.
+ *
+ * Cada dispositivo es una clase con métodos estáticos inline (una "política"):
+ *
+ *   static void begin();                        configura sus pines
+ *   static void read(Input* in, Point center);  lee x, y, rawX, rawY y currentDir
+ *
+ * y los botones de start, en lugar de read(Input*, Point):
+ *
+ *   static bool read();                         devuelve true si está pulsado
+ *
+ * El dispositivo de cada jugador se elige al compilar (véanse los typedef del
+ * final), por lo que Game no necesita funciones virtuales ni #ifdef para leerlos
+ * y el compilador puede expandir cada lectura en el propio loop. Para añadir un
+ * dispositivo basta con escribir su clase y seleccionarla aquí.
+ */
+
+#ifndef input_hpp
+#define input_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#ifdef ARDUINO_AVR_ESPLORA
+#include <Esplora.h>
+#endif
+
+#ifdef USE_JOYSTICK
+/*
+ * Convierte los valores analógicos (rawX, rawY) de un joystick, cuyo reposo está
+ * en center, en las coordenadas x e y y en una dirección.
+ */
+extern inline void joystick_direction(Input* in, Point center){
+	in->x = (in->rawX - center.x) * X_AXIS_LEFT;
+	in->y = (in->rawY - center.y) * Y_AXIS_UP;
+
+	if (in->x > X_AXIS_MAX_VALUE){
+		in->x = X_AXIS_MAX_VALUE;
+	}else if (in->x < -X_AXIS_MAX_VALUE){
+		in->x = -X_AXIS_MAX_VALUE;
+	}
+
+	if (in->y > Y_AXIS_MAX_VALUE){
+		in->y = Y_AXIS_MAX_VALUE;
+	}else if (in->y < -Y_AXIS_MAX_VALUE){
+		in->y = -Y_AXIS_MAX_VALUE;
+	}
+
+	int xabs = abs(in->x);
+	int yabs = abs(in->y);
+	if (xabs > yabs && xabs >= JOY_DETECT_THRESHOLD) {
+		if (in->x > 0) in->currentDir = Right; else in->currentDir = Left;
+	} else if (yabs > xabs && yabs > JOY_DETECT_THRESHOLD) {
+		if (in->y > 0) in->currentDir = Up; else in->currentDir = Down;
+	} else {
+		in->currentDir = None;
+	}
+}
+#endif
+
+/*
+ * Fija la dirección de un dispositivo sin ejes (botones o controles simulados):
+ * las coordenadas toman el valor máximo en la dirección pulsada.
+ */
+extern inline void digital_direction(Input* in, Direction dir){
+	in->currentDir = dir;
+	in->x = dir == Left ? -512 : (dir == Right ? 512 : 0);
+	in->y = dir == Down ? -512 : (dir == Up ? 512 : 0);
+	in->rawX = in->x;
+	in->rawY = in->y;
+}
+
+#if defined(USE_JOYSTICK) && !defined(ARDUINO_AVR_ESPLORA)
+//Joystick analógico conectado a los pines XPin e YPin
+template <byte XPin, byte YPin>
+class AnalogJoystick {
+public:
+	static inline void begin(){
+		pinMode(XPin, INPUT);
+		pinMode(YPin, INPUT);
+	}
+	static inline void read(Input* in, Point center){
+		in->rawX = analogRead(XPin);
+		in->rawY = analogRead(YPin);
+		joystick_direction(in, center);
+	}
+};
+#endif
+
+//Cuatro botones de dirección (si se pulsan varios, gana el primero de la lista)
+template <byte LeftPin, byte RightPin, byte UpPin, byte DownPin>
+class DigitalButtons {
+public:
+	static inline void begin(){
+		pinMode(LeftPin, INPUT);
+		pinMode(RightPin, INPUT);
+		pinMode(UpPin, INPUT);
+		pinMode(DownPin, INPUT);
+	}
+	static inline void read(Input* in, Point center){
+		if (digitalRead(LeftPin) == HIGH){
+			digital_direction(in, Left);
+		}else if (digitalRead(RightPin) == HIGH){
+			digital_direction(in, Right);
+		}else if (digitalRead(UpPin) == HIGH){
+			digital_direction(in, Up);
+		}else if (digitalRead(DownPin) == HIGH){
+			digital_direction(in, Down);
+		}else{
+			digital_direction(in, None);
+		}
+	}
+};
+
+//Botón de start conectado al pin Pin (activo a nivel alto)
+template <byte Pin>
+class StartButton {
+public:
+	static inline void begin(){
+		pinMode(Pin, INPUT);
+	}
+	static inline bool read(){
+		return digitalRead(Pin);
+	}
+};
+
+#ifdef ARDUINO_AVR_ESPLORA
+//Joystick de la Arduino Esplora
+class EsploraJoystick {
+public:
+	static inline void begin(){}
+	static inline void read(Input* in, Point center){
+		in->rawX = Esplora.readJoystickX();
+		in->rawY = Esplora.readJoystickY();
+		joystick_direction(in, center);
+	}
+};
+
+//En la Arduino Esplora, cualquiera de los botones (o el del joystick) hace de start
+class EsploraStartButton {
+public:
+	static inline void begin(){}
+	static inline bool read(){
+		return (Esplora.readJoystickButton() & Esplora.readButton(SWITCH_LEFT) & Esplora.readButton(SWITCH_RIGHT) & Esplora.readButton(SWITCH_UP) & Esplora.readButton(SWITCH_DOWN)) == LOW;
+	}
+};
+#endif
+
+#if defined(SCRIPTED_INPUT) || defined(SERIAL_REMOTE)
+/*
+ * Controles simulados: el programa que ejecuta el juego (por ejemplo, las
+ * herramientas de host/) o el control remoto (véase remote.hpp) fijan su estado
+ * antes de cada tick, sin pasar por los pines.
+ */
+class ScriptedInput {
+public:
+	static inline Direction& direction(byte player){
+		static Direction dirs[PLAYER_COUNT];
+		return dirs[player];
+	}
+	static inline bool& start(){
+		static bool pressed;
+		return pressed;
+	}
+};
+
+template <byte Player>
+class ScriptedDirection {
+public:
+	static inline void begin(){}
+	static inline void read(Input* in, Point center){
+		digital_direction(in, ScriptedInput::direction(Player));
+	}
+};
+
+class ScriptedStart {
+public:
+	static inline void begin(){}
+	static inline bool read(){
+		return ScriptedInput::start();
+	}
+};
+#endif
+
+/*
+ * Lee el dispositivo Device y actualiza in. Devuelve true si la dirección ha
+ * cambiado desde la lectura anterior (en ese caso, in->dir es la nueva dirección).
+ */
+template <class Device>
+inline bool input_read_direction(Input* in, Point center){
+	Device::read(in, center);
+	if (in->lastDir == in->currentDir){
+		in->dir = None;
+		return false;
+	}
+	in->dir = in->currentDir;
+	in->lastDir = in->currentDir;
+	return true;
+}
+
+//Dispositivos seleccionados
+#if defined(SCRIPTED_INPUT) || defined(SERIAL_REMOTE)
+typedef ScriptedStart StartDevice;
+typedef ScriptedDirection<0> Player1Device;
+typedef ScriptedDirection<1> Player2Device;
+#elif defined(ARDUINO_AVR_ESPLORA)
+typedef EsploraStartButton StartDevice;
+typedef EsploraJoystick Player1Device;
+#else
+typedef StartButton<BUTTON_START_PIN> StartDevice;
+#ifdef USE_JOYSTICK
+typedef AnalogJoystick<X_AXIS_INPUT, Y_AXIS_INPUT> Player1Device;
+#ifdef TWO_PLAYERS
+typedef AnalogJoystick<X2_AXIS_INPUT, Y2_AXIS_INPUT> Player2Device;
+#endif
+#else
+typedef DigitalButtons<BUTTON_LEFT_PIN, BUTTON_RIGHT_PIN, BUTTON_UP_PIN, BUTTON_DOWN_PIN> Player1Device;
+#ifdef TWO_PLAYERS
+typedef DigitalButtons<BUTTON2_LEFT_PIN, BUTTON2_RIGHT_PIN, BUTTON2_UP_PIN, BUTTON2_DOWN_PIN> Player2Device;
+#endif
+#endif
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene los mapas de los niveles y su decodificación.
+ */
+
+#include "levels.hpp"
+#include <avr/pgmspace.h>
+
+#define LEVEL_WALL 0x80
+#define LEVEL_LENGTH_MASK 0x7F
+
+/*
+ * Nivel 1: cajas
+ *
+ *   ...................
+ *   ...................
+ *   ...................
+ *   ...###.......###...
+ *   ...###.......###...
+ *   ...................
+ *   ...................
+ *   ...................
+ *   ...................
+ *   ...###.......###...
+ *   ...###.......###...
+ *   ...................
+ *   ...................
+ *   ...................
+ */
+static const byte LEVEL_BOXES[] PROGMEM = {19, 14,
+		0x3C, 0x83, 0x07, 0x83, 0x06, 0x83, 0x07, 0x83, 0x52, 0x83, 0x07, 0x83, 0x06, 0x83, 0x07, 0x83, 0x3C};
+
+/*
+ * Nivel 2: cruz
+ *
+ *   ...................
+ *   ...................
+ *   .........#.........
+ *   .........#.........
+ *   .........#.........
+ *   .........#.........
+ *   ...................
+ *   ...#####...#####...
+ *   ...................
+ *   .........#.........
+ *   .........#.........
+ *   .........#.........
+ *   ...................
+ *   ...................
+ */
+static const byte LEVEL_CROSS[] PROGMEM = {19, 14,
+		0x2F, 0x81, 0x12, 0x81, 0x12, 0x81, 0x12, 0x81, 0x1F, 0x85, 0x03, 0x85, 0x1F, 0x81, 0x12, 0x81, 0x12, 0x81, 0x2F};
+
+/*
+ * Nivel 3: pasillos
+ *
+ *   ...................
+ *   ...................
+ *   ...................
+ *   #############......
+ *   ...................
+ *   ...................
+ *   ...................
+ *   ......#############
+ *   ...................
+ *   ...................
+ *   ...................
+ *   #############......
+ *   ...................
+ *   ...................
+ */
+static const byte LEVEL_CORRIDORS[] PROGMEM = {19, 14,
+		0x39, 0x8D, 0x45, 0x8D, 0x39, 0x8D, 0x2C};
+
+static const byte* const LEVELS[LEVEL_COUNT] PROGMEM = {LEVEL_BOXES, LEVEL_CROSS, LEVEL_CORRIDORS};
+
+//Primera celda del tablero que corresponde a la celda n del mapa (redondeando hacia arriba)
+static inline int scale(int n, int boardCount, int mapCount){
+	return (n * boardCount + mapCount - 1) / mapCount;
+}
+
+LevelDecoder::LevelDecoder(byte level, int columns, int rows){
+	this->columns = columns;
+	this->rows = rows;
+	if (level == 0 || level > LEVEL_COUNT){
+		data = null;
+		width = height = 0;
+		return;
+	}
+	data = (const byte*)pgm_read_ptr(&LEVELS[level - 1]);
+	width = pgm_read_byte(data++);
+	height = pgm_read_byte(data++);
+}
+
+bool LevelDecoder::next(WallRun* run){
+	while (y < height){
+		if (remaining == 0){
+			byte b = pgm_read_byte(data++);
+			wall = b & LEVEL_WALL;
+			remaining = b & LEVEL_LENGTH_MASK;
+		}
+
+		//La parte del tramo que queda en esta fila
+		byte length = remaining < width - x ? remaining : width - x;
+		byte from = x;
+		byte row = y;
+		remaining -= length;
+		x += length;
+		if (x == width){
+			x = 0;
+			y++;
+		}
+
+		if (wall){
+			int x0 = scale(from, columns, width);
+			int x1 = scale(from + length, columns, width);
+			int y0 = scale(row, rows, height);
+			int y1 = scale(row + 1, rows, height);
+			//Al reducir el mapa, algunos tramos no llegan a ocupar ninguna celda
+			if (x1 > x0 && y1 > y0){
+				*run = {(byte)x0, (byte)y0, (byte)(x1 - x0), (byte)(y1 - y0)};
+				return true;
+			}
+		}
+	}
+	return false;
+}
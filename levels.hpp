@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de los niveles: mapas de muros que se
+ * guardan comprimidos en la memoria flash y se leen directamente de ella, sin
+ * copiarlos a la RAM.
+ *
+ * Cada mapa empieza con su ancho y su alto, en celdas, seguidos de una serie de
+ * tramos de celdas consecutivas, recorriendo el mapa por filas. Cada tramo ocupa
+ * un byte: el bit 7 indica si sus celdas son muros y los 7 bits inferiores, su
+ * longitud (1 - 127). Un tramo puede continuar en la fila siguiente.
+ *
+ * Los mapas se escalan al tamaño del tablero, por lo que un mismo nivel sirve
+ * para cualquier tamaño de bloque. La primera y la última fila de todos los mapas
+ * deben estar libres, ya que es donde empiezan las serpientes (la segunda solo en
+ * las partidas de dos jugadores).
+ */
+
+#ifndef levels_hpp
+#define levels_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+
+//Número de niveles con muros (el nivel 0 es el tablero vacío)
+#define LEVEL_COUNT 3
+
+/*
+ * Un rectángulo de muros, en celdas del tablero
+ */
+typedef struct {
+	byte x;
+	byte y;
+	byte w;
+	byte h;
+} WallRun;
+
+/*
+ * Recorre los muros de un nivel, escalados a un tablero de columns x rows
+ * celdas, devolviendo un rectángulo por cada tramo de muros de cada fila del
+ * mapa. Los rectángulos nunca se solapan.
+ */
+class LevelDecoder {
+public:
+	LevelDecoder(byte level, int columns, int rows);
+
+	//Obtiene el siguiente rectángulo de muros. Devuelve false si no quedan más.
+	bool next(WallRun* run);
+private:
+	const byte* data;
+	byte width;
+	byte height;
+	int columns;
+	int rows;
+
+	//Posición actual en el mapa y tramo que se está leyendo
+	byte x = 0;
+	byte y = 0;
+	byte remaining = 0;
+	bool wall = false;
+};
+
+#endif
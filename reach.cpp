@@ -0,0 +1,263 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación del núcleo de alcanzabilidad.
+ */
+
+#include "reach.hpp"
+
+//Cabecera de cada reserva de memoria (el objeto y sus tres arrays) en AVR
+#define REACH_MALLOC_OVERHEAD 2
+
+Reachability::Reachability(int horizontalCount, int verticalCount, bool wrap){
+	this->horizontalCount = horizontalCount;
+	this->verticalCount = verticalCount;
+	this->wrap = wrap;
+	rowWords = (horizontalCount + REACH_WORD_BITS - 1) / REACH_WORD_BITS;
+	freeBits = new ReachWord[verticalCount * rowWords]();
+	reachBits = new ReachWord[verticalCount * rowWords]();
+	scratch = new ReachWord[3 * rowWords];
+}
+
+Reachability::~Reachability(){
+	delete[] freeBits;
+	delete[] reachBits;
+	delete[] scratch;
+}
+
+unsigned int Reachability::ramNeeded(int columns, int rows){
+	unsigned int rowWords = (columns + REACH_WORD_BITS - 1) / REACH_WORD_BITS;
+	return (2 * rows + 3) * rowWords * sizeof(ReachWord) + sizeof(Reachability) + 4 * REACH_MALLOC_OVERHEAD;
+}
+
+void Reachability::load(const InGameItemType* matrix){
+	for (int y = 0; y < verticalCount; y++){
+		ReachWord* f = row(freeBits, y);
+		int x = 0;
+		for (int w = 0; w < rowWords; w++){
+			ReachWord word = 0;
+			for (byte bit = 0; bit < REACH_WORD_BITS && x < horizontalCount; bit++, x++){
+				word |= (ReachWord)((*matrix++ & ITEM_TYPE_MASK) < SnakeObject) << bit;
+			}
+			f[w] = word;
+		}
+	}
+}
+
+void Reachability::setFree(int index, bool free){
+	int x = index % horizontalCount;
+	ReachWord* word = row(freeBits, index / horizontalCount) + x / REACH_WORD_BITS;
+	ReachWord bit = (ReachWord)1 << (x % REACH_WORD_BITS);
+	if (free){
+		*word |= bit;
+	}else{
+		*word &= ~bit;
+	}
+}
+
+bool Reachability::reached(int index){
+	return reached(index % horizontalCount, index / horizontalCount);
+}
+
+bool Reachability::reached(int x, int y){
+	return (row(reachBits, y)[x / REACH_WORD_BITS] >> (x % REACH_WORD_BITS)) & 1;
+}
+
+bool Reachability::isFree(int x, int y){
+	return (row(freeBits, y)[x / REACH_WORD_BITS] >> (x % REACH_WORD_BITS)) & 1;
+}
+
+int Reachability::fill(int from, int target){
+	unsigned long start = micros();
+	memset(reachBits, 0, verticalCount * rowWords * sizeof(ReachWord));
+	setFree(from, true);
+	int x = from % horizontalCount;
+	int y = from / horizontalCount;
+	row(reachBits, y)[x / REACH_WORD_BITS] |= (ReachWord)1 << (x % REACH_WORD_BITS);
+	fillRow(y);
+
+	//Pasadas hacia abajo y hacia arriba hasta que no cambie ninguna fila. Las filas
+	//alcanzadas son contiguas, así que solo se recorren esas y sus vecinas.
+	int targetX = target % horizontalCount;
+	int targetY = target / horizontalCount;
+	int top = wrap ? 0 : y;
+	int bottom = wrap ? verticalCount - 1 : y;
+	bool changed = target < 0 || !reached(targetX, targetY);
+	while (changed){
+		changed = false;
+		for (y = top > 0 ? top - 1 : 0; y < verticalCount && y <= bottom + 1; y++){
+			if (spreadRow(y)){
+				changed = true;
+				if (y < top) top = y;
+				if (y > bottom) bottom = y;
+			}
+		}
+		for (y = bottom; y >= 0 && y >= top - 1; y--){
+			if (spreadRow(y)){
+				changed = true;
+				if (y < top) top = y;
+			}
+		}
+		if (target >= 0 && reached(targetX, targetY)) break;
+	}
+
+	int count = 0;
+	for (int i = 0; i < verticalCount * rowWords; i++){
+		for (ReachWord v = reachBits[i]; v != 0; v &= v - 1){
+			count++;
+		}
+	}
+
+	unsigned long elapsed = micros() - start;
+	if (elapsed > maxFillTime){
+		maxFillTime = elapsed;
+	}
+	return count;
+}
+
+bool Reachability::safeMove(Board* board, Snake* snake, int next){
+	bool eats = (board->itemMatrix[next] & ITEM_TYPE_MASK) == Coin;
+	int tail = board->indexOf(*snake->blocks->peek());
+	int target = tail;
+
+	load(board->itemMatrix);
+	if (!eats){
+		//La cola avanza y deja libre su celda
+		setFree(tail, true);
+		target = board->indexOf(*snake->blocks->itemAtHeadOffset(1));
+	}
+	setFree(target, true);
+	fill(next, target);
+	return reached(target);
+}
+
+/*
+ * Añade a la fila y las celdas libres vecinas de las filas de arriba y de abajo,
+ * y, si cambia, la rellena en horizontal. Devuelve true si ha cambiado.
+ */
+bool Reachability::spreadRow(int y){
+	ReachWord* r = row(reachBits, y);
+	const ReachWord* f = row(freeBits, y);
+	const ReachWord* above = y > 0 ? row(reachBits, y - 1) : wrap ? row(reachBits, verticalCount - 1) : null;
+	const ReachWord* below = y < verticalCount - 1 ? row(reachBits, y + 1) : wrap ? reachBits : null;
+
+	bool changed = false;
+	for (int w = 0; w < rowWords; w++){
+		ReachWord v = r[w];
+		if (above != null) v |= above[w];
+		if (below != null) v |= below[w];
+		v &= f[w];
+		if (v != r[w]){
+			r[w] = v;
+			changed = true;
+		}
+	}
+	if (changed){
+		fillRow(y);
+	}
+	return changed;
+}
+
+/*
+ * dst = src desplazado count columnas hacia la derecha (up = true) o hacia la
+ * izquierda. Las columnas que entran por el extremo son 0.
+ */
+static void shift_row(ReachWord* dst, const ReachWord* src, int words, int count, bool up){
+	int wordShift = count / REACH_WORD_BITS;
+	byte bitShift = count % REACH_WORD_BITS;
+	for (int w = 0; w < words; w++){
+		int from = up ? w - wordShift : w + wordShift;
+		int carry = up ? from - 1 : from + 1;
+		ReachWord v = 0;
+		if (from >= 0 && from < words){
+			v = up ? src[from] << bitShift : src[from] >> bitShift;
+		}
+		if (bitShift != 0 && carry >= 0 && carry < words){
+			v |= up ? src[carry] >> (REACH_WORD_BITS - bitShift) : src[carry] << (REACH_WORD_BITS - bitShift);
+		}
+		dst[w] = v;
+	}
+}
+
+/*
+ * Extiende las celdas alcanzadas de la fila hasta los extremos de sus tramos libres
+ * (relleno de Kogge-Stone: en cada paso, las celdas alcanzadas avanzan el doble que
+ * en el anterior, en los dos sentidos, a través de las celdas cuyos tramos libres
+ * ya se han comprobado). Termina antes si ya no queda ningún tramo tan largo.
+ */
+void Reachability::fillRow(int y){
+	ReachWord* r = row(reachBits, y);
+	const ReachWord* f = row(freeBits, y);
+	int last = horizontalCount - 1;
+
+	while (true){
+		if (rowWords == 1){
+			//Caso habitual: la fila cabe en una palabra
+			ReachWord reached = r[0];
+			ReachWord up = f[0];
+			ReachWord down = f[0];
+			for (int count = 1; count < horizontalCount && (up | down) != 0; count <<= 1){
+				reached |= (up & (ReachWord)(reached << count)) | (down & (reached >> count));
+				up &= up << count;
+				down &= down >> count;
+			}
+			r[0] = reached;
+		}else{
+			ReachWord* up = scratch;
+			ReachWord* down = scratch + rowWords;
+			ReachWord* shifted = scratch + 2 * rowWords;
+			memcpy(up, f, rowWords * sizeof(ReachWord));
+			memcpy(down, f, rowWords * sizeof(ReachWord));
+			for (int count = 1; count < horizontalCount; count <<= 1){
+				ReachWord any = 0;
+				shift_row(shifted, r, rowWords, count, true);
+				for (int w = 0; w < rowWords; w++){
+					r[w] |= up[w] & shifted[w];
+				}
+				shift_row(shifted, r, rowWords, count, false);
+				for (int w = 0; w < rowWords; w++){
+					r[w] |= down[w] & shifted[w];
+				}
+				shift_row(shifted, up, rowWords, count, true);
+				for (int w = 0; w < rowWords; w++){
+					any |= up[w] &= shifted[w];
+				}
+				shift_row(shifted, down, rowWords, count, false);
+				for (int w = 0; w < rowWords; w++){
+					any |= down[w] &= shifted[w];
+				}
+				if (any == 0) break;
+			}
+		}
+
+		//Sin bordes, un tramo que llega a un extremo continúa por el opuesto
+		if (!wrap) return;
+		ReachWord firstBit = 1;
+		ReachWord lastBit = (ReachWord)1 << (last % REACH_WORD_BITS);
+		ReachWord* lastWord = r + last / REACH_WORD_BITS;
+		bool firstFree = f[0] & firstBit;
+		bool lastFree = f[last / REACH_WORD_BITS] & lastBit;
+		bool firstReached = r[0] & firstBit;
+		bool lastReached = *lastWord & lastBit;
+		if (!firstFree || !lastFree || firstReached == lastReached) return;
+		r[0] |= firstBit;
+		*lastWord |= lastBit;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración del núcleo de alcanzabilidad, que calcula
+ * las celdas del tablero a las que puede llegar la cabeza de una serpiente. Lo
+ * utilizan el piloto automático, para no encerrarse, y el modo de ayuda
+ * (ASSIST_MODE en snake.hpp), que tiñe las celdas inalcanzables y avisa antes de
+ * un giro que encerraría a la serpiente.
+ *
+ * Las celdas libres se guardan como mapas de bits, fila a fila, con un bit por
+ * columna. El relleno avanza una fila entera en cada operación: en vertical, con
+ * un OR de las filas vecinas, y en horizontal, hasta el final de cada tramo libre,
+ * con un relleno por desplazamientos de 1, 2, 4... columnas (Kogge-Stone), en vez
+ * de celda a celda. Las filas se recorren hacia abajo y hacia arriba hasta que no
+ * cambia ninguna, por lo que el número de pasadas depende de las veces que los
+ * caminos cambian de sentido vertical, y no de su longitud.
+ *
+ * Las palabras tienen el tamaño de los registros: 8 bits en AVR y 32 fuera.
+ */
+
+#ifndef reach_hpp
+#define reach_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "board.hpp"
+
+#ifdef __AVR__
+typedef uint8_t ReachWord;
+#else
+typedef uint32_t ReachWord;
+#endif
+#define REACH_WORD_BITS (sizeof(ReachWord) * 8)
+
+class Reachability {
+public:
+	//Si wrap es true, los tramos continúan por el borde opuesto del tablero
+	Reachability(int horizontalCount, int verticalCount, bool wrap);
+	~Reachability();
+
+	//La memoria, en bytes, que necesita el núcleo para un tablero de columns x rows
+	static unsigned int ramNeeded(int columns, int rows);
+
+	//Marca como libres las celdas de la matriz sin serpiente ni muro (las vacías y la moneda)
+	void load(const InGameItemType* matrix);
+	void setFree(int index, bool free);
+	/*
+	 * Calcula las celdas libres alcanzables desde la celda from (que se considera
+	 * libre) y devuelve cuántas son, contando from. Si target no es -1, el relleno
+	 * se detiene en cuanto alcanza esa celda, y el resultado queda incompleto.
+	 */
+	int fill(int from, int target = -1);
+	//Consultan el resultado del último relleno
+	bool reached(int index);
+	bool reached(int x, int y);
+	bool isFree(int x, int y);
+
+	/*
+	 * Indica si, tras mover la cabeza de la serpiente a la celda next (que debe
+	 * estar libre), la serpiente aún puede alcanzar su cola y, por tanto, no se ha
+	 * encerrado a sí misma. Carga el tablero, así que no conserva el relleno anterior.
+	 */
+	bool safeMove(Board* board, Snake* snake, int next);
+
+	//El tiempo máximo, en microsegundos, que ha tardado un relleno
+	unsigned long maxFillTime = 0;
+private:
+	int horizontalCount;
+	int verticalCount;
+	bool wrap;
+	int rowWords;
+	ReachWord* freeBits;
+	ReachWord* reachBits;
+	//Tres filas de trabajo para el relleno horizontal
+	ReachWord* scratch;
+
+	inline ReachWord* row(ReachWord* bits, int y){
+		return bits + y * rowWords;
+	}
+	bool spreadRow(int y);
+	void fillRow(int y);
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación del control remoto por el puerto serial.
+ */
+
+#include "snake.hpp"
+
+#ifdef SERIAL_REMOTE
+
+bool SerialRemote::update(){
+	bool applied = false;
+	while (Serial.available() > 0){
+		byte value = Serial.read();
+
+		//Buscar la cabecera del siguiente paquete
+		if (received == 0 && value != REMOTE_INPUT_HEADER) continue;
+		packet[received++] = value;
+		if (received < REMOTE_INPUT_SIZE) continue;
+		received = 0;
+
+		if ((packet[0] ^ packet[1] ^ packet[2]) != packet[3]) continue;
+		byte controls = packet[1];
+		Direction dir1 = (Direction)(controls & 0x07);
+		Direction dir2 = (Direction)((controls >> 3) & 0x07);
+		if (dir1 > Down || dir2 > Down) continue;
+
+		ScriptedInput::direction(0) = dir1;
+#ifdef TWO_PLAYERS
+		ScriptedInput::direction(1) = dir2;
+#endif
+		ScriptedInput::start() = controls & REMOTE_START_BIT;
+		lastSequence = packet[2];
+		applied = true;
+	}
+	return applied;
+}
+
+/*
+ * Completa la suma del mensaje (su último byte) y lo envía, o lo descarta si no
+ * cabe en el buffer de salida.
+ */
+void SerialRemote::send(byte* message, byte size){
+	if (Serial.availableForWrite() < size){
+		dropped++;
+		return;
+	}
+	byte check = 0;
+	for (byte i = 0; i < size - 1; i++){
+		check ^= message[i];
+	}
+	message[size - 1] = check;
+	Serial.write(message, size);
+}
+
+void SerialRemote::gameStarted(Board* board, unsigned long seed, byte level){
+	byte message[REMOTE_GAME_SIZE];
+	message[0] = REMOTE_GAME_HEADER;
+	pack_long(message + 1, seed);
+	message[5] = board->horizontalCount;
+	message[6] = board->verticalCount;
+	message[7] = level | (board->wrap ? REMOTE_WRAP_BIT : 0);
+	message[8] = board->snakeCount;
+	send(message, REMOTE_GAME_SIZE);
+}
+
+void SerialRemote::ack(unsigned long step, uint32_t hash){
+	byte message[REMOTE_ACK_SIZE];
+	message[0] = REMOTE_ACK_HEADER;
+	message[1] = lastSequence;
+	pack_long(message + 2, step);
+	pack_long(message + 6, hash);
+	send(message, REMOTE_ACK_SIZE);
+}
+
+#endif
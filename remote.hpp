@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene el control remoto por el puerto serial (véase
+ * SERIAL_REMOTE en snake.hpp), que permite que un ordenador juegue en la placa
+ * para pruebas de larga duración y de latencia.
+ *
+ * Protocolo (los números de varios bytes van en big endian, como en la EEPROM):
+ *
+ * Ordenador -> placa, controles (REMOTE_INPUT_SIZE bytes):
+ *   0     REMOTE_INPUT_HEADER
+ *   1     bits 0-2: dirección del primer jugador (véase Direction)
+ *         bits 3-5: dirección del segundo jugador
+ *         bit 6: botón de start pulsado
+ *   2     número de secuencia, elegido por el ordenador
+ *   3     XOR de los bytes 0 a 2
+ *
+ *   Los controles se mantienen hasta el siguiente paquete. Los paquetes cuya
+ *   suma no coincide se descartan.
+ *
+ * Placa -> ordenador, al empezar cada partida (REMOTE_GAME_SIZE bytes):
+ *   0     REMOTE_GAME_HEADER
+ *   1-4   semilla de la partida
+ *   5-6   columnas y filas del tablero
+ *   7     nivel (el bit 7 indica el modo sin bordes)
+ *   8     número de serpientes
+ *   9     XOR de los bytes 0 a 8
+ *
+ *   Con estos datos, el ordenador puede simular la partida con las mismas reglas
+ *   (board.cpp), salvo en las partidas continuadas (véase snapshot.hpp).
+ *
+ * Placa -> ordenador, un acuse tras cada paso de la partida (REMOTE_ACK_SIZE bytes):
+ *   0     REMOTE_ACK_HEADER
+ *   1     número de secuencia del último paquete de controles recibido
+ *   2-5   número de paso del tablero (Board::steps)
+ *   6-9   hash del tablero tras el paso (Board::hash)
+ *   10    XOR de los bytes 0 a 9
+ *
+ * El número de secuencia permite al ordenador medir el tiempo de ida y vuelta,
+ * y el hash, comprobar que su simulación de la partida coincide con la placa.
+ * La lectura nunca espera a que lleguen bytes, y los acuses que no caben en el
+ * buffer de salida se descartan, para no detener el juego.
+ */
+
+#ifndef remote_hpp
+#define remote_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "board.hpp"
+
+#define REMOTE_INPUT_HEADER 0xA5
+#define REMOTE_INPUT_SIZE 4
+#define REMOTE_GAME_HEADER 0x5B
+#define REMOTE_GAME_SIZE 10
+#define REMOTE_ACK_HEADER 0x5A
+#define REMOTE_ACK_SIZE 11
+
+#define REMOTE_START_BIT 0x40
+#define REMOTE_WRAP_BIT 0x80
+
+class SerialRemote {
+public:
+	/*
+	 * Procesa los bytes recibidos hasta el momento y pasa los controles a
+	 * ScriptedInput (véase input.hpp). Devuelve true si ha llegado algún paquete.
+	 */
+	bool update();
+
+	//Anuncia el comienzo de una partida
+	void gameStarted(Board* board, unsigned long seed, byte level);
+	//Envía el acuse de un paso de la partida
+	void ack(unsigned long step, uint32_t hash);
+
+	//Mensajes descartados por tener el buffer de salida lleno
+	unsigned int dropped = 0;
+private:
+	void send(byte* message, byte size);
+
+	byte packet[REMOTE_INPUT_SIZE];
+	byte received = 0;
+	byte lastSequence = 0;
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de la grabación y reproducción de
+ * partidas.
+ */
+
+#include "replay.hpp"
+#include "storage.hpp"
+
+//Bits reservados para poder cerrar siempre la grabación: un hueco de 16 bits
+//en código gamma (31 bits) más el giro final (2 bits).
+#define REPLAY_END_BITS 33
+
+//ReplayRecorder
+void ReplayRecorder::load(unsigned int offset){
+	this->offset = offset;
+	bestSlot = eeprom_read_byte_safe(offset);
+	if (bestSlot > 1){
+		bestSlot = REPLAY_NO_SLOT;
+	}
+}
+
+void ReplayRecorder::begin(unsigned long seed){
+	//Grabar siempre en el hueco que no contiene la mejor partida
+	byte slot = bestSlot == 0 ? 1 : 0;
+	dataOffset = slotOffset(slot) + REPLAY_HEADER_SIZE;
+	bitCount = 0;
+	gap = 0;
+	acc = 0;
+	overflow = false;
+	recording = true;
+	pack_long(header, seed);
+}
+
+void ReplayRecorder::step(Turn turn){
+	if (!recording || overflow) return;
+
+	if (turn == Straight){
+		if (++gap == 0xFFFF){
+			overflow = true;
+		}
+		return;
+	}
+
+	if (!writeEvent(gap, turn, REPLAY_END_BITS)){
+		//No queda espacio: la partida no se podrá guardar
+		overflow = true;
+	}
+	gap = 0;
+}
+
+void ReplayRecorder::finish(bool best){
+	if (recording && !overflow){
+		writeEvent(gap, Straight, 0);
+		byte pending = bitCount % 8;
+		if (pending > 0){
+			acc <<= 8 - pending;
+			if (!eeprom_queue_write_byte(dataOffset + bitCount / 8, acc)){
+				overflow = true;
+			}
+		}
+	}
+	//La cabecera y el hueco de la mejor partida se encolan juntos
+	bool recorded = recording && !overflow && eeprom_queue_room() >= 2;
+	recording = false;
+	if (!best) return;
+	if (!recorded){
+		//La nueva mejor partida no tiene repetición (continuada, demasiado larga o
+		//sin sitio en la cola): la guardada ya no es la de la mejor puntuación
+		if (bestSlot != REPLAY_NO_SLOT){
+			clear();
+		}
+		return;
+	}
+
+	byte slot = bestSlot == 0 ? 1 : 0;
+	pack_int(header + 4, bitCount);
+	eeprom_queue_write(slotOffset(slot), header, REPLAY_HEADER_SIZE);
+	bestSlot = slot;
+	eeprom_queue_write_byte(offset, bestSlot);
+}
+
+void ReplayRecorder::clear(){
+	recording = false;
+	bestSlot = REPLAY_NO_SLOT;
+	eeprom_queue_write_byte(offset, bestSlot);
+}
+
+/*
+ * Escribe un evento (hueco + giro), siempre que queden libres, después de él,
+ * al menos reserved bits. Devuelve false si no hay espacio.
+ */
+bool ReplayRecorder::writeEvent(unsigned int gap, Turn turn, unsigned int reserved){
+	unsigned int n = gap + 1;
+	byte len = 0;
+	while ((n >> len) > 1) len++;
+
+	if (bitCount + 2 * len + 3 + reserved > REPLAY_MAX_BITS){
+		return false;
+	}
+
+	writeBits(0, len);
+	writeBits(n, len + 1);
+	writeBits(turn, 2);
+	return true;
+}
+
+void ReplayRecorder::writeBits(unsigned int value, byte count){
+	while (count-- > 0){
+		acc = (acc << 1) | ((value >> count) & 1);
+		if (++bitCount % 8 == 0){
+			//Sin sitio en la cola, la repetición queda incompleta
+			if (!eeprom_queue_write_byte(dataOffset + bitCount / 8 - 1, acc)){
+				overflow = true;
+			}
+			acc = 0;
+		}
+	}
+}
+
+//ReplayPlayer
+ReplayPlayer::ReplayPlayer(unsigned int offset){
+	seed = eeprom_read_long(offset);
+	bitCount = eeprom_read_int(offset + 4);
+	dataOffset = offset + REPLAY_HEADER_SIZE;
+	if (bitCount > REPLAY_MAX_BITS){
+		done = true;
+	}else{
+		readEvent();
+	}
+}
+
+Turn ReplayPlayer::step(){
+	if (done) return Straight;
+	if (gap > 0){
+		gap--;
+		return Straight;
+	}
+
+	Turn t = turn;
+	if (t == Straight){
+		//Fin de la partida
+		done = true;
+	}else{
+		readEvent();
+	}
+	return t;
+}
+
+bool ReplayPlayer::readBit(){
+	if (bitPos >= bitCount){
+		done = true;
+		return false;
+	}
+	byte b = eeprom_read_byte_safe(dataOffset + bitPos / 8);
+	bool bit = (b >> (7 - bitPos % 8)) & 1;
+	bitPos++;
+	return bit;
+}
+
+bool ReplayPlayer::readEvent(){
+	byte len = 0;
+	while (!readBit()){
+		if (done || ++len > 15){
+			done = true;
+			return false;
+		}
+	}
+
+	unsigned int n = 1;
+	for (byte i = 0; i < len; i++){
+		n = (n << 1) | readBit();
+	}
+	byte t = readBit() << 1;
+	t |= readBit();
+
+	if (done || t > TurnRight){
+		done = true;
+		return false;
+	}
+	gap = n - 1;
+	turn = (Turn)t;
+	return true;
+}
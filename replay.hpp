@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de las clases que graban y reproducen
+ * partidas. Una partida queda completamente determinada por su semilla y por la
+ * secuencia de giros de la serpiente, así que solo se guardan éstos:
+ *
+ * Cada giro se codifica como el número de pasos desde el giro anterior más uno,
+ * en código gamma de Elias (n - 1 ceros seguidos de los n bits del número), y
+ * el giro en sí, en 2 bits (véase el enum Turn). El final de la partida se marca
+ * con un giro Straight. Así, la mayoría de los giros ocupan menos de un byte.
+ *
+ * En la EEPROM hay dos huecos para repeticiones: uno contiene la de la mejor
+ * partida y el otro se utiliza para grabar la partida en curso, que se escribe
+ * en segundo plano a medida que se juega. Si la partida resulta ser la mejor,
+ * simplemente se intercambian los huecos.
+ */
+
+#ifndef replay_hpp
+#define replay_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+
+//El tamaño, en bytes, de cada uno de los dos huecos de repetición de la EEPROM
+#define REPLAY_SLOT_SIZE 256
+
+//Cabecera de cada hueco: semilla (4 bytes) y número de bits de datos (2 bytes)
+#define REPLAY_HEADER_SIZE 6
+#define REPLAY_MAX_BITS ((REPLAY_SLOT_SIZE - REPLAY_HEADER_SIZE) * 8)
+
+//El tamaño total en la EEPROM (índice del mejor hueco + 2 huecos)
+#define REPLAY_EEPROM_SIZE (1 + 2 * REPLAY_SLOT_SIZE)
+
+#define REPLAY_NO_SLOT 0xFF
+
+/*
+ * Graba la partida en curso en la EEPROM. La instancia pertenece a Game, pues
+ * la cabecera debe seguir existiendo mientras se escribe tras acabar la partida.
+ */
+class ReplayRecorder {
+public:
+	void load(unsigned int offset);
+
+	//Devuelve true si hay una repetición de la mejor partida guardada
+	inline bool available(){
+		return bestSlot != REPLAY_NO_SLOT;
+	}
+	//La posición en la EEPROM de la repetición de la mejor partida
+	inline unsigned int bestOffset(){
+		return slotOffset(bestSlot);
+	}
+
+	void begin(unsigned long seed);
+	//Registra un paso de la serpiente con el giro aplicado en él
+	void step(Turn turn);
+	/*
+	 * Cierra la grabación y, si best es true, la convierte en la mejor partida.
+	 * Si best es true pero la partida no se ha podido grabar, borra la repetición
+	 * anterior, que ya no corresponde a la mejor puntuación.
+	 */
+	void finish(bool best);
+	//Descarta la grabación en curso, si la hay
+	inline void cancel(){
+		recording = false;
+	}
+	//Borra la repetición de la mejor partida
+	void clear();
+private:
+	unsigned int offset;
+	byte bestSlot;
+
+	bool recording = false;
+	bool overflow;
+	unsigned int dataOffset;
+	unsigned int bitCount;
+	unsigned int gap;
+	byte acc;
+	byte header[REPLAY_HEADER_SIZE];
+
+	inline unsigned int slotOffset(byte slot){
+		return offset + 1 + slot * REPLAY_SLOT_SIZE;
+	}
+	bool writeEvent(unsigned int gap, Turn turn, unsigned int reserved);
+	void writeBits(unsigned int value, byte count);
+};
+
+/*
+ * Lee una repetición guardada en la EEPROM, paso a paso.
+ */
+class ReplayPlayer {
+public:
+	ReplayPlayer(unsigned int offset);
+	unsigned long seed;
+
+	//Devuelve el giro que se debe aplicar en el siguiente paso
+	Turn step();
+	//Devuelve true si la repetición ha terminado (o estaba dañada)
+	inline bool finished(){
+		return done;
+	}
+private:
+	unsigned int dataOffset;
+	unsigned int bitCount;
+	unsigned int bitPos = 0;
+	unsigned int gap = 0;
+	Turn turn = Straight;
+	bool done = false;
+
+	bool readBit();
+	bool readEvent();
+};
+
+#endif
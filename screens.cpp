@@ -29,54 +29,36 @@
 
 #include "screens.hpp"
 
-//ListItem
-ListItem::~ListItem(){
-	delete[] text;
-}
-ListItem::ListItem(Context* ctx, char* text, Rect rect, Point textPos, char left, char right, char up, char down, char textSize, bool stroke){
-	this->ctx = ctx;
-	this->text = text;
-	this->rect = rect;
-	this->left = left;
-	this->right = right;
-	this->up = up;
-	this->down = down;
-	this->textSize = textSize;
-	this->txtPos = textPos;
-	this->stroke = stroke;
-}
-ListItem* ListItem::createAt(Context* ctx, char* text,char textSize, Point point, char left, char right, char up, char down, bool stroke){
-	Size sz = ctx->getTextSize(text, textSize);
-
-	//textSize * 8 => (textSize * 4) * 2 -> aumentamos el tamaño del rectángulo para definir un margen con el rectángulo y el texto. Se multiplica por dos para tener en cuenta los ambos lados del rectángulo
-	// -2 -> Se le resta el tamaño del borde horizontal (no se aplica al vertical)
-	return ListItem::create(ctx, text, textSize,{point.x, point.y, sz.w + textSize * 8, sz.h + textSize * 8 - 2}, left, right, up, down, stroke);
-}
-ListItem* ListItem::create(Context* ctx, char* text, char textSize, Rect rect, char left, char right, char up, char down, bool stroke){
-	Size sz = ctx->getTextSize(text, textSize);
-	Point pos = CENTER(rect, sz);
-	pos.y += 1; //Tener en cuenta el borde (Solo uno de ellos claro)
-	return new ListItem(ctx, text, rect, pos, left, right, up, down, textSize, stroke);
-}
+//Número de bloques que se dibujan con cada cambio de color al pintar una serpiente entera
+#define SNAKE_RENDER_BATCH 8
 
-void ListItem::render(ListItemState state){
-	Color fore;
-	Color back;
-	Color stroke;
-	switch(state){
-	case Pressed: back = GREEN; stroke = GREEN; fore = BLACK; break;
-	case Selected: back = WHITE; stroke = WHITE; fore = BLACK; break;
-	case Unselected: back = BLACK; stroke = WHITE; fore = WHITE; break;
+/*
+ * El color de cada serpiente: verde para el primer jugador y naranja para el segundo.
+ */
+static Color snakeColor(byte snake){
+	if (snake == 0){
+		return GREEN;
 	}
+	return ORANGE;
+}
 
-	if (this->stroke){
-		this->ctx->fillRect(this->rect, stroke, back);
-	}else{
-		this->ctx->fillRect(this->rect, back);
-	}
+/*
+ * Elemento i de una lista vertical de count botones que ocupan todo el ancho de la
+ * pantalla desde la coordenada top hasta abajo. Arriba y abajo recorren la lista
+ * de forma circular.
+ */
+#define LIST_PREV(i, count) ((i) == 0 ? (count) - 1 : (i) - 1)
+#define LIST_NEXT(i, count) ((i) == (count) - 1 ? 0 : (i) + 1)
+#define LIST_ITEM(text, i, count, top) {text, \
+		{0, (top) + (TFT_HEIGHT - (top)) / (count) * (i), TFT_WIDTH, (TFT_HEIGHT - (top)) / (count)}, \
+		LIST_PREV(i, count), LIST_NEXT(i, count), LIST_PREV(i, count), LIST_NEXT(i, count)}
 
-	this->ctx->drawText(text, textSize, txtPos, fore);
-}
+//Altura del título de las pantallas con dos botones en la parte inferior (70%)
+#define DIALOG_TITLE_HEIGHT (TFT_HEIGHT * 7 / 10)
+
+//Rectángulos de los dos botones de 16 píxeles de alto de la parte inferior de la pantalla
+#define BOTTOM_LEFT_RECT {0, TFT_HEIGHT - 16, TFT_WIDTH / 2, 16}
+#define BOTTOM_RIGHT_RECT {TFT_WIDTH / 2, TFT_HEIGHT - 16, TFT_WIDTH / 2, 16}
 
 //Screen
 Screen::Screen(Context* ctx) {
@@ -91,57 +73,93 @@ Context* Screen::getContext() {
 }
 
 //ListScreen
-ListScreen::ListScreen(Context* ctx) : Screen(ctx) {}
-ListScreen::~ListScreen(){
-	deleteItems();
+ListScreen::ListScreen(Context* ctx, const MenuItem* menu, byte itemCount) : Screen(ctx) {
+	setMenu(menu, itemCount);
+}
+void ListScreen::setMenu(const MenuItem* menu, byte itemCount){
+	this->menu = menu;
+	this->itemCount = itemCount;
 }
 void ListScreen::moveListCursor(Direction dir, bool startButtonPressed){
+	if (itemCount == 0) return;
 
-	ListItem* item = items[chosenItem];
+	const MenuItem* item = &menu[chosenItem];
 	int newIndex;
 	switch(dir){
 	case Left:
-		newIndex = item->left;
+		newIndex = (char)pgm_read_byte(&item->left);
 		break;
 	case Right:
-		newIndex = item->right;
+		newIndex = (char)pgm_read_byte(&item->right);
 		break;
 	case Up:
-		newIndex = item->up;
+		newIndex = (char)pgm_read_byte(&item->up);
 		break;
 	case Down:
-		newIndex = item->down;
+		newIndex = (char)pgm_read_byte(&item->down);
 		break;
 	default: newIndex = -1; break;
 	}
 
+	if (newIndex != -1 && !itemEnabled(newIndex)){
+		newIndex = -1;
+	}
 	if (newIndex != -1){
-		item->render(Unselected);
-		items[newIndex]->render(startButtonPressed ? Pressed : Selected);
+		renderItem(chosenItem, Unselected);
+		renderItem(newIndex, startButtonPressed ? Pressed : Selected);
 		chosenItem = newIndex;
 		itemPressed = startButtonPressed;
 	}else if (startButtonPressed != itemPressed){
-		item->render(startButtonPressed ? Pressed : Selected);
+		renderItem(chosenItem, startButtonPressed ? Pressed : Selected);
 		itemPressed = startButtonPressed;
 	}
 }
 
-void ListScreen::buildItemMatrix(){
-	items = new ListItem*[itemCount];
+Rect ListScreen::itemRect(byte index){
+	Rect rect;
+	memcpy_P(&rect, &menu[index].rect, sizeof(Rect));
+	return rect;
 }
 
-void ListScreen::deleteItems(){
-	for (int i = 0; i < itemCount; i++){
-		delete items[i];
+void ListScreen::itemText(byte index, const MenuItem* item, char* buffer){
+	strcpy_P(buffer, item->text);
+}
+
+bool ListScreen::itemEnabled(byte index){
+	return true;
+}
+
+/*
+ * Dibuja un elemento del menú copiándolo de la flash a la pila; el texto
+ * también se copia a la pila, por lo que no se utiliza memoria del heap.
+ */
+void ListScreen::renderItem(byte index, ListItemState state){
+	MenuItem item;
+	memcpy_P(&item, &menu[index], sizeof(MenuItem));
+	char text[MENU_TEXT_LENGTH];
+	itemText(index, &item, text);
+
+	Color fore;
+	Color back;
+	switch(state){
+	case Pressed: back = GREEN; fore = BLACK; break;
+	case Selected: back = WHITE; fore = BLACK; break;
+	default: back = BLACK; fore = WHITE; break;
 	}
-	delete[] items;
+	if (!itemEnabled(index)){
+		fore = GREY;
+	}
+
+	ctx->fillRect(item.rect, back);
+	Point pos = CENTER(item.rect, ctx->getTextSize(text, 1));
+	pos.y += 1; //Tener en cuenta el borde (Solo uno de ellos claro)
+	ctx->drawText(text, 1, pos, fore, back);
 }
 
 void ListScreen::onInit(){
 	chosenItem = defaultItem;
 	for (int i = 0; i < itemCount; i++){
-		if (i == defaultItem) items[i]->render(Selected);
-		else items[i]->render(Unselected);
+		renderItem(i, i == defaultItem ? Selected : Unselected);
 	}
 }
 
@@ -155,6 +173,7 @@ void ListScreen::onEnd(){}
 SplashScreen::SplashScreen(Context* ctx) : Screen(ctx) {}
 void SplashScreen::onInit() {
 	initmillis = millis();
+	ctx->game->wakeAfter(500);
 	ctx->clear(BLACK);
 	char* text = lstr(STR_APPTITLE);
 	Size sz = ctx->getTextSize(text, 2);
@@ -165,91 +184,231 @@ void SplashScreen::onInit() {
 void SplashScreen::render() {
 	if (millis() - initmillis >= 500){
 		ctx->game->initScreen(new MainMenuScreen(ctx));
-	}else delay(500);
+	}
 }
 
 void SplashScreen::onEnd() {}
 
 
+//Tabla de puntuaciones
+static char* append_number(char* dst, unsigned long n){
+	ultoa(n, dst, 10);
+	return dst + strlen(dst);
+}
+
+/*
+ * Dibuja tantas filas de la tabla de puntuaciones como quepan en el rectángulo
+ * especificado, resaltando la fila highlight. No utiliza memoria del heap.
+ */
+static void renderHighScores(Context* ctx, Rect area, byte highlight){
+	HighScoreTable* table = &ctx->game->highScores;
+	const int rowHeight = 9;
+	int rows = area.h / rowHeight;
+	if (rows > table->count()) rows = table->count();
+
+	if (table->count() == 0){
+		char empty[sizeof(STR_HIGHSCORES_EMPTY)];
+		strcpy_P(empty, STR_HIGHSCORES_EMPTY);
+		Size sz = ctx->getTextSize(empty, 1);
+		ctx->drawText(empty, 1, CENTER(area, sz), GREY);
+		return;
+	}
+
+	//Como mucho: "10. 4294967295" y "L65535 1092:15"
+	char left[16];
+	char right[16];
+	HighScore entry;
+	byte pos = 0;
+	for (int i = 0; i < rows; i++){
+		pos = table->read(pos, &entry);
+
+		char* c = append_number(left, i + 1);
+		*c++ = '.';
+		*c++ = ' ';
+		append_number(c, entry.score);
+
+		c = right;
+		*c++ = 'L';
+		c = append_number(c, entry.length);
+		*c++ = ' ';
+		c = append_number(c, entry.duration / 60);
+		*c++ = ':';
+		*c++ = '0' + (entry.duration % 60) / 10;
+		*c++ = '0' + entry.duration % 10;
+		*c = 0;
+
+		Color fore = WHITE;
+		Color details = LIGHT_GRAY;
+		if (i == highlight){
+			fore = GREEN;
+			details = GREEN;
+		}
+		int y = area.y + i * rowHeight;
+		ctx->drawText(left, 1, {area.x, y}, fore);
+		ctx->drawText(right, 1, {area.x + area.w - ctx->getTextSize(right, 1).w, y}, details);
+	}
+}
+
 //MainMenu
-MainMenuScreen::MainMenuScreen(Context* ctx) : ListScreen(ctx) {}
-void MainMenuScreen::onInit() {
-	//Como el número de botones disminuye si el joystick está deshabilitado,
-	//cambiamos el tamaño del título en función de ello.
+//Los botones del menú, algunos de los cuales dependen de la configuración
+enum MainMenuAction : byte {
+	MenuPlay,
+	MenuContinue,
+	MenuReplay,
+#ifdef TWO_PLAYERS
+	MenuVersus,
+#endif
+#ifdef BOARD_SETTINGS
+	MenuBoard,
+#endif
+#ifdef EXTERN_JOYSTICK
+	MenuCalibrate,
+#endif
+	MenuResetScore,
+	MenuStats,
+	MenuReboot,
+	MainMenuCount
+};
+
+/*
+ * Cada fila ocupa un 10% de la pantalla; el título, el resto. Jugar y continuar
+ * comparten la primera fila, y estadísticas y reiniciar la última, por lo que
+ * la fila r contiene el botón r + 1.
+ */
+#define MAIN_MENU_ROWS (MainMenuCount - 2)
+#define MAIN_MENU_TITLE_HEIGHT (TFT_HEIGHT * (10 - MAIN_MENU_ROWS) / 10)
+#define MAIN_MENU_ROW_HEIGHT ((TFT_HEIGHT - MAIN_MENU_TITLE_HEIGHT) / MAIN_MENU_ROWS)
+#define MAIN_MENU_ROW(i) ((i) == MenuPlay ? 0 : (i) == MenuReboot ? (i) - 2 : (i) - 1)
+#define MAIN_MENU_Y(i) (MAIN_MENU_TITLE_HEIGHT + MAIN_MENU_ROW_HEIGHT * MAIN_MENU_ROW(i))
+#define MAIN_MENU_AT(r) ((r) == 0 ? MenuPlay : (r) + 1)
+#define MAIN_MENU_UP(i) MAIN_MENU_AT(LIST_PREV(MAIN_MENU_ROW(i), MAIN_MENU_ROWS))
+#define MAIN_MENU_DOWN(i) MAIN_MENU_AT(LIST_NEXT(MAIN_MENU_ROW(i), MAIN_MENU_ROWS))
+#define MAIN_MENU_ITEM(text, i) {text, \
+		{0, MAIN_MENU_Y(i), TFT_WIDTH, MAIN_MENU_ROW_HEIGHT}, \
+		MAIN_MENU_UP(i), MAIN_MENU_DOWN(i), MAIN_MENU_UP(i), MAIN_MENU_DOWN(i)}
+//Un botón de media fila; other es el de la otra mitad
+#define MAIN_MENU_HALF(text, i, x, other) {text, \
+		{x, MAIN_MENU_Y(i), TFT_WIDTH / 2, MAIN_MENU_ROW_HEIGHT}, \
+		other, other, MAIN_MENU_UP(i), MAIN_MENU_DOWN(i)}
+
+static const MenuItem mainMenu[] PROGMEM = {
+	MAIN_MENU_HALF(STR_MENU_PLAY, MenuPlay, 0, MenuContinue),
+	MAIN_MENU_HALF(STR_MENU_CONTINUE, MenuContinue, TFT_WIDTH / 2, MenuPlay),
+	MAIN_MENU_ITEM(STR_MENU_REPLAY, MenuReplay),
+#ifdef TWO_PLAYERS
+	MAIN_MENU_ITEM(STR_MENU_VERSUS, MenuVersus),
+#endif
+#ifdef BOARD_SETTINGS
+	MAIN_MENU_ITEM(STR_MENU_BOARD, MenuBoard),
+#endif
 #ifdef EXTERN_JOYSTICK
-	Rect titleRect = {0,0,ctx->width, (int)(ctx->height * 0.5)};
+	MAIN_MENU_ITEM(STR_MENU_CALIBRATE, MenuCalibrate),
+#endif
+	MAIN_MENU_ITEM(STR_MENU_RESET_SCORE, MenuResetScore),
+	MAIN_MENU_HALF(STR_MENU_STATS, MenuStats, 0, MenuReboot),
+	MAIN_MENU_HALF(STR_MENU_REBOOT, MenuReboot, TFT_WIDTH / 2, MenuStats),
+};
+
+MainMenuScreen::MainMenuScreen(Context* ctx) : ListScreen(ctx, mainMenu, MainMenuCount) {}
+
+//Solo se puede continuar la partida guardada si es del tablero configurado
+bool MainMenuScreen::itemEnabled(byte index){
+	if (index != MenuContinue) return true;
+#ifdef BOARD_SETTINGS
+	BoardSettings* settings = &ctx->game->settings;
+	return ctx->game->snapshot.available(settings->columns, settings->rows, settings->level, settings->wrap);
 #else
-	Rect titleRect = {0,0,ctx->width, (int)(ctx->height * 0.6)};
+	return ctx->game->snapshot.available(GameGeometry::horizontalCount, GameGeometry::verticalCount, 0, false);
 #endif
+}
+
+void MainMenuScreen::onInit() {
+	Rect titleRect = {0,0,ctx->width, MAIN_MENU_TITLE_HEIGHT};
 
 	char* title = lstr(STR_APPTITLE);
-	Point txtPoint = CENTER(titleRect, ctx->getTextSize(title, 2));
+	Size titleSize = ctx->getTextSize(title, 2);
+	Point txtPoint = {(ctx->width - titleSize.w) / 2, 4};
 	ctx->fillRect(titleRect, BLACK);
 	ctx->drawText(title, 2, txtPoint, WHITE);
 	ctx->fillRect({0,titleRect.h, ctx->width, ctx->height - titleRect.h}, BLACK);
 	delete[] title;
 
-	char* maxScorePrefix = lstr(STR_MENU_MAX_SCORE_PREFIX);
-	int prefixLen = strlen(maxScorePrefix);
-
-	char* scoreText = new char[prefixLen + ctx->getNumberLength(ctx->game->maxScore) + 1]();
-	memcpy(scoreText, maxScorePrefix, prefixLen);
-	ultoa(ctx->game->maxScore, scoreText + prefixLen, 10);
-	Size scoreSize = ctx->getTextSize(scoreText, 1);
-	ctx->drawText(scoreText, 1, {(ctx->width - scoreSize.w) / 2, txtPoint.y + 21}, AQUA);
-	delete[] scoreText;
-	delete[] maxScorePrefix;
-
-#ifdef EXTERN_JOYSTICK
-	itemCount = 4;
-#else
-	itemCount = 3;
-#endif
-
-	buildItemMatrix();
-	int buttonHeight = (ctx->height - titleRect.h) / itemCount;
-	int buttonY = titleRect.h;
+	int tableY = txtPoint.y + titleSize.h;
+	renderHighScores(ctx, {4, tableY, ctx->width - 8, titleRect.h - tableY}, HIGHSCORE_COUNT);
 
-#ifdef EXTERN_JOYSTICK
-	items[0] = ListItem::create(ctx, lstr(STR_MENU_PLAY), 1, {0, buttonY, ctx->width, buttonHeight}, 3, 1, 3, 1, false);
-	items[1] = ListItem::create(ctx, lstr(STR_MENU_CALIBRATE), 1, {0, buttonY + buttonHeight, ctx->width, buttonHeight}, 0, 2, 0, 2, false);
-	items[2] = ListItem::create(ctx, lstr(STR_MENU_RESET_SCORE), 1, {0, buttonY + buttonHeight * 2, ctx->width, buttonHeight}, 1, 3, 1, 3, false);
-	items[3] = ListItem::create(ctx, lstr(STR_MENU_REBOOT), 1, {0, buttonY + buttonHeight * 3, ctx->width, buttonHeight}, 2, 0, 2, 0, false);
-#else
-	items[0] = ListItem::create(ctx, lstr(STR_MENU_PLAY), 1, {0, buttonY, ctx->width, buttonHeight}, 2, 1, 2, 1, false);
-	items[1] = ListItem::create(ctx, lstr(STR_MENU_RESET_SCORE), 1, {0, buttonY + buttonHeight, ctx->width, buttonHeight}, 0, 2, 0, 2, false);
-	items[2] = ListItem::create(ctx, lstr(STR_MENU_REBOOT), 1, {0, buttonY + buttonHeight * 2, ctx->width, buttonHeight}, 1, 0, 1, 0, false);
-#endif
+	if (itemEnabled(MenuContinue)){
+		defaultItem = MenuContinue;
+	}
 	this->ListScreen::onInit();
+	lastActivity = millis();
+#ifdef ATTRACT_MODE_DELAY
+	ctx->game->wakeAt(lastActivity + ATTRACT_MODE_DELAY + 1);
+#endif
 }
 
 void MainMenuScreen::render() {
 	this->ListScreen::render();
+#ifdef ATTRACT_MODE_DELAY
+	Input* input = ctx->game->input;
+	if (input->currentStart || input->currentDir != None){
+		lastActivity = millis();
+	}else if (millis() - lastActivity > ATTRACT_MODE_DELAY){
+		ctx->game->initScreen(new GameScreen(ctx, Demo));
+		return;
+	}
+	ctx->game->wakeAt(lastActivity + ATTRACT_MODE_DELAY + 1);
+#endif
 	if (ctx->game->input->start){
-		delay(100);
-
 		switch(chosenItem){
-		case 0: //Botón de inicio
+		case MenuPlay: //Botón de inicio
 			ctx->game->initScreen(new GameScreen(ctx));
 			break;
-		case 1:
-#ifdef EXTERN_JOYSTICK
-			//Si el joystick está habilitado, este botón sirve para calibrarlo
-			ctx->game->initScreen(new CalibrationScreen(ctx));
+		case MenuContinue: //Continuar la partida guardada al pausar
+			ctx->game->initScreen(new GameScreen(ctx, Playing, true));
+			break;
+		case MenuReplay: //Ver la repetición de la mejor partida, si existe
+			if (ctx->game->replay.available()){
+				ctx->game->initScreen(new GameScreen(ctx, Replaying));
+			}
+			break;
+#ifdef TWO_PLAYERS
+		case MenuVersus: //Partida de dos jugadores, si caben las dos serpientes
+			{
+#ifdef BOARD_SETTINGS
+				unsigned int cells = ctx->game->settings.columns * ctx->game->settings.rows;
 #else
-			//Si no, este botón resetea la puntuasión máxima
-			ctx->game->initScreen(new DeleteMaxScoreConfirmScreen(ctx));
+				unsigned int cells = GameGeometry::totalCount;
 #endif
+				int available = free_ram() - BOARD_RAM_RESERVE;
+				if (available > 0 && Board::ramNeeded(cells, 2) <= (unsigned int)available){
+					ctx->game->initScreen(new GameScreen(ctx, TwoPlayers));
+				}else{
+					Rect area = itemRect(chosenItem);
+					char text[sizeof(STR_BOARD_NO_FIT)];
+					strcpy_P(text, STR_BOARD_NO_FIT);
+					ctx->fillRect(area, BLACK);
+					ctx->drawText(text, 1, CENTER(area, ctx->getTextSize(text, 1)), RED);
+				}
+			}
+			break;
+#endif
+#ifdef BOARD_SETTINGS
+		case MenuBoard: //Cambiar el tamaño del tablero
+			ctx->game->initScreen(new BoardSettingsScreen(ctx));
 			break;
-		case 2:
+#endif
 #ifdef EXTERN_JOYSTICK
-			//Si el joystick está habilitado, este botón resetea la puntuasión máxima
-			ctx->game->initScreen(new DeleteMaxScoreConfirmScreen(ctx));
+		case MenuCalibrate: //Calibrar el joystick
+			ctx->game->initScreen(new CalibrationScreen(ctx));
 			break;
-#else
-			//Si no, se reincia la placa. (no se pone ningún break y ale)
 #endif
-		case 3: //Reiniciar placa
+		case MenuResetScore: //Resetear la puntuación máxima
+			ctx->game->initScreen(new DeleteMaxScoreConfirmScreen(ctx));
+			break;
+		case MenuStats: //Ver las estadísticas de juego
+			ctx->game->initScreen(new StatsScreen(ctx));
+			break;
+		case MenuReboot: //Reiniciar placa
 			ctx->clear({0, 0, 0});
 			char* title = lstr(STR_REBOOT_TITLE);
 			char* subtext = lstr(STR_REBOOT_SUBTITLE);
@@ -266,21 +425,29 @@ void MainMenuScreen::render() {
 			delete[] title;
 			delete[] subtext;
 
+			//No reiniciar hasta que los datos pendientes estén en la EEPROM
+			eeprom_queue_flush();
 			ctx->game->reset();
 			break;
 		}
-	}else{
-		delay(50);
 	}
 }
 void MainMenuScreen::onEnd() {}
 
 //CalibrationScreen
 #ifdef EXTERN_JOYSTICK
-CalibrationScreen::CalibrationScreen(Context* ctx) : ListScreen(ctx) {}
+//El botón de la parte inferior, antes y después de calibrar
+#define CALIBRATION_BUTTON_RECT {0, TFT_HEIGHT - 20, TFT_WIDTH, 20}
+static const MenuItem calibrationMenu[] PROGMEM = {
+	{STR_CALIBRATE_NOW, CALIBRATION_BUTTON_RECT, -1, -1, -1, -1}
+};
+static const MenuItem calibrationDoneMenu[] PROGMEM = {
+	{STR_CALIBRATE_RETURN, CALIBRATION_BUTTON_RECT, -1, -1, -1, -1}
+};
+
+CalibrationScreen::CalibrationScreen(Context* ctx) : ListScreen(ctx, calibrationMenu, 1) {}
 void CalibrationScreen::onInit() {
 	ctx->clear({0, 0, 0});
-	Rect buttonRect = {0, ctx->height - 20, ctx->width, 20};
 
 	int minCoord = ctx->width > (ctx->height - 20) ? (ctx->height - 20) : ctx->width; // -20, el botón
 	Rect screenRect = {0,0,ctx->width, ctx->height};
@@ -303,10 +470,8 @@ void CalibrationScreen::onInit() {
 	center.y = previewPos.y + xMargin;
 	maxValue = xMargin;
 
-	itemCount = 1;
-	buildItemMatrix();
-	items[0] = ListItem::create(ctx, lstr(STR_CALIBRATE_NOW), 1, buttonRect, -1,-1,-1,-1, false);
 	this->ListScreen::onInit();
+	ctx->game->wakeAfter(0);
 }
 
 void CalibrationScreen::render() {
@@ -336,25 +501,203 @@ void CalibrationScreen::render() {
 	if (cInput->start){ //Calibrar
 		if (calibrated){
 			ctx->game->initScreen(new MainMenuScreen(ctx));
+			return;
 		}else{
 			ctx->game->calibrate(cInput->rawX, cInput->rawY);
 			calibrated = true;
 
 			//Cambiar botonsito
-			ListItem* newBtn = ListItem::create(ctx, lstr(STR_CALIBRATE_RETURN), 1, items[0]->rect, -1, -1, -1, -1, false);
-			delete items[0];
-			items[0] = newBtn;
-			items[0]->render(Selected);
+			setMenu(calibrationDoneMenu, 1);
+			renderItem(0, Selected);
 		}
 	}
 
-	delay(25);
+	//El punto sigue al joystick aunque su dirección no cambie
+	ctx->game->wakeAfter(25);
 }
 void CalibrationScreen::onEnd() {}
 #endif
 
+//BoardSettingsScreen
+#ifdef BOARD_SETTINGS
+#define BOARD_SETTINGS_ROW_HEIGHT 14
+#define BOARD_SETTINGS_ROWS_Y 24
+//Número de filas con valores (bloque, columnas, filas, nivel y sin bordes)
+#define BOARD_SETTINGS_VALUES 5
+
+#define BOARD_SETTINGS_SAVE BOARD_SETTINGS_VALUES
+#define BOARD_SETTINGS_BACK (BOARD_SETTINGS_VALUES + 1)
+#define BOARD_SETTINGS_ITEM(text, row) {text, \
+		{0, BOARD_SETTINGS_ROWS_Y + (row) * BOARD_SETTINGS_ROW_HEIGHT, TFT_WIDTH, BOARD_SETTINGS_ROW_HEIGHT}, \
+		-1, -1, (row) == 0 ? BOARD_SETTINGS_VALUES : (row) - 1, (row) + 1}
+
+//Las filas con los valores (se cambian con izquierda y derecha) y dos botones
+static const MenuItem boardSettingsMenu[] PROGMEM = {
+	BOARD_SETTINGS_ITEM(STR_BOARD_BLOCK, 0),
+	BOARD_SETTINGS_ITEM(STR_BOARD_COLUMNS, 1),
+	BOARD_SETTINGS_ITEM(STR_BOARD_ROWS, 2),
+	BOARD_SETTINGS_ITEM(STR_BOARD_LEVEL, 3),
+	BOARD_SETTINGS_ITEM(STR_BOARD_WRAP, 4),
+	{STR_BOARD_SAVE, BOTTOM_LEFT_RECT, BOARD_SETTINGS_BACK, BOARD_SETTINGS_BACK, BOARD_SETTINGS_VALUES - 1, 0},
+	{STR_BOARD_BACK, BOTTOM_RIGHT_RECT, BOARD_SETTINGS_SAVE, BOARD_SETTINGS_SAVE, BOARD_SETTINGS_VALUES - 1, 0},
+};
+
+BoardSettingsScreen::BoardSettingsScreen(Context* ctx) : ListScreen(ctx, boardSettingsMenu, BOARD_SETTINGS_VALUES + 2) {
+	settings = ctx->game->settings;
+}
+void BoardSettingsScreen::onInit(){
+	ctx->clear(BLACK);
+	char* title = lstr(STR_BOARD_TITLE);
+	ctx->drawText(title, 2, {5, 5}, ORANGE);
+	delete[] title;
+
+	this->ListScreen::onInit();
+	renderRam();
+}
+
+void BoardSettingsScreen::itemText(byte index, const MenuItem* item, char* buffer){
+	if (index >= BOARD_SETTINGS_VALUES){
+		ListScreen::itemText(index, item, buffer);
+		return;
+	}
+
+	int value;
+	switch(index){
+	case 0: value = settings.blockSize; break;
+	case 1: value = settings.columns; break;
+	case 2: value = settings.rows; break;
+	case 3: value = settings.level; break;
+	default: value = settings.wrap; break;
+	}
+
+	//"< Etiqueta: valor >"
+	char* c = buffer;
+	*c++ = '<';
+	*c++ = ' ';
+	strcpy_P(c, item->text);
+	c += strlen(c);
+	if (index == 4){
+		strcpy_P(c, value ? STR_YES : STR_NO);
+		c += strlen(c);
+	}else{
+		c = append_number(c, value);
+	}
+	*c++ = ' ';
+	*c++ = '>';
+	*c = 0;
+}
+
+void BoardSettingsScreen::changeValue(byte row, int delta){
+	switch(row){
+	case 0: {
+		int blockSize = settings.blockSize + delta * BOARD_BLOCK_SIZE_STEP;
+		if (blockSize < BOARD_MIN_BLOCK_SIZE || blockSize > BOARD_MAX_BLOCK_SIZE) return;
+		byte previous = settings.blockSize;
+		settings.setBlockSize(blockSize);
+		if (settings.maxColumns() < BOARD_MIN_COLUMNS || settings.maxRows() < BOARD_MIN_ROWS){
+			settings.setBlockSize(previous);
+			return;
+		}
+		break;
+	}
+	case 1: {
+		int columns = settings.columns + delta;
+		if (columns < BOARD_MIN_COLUMNS || columns > settings.maxColumns()) return;
+		settings.columns = columns;
+		break;
+	}
+	case 2: {
+		int rows = settings.rows + delta;
+		if (rows < BOARD_MIN_ROWS || rows > settings.maxRows()) return;
+		settings.rows = rows;
+		break;
+	}
+	case 3: {
+		int level = settings.level + delta;
+		if (level < 0 || level > LEVEL_COUNT) return;
+		settings.level = level;
+		break;
+	}
+	default:
+		settings.wrap = !settings.wrap;
+		break;
+	}
+
+	//Al cambiar el tamaño de bloque el tablero vuelve a ocupar toda la pantalla,
+	//por lo que también cambian las columnas y las filas
+	byte last = row == 0 ? 2 : row;
+	for (byte i = row; i <= last; i++){
+		renderItem(i, i == row ? Selected : Unselected);
+	}
+	renderRam();
+}
+
+Rect BoardSettingsScreen::ramRect(){
+	return {0, BOARD_SETTINGS_ROWS_Y + BOARD_SETTINGS_VALUES * BOARD_SETTINGS_ROW_HEIGHT + 3, ctx->width, 10};
+}
+
+bool BoardSettingsScreen::fits(){
+	int available = free_ram() - BOARD_RAM_RESERVE;
+	return available > 0 && settings.ramNeeded() <= (unsigned int)available;
+}
+
+void BoardSettingsScreen::renderRam(){
+	Rect area = ramRect();
+	ctx->fillRect(area, BLACK);
+
+	//"RAM: necesaria/disponible"
+	int available = free_ram() - BOARD_RAM_RESERVE;
+	char text[sizeof(STR_BOARD_RAM) + 12];
+	strcpy_P(text, STR_BOARD_RAM);
+	char* c = append_number(text + strlen(text), settings.ramNeeded());
+	*c++ = '/';
+	append_number(c, available > 0 ? available : 0);
+	if (fits()){
+		ctx->drawText(text, 1, {5, area.y}, GREEN);
+	}else{
+		ctx->drawText(text, 1, {5, area.y}, RED);
+	}
+}
+
+void BoardSettingsScreen::render(){
+	this->ListScreen::render();
+	Input* input = ctx->game->input;
+	if (chosenItem < BOARD_SETTINGS_VALUES && (input->dir == Left || input->dir == Right)){
+		changeValue(chosenItem, input->dir == Right ? 1 : -1);
+	}
+
+	if (input->start && chosenItem >= BOARD_SETTINGS_VALUES){
+		if (chosenItem == BOARD_SETTINGS_VALUES){
+			if (!fits()){
+				Rect area = ramRect();
+				ctx->fillRect(area, BLACK);
+				char text[sizeof(STR_BOARD_NO_FIT)];
+				strcpy_P(text, STR_BOARD_NO_FIT);
+				ctx->drawText(text, 1, {5, area.y}, RED);
+				return;
+			}
+
+			BoardSettings* current = &ctx->game->settings;
+			if (!current->sameBoard(&settings)){
+				*current = settings;
+				current->save();
+				//La repetición de la mejor partida solo es válida para el tablero y el nivel en el que se jugó
+				ctx->game->replay.clear();
+			}
+		}
+		ctx->game->initScreen(new MainMenuScreen(ctx));
+	}
+}
+void BoardSettingsScreen::onEnd(){}
+#endif
+
 //DeleteMaxScoreConfirmScreen
-DeleteMaxScoreConfirmScreen::DeleteMaxScoreConfirmScreen(Context* ctx) : ListScreen(ctx) {}
+static const MenuItem deleteMaxScoreMenu[] PROGMEM = {
+	{STR_YES, BOTTOM_LEFT_RECT, 1, 1, 1, 1},
+	{STR_NO, BOTTOM_RIGHT_RECT, 0, 0, 0, 0},
+};
+
+DeleteMaxScoreConfirmScreen::DeleteMaxScoreConfirmScreen(Context* ctx) : ListScreen(ctx, deleteMaxScoreMenu, 2) {}
 void DeleteMaxScoreConfirmScreen::onInit(){
 	ctx->clear(BLACK);
 	char* title = lstr(STR_RESET_TITLE);
@@ -376,11 +719,7 @@ void DeleteMaxScoreConfirmScreen::onInit(){
 	}
 	delete[] lines;
 
-	itemCount = 2;
 	defaultItem = 1;
-	buildItemMatrix();
-	items[0] = ListItem::create(ctx, lstr(STR_YES), 1, {0, ctx->height - 16, ctx->width / 2, 16}, 1, 1, 1, 1, false);
-	items[1] = ListItem::create(ctx, lstr(STR_NO), 1, {ctx->width / 2, ctx->height - 16, ctx->width / 2, 16}, 0, 0, 0, 0, false);
 	this->ListScreen::onInit();
 
 }
@@ -399,55 +738,209 @@ void DeleteMaxScoreConfirmScreen::render(){
 		}
 		ctx->game->initScreen(new MainMenuScreen(ctx));
 	}
-	delay(50);
 }
 void DeleteMaxScoreConfirmScreen::onEnd(){}
 
+//StatsScreen
+static const MenuItem statsMenu[] PROGMEM = {
+	{STR_STATS_BACK, {0, TFT_HEIGHT - 16, TFT_WIDTH, 16}, -1, -1, -1, -1},
+};
+
+static const char* const statsLabels[StatsHistogramCount] PROGMEM = {
+	STR_STATS_HIST_STEPS, STR_STATS_HIST_GAP, STR_STATS_HIST_RATE, STR_STATS_HIST_SPEED
+};
+
+//Alto de los gráficos de barras, sin contar su etiqueta
+#define STATS_CHART_HEIGHT 22
+
+static char* append_P(char* dst, const char* src){
+	strcpy_P(dst, src);
+	return dst + strlen(dst);
+}
+
+//Escribe n décimas como "entero.décima"
+static char* append_tenths(char* dst, unsigned long n){
+	dst = append_number(dst, n / 10);
+	*dst++ = '.';
+	*dst++ = '0' + n % 10;
+	*dst = 0;
+	return dst;
+}
+
+StatsScreen::StatsScreen(Context* ctx) : ListScreen(ctx, statsMenu, 1) {}
+
+void StatsScreen::onInit(){
+	GameStats* stats = &ctx->game->stats;
+	ctx->clear(BLACK);
+
+	char line[MENU_TEXT_LENGTH + 8];
+	append_P(line, STR_MENU_STATS);
+	Point pt = {5, 5};
+	ctx->drawText(line, 2, pt, AQUA);
+	pt.y += 22;
+
+	//Promedios, calculados en décimas con enteros
+	unsigned long games = stats->counter(StatsGames);
+	unsigned long sessions = stats->counter(StatsSessions);
+	unsigned long seconds = stats->total(StatsTotalSeconds);
+	char* c = append_P(line, STR_STATS_GAMES);
+	c = append_number(c, games);
+	if (sessions > 0){
+		*c++ = ' ';
+		*c++ = '(';
+		c = append_tenths(c, games * 10 / sessions);
+		c = append_P(c, STR_STATS_PER_SESSION);
+		*c++ = ')';
+		*c = 0;
+	}
+	ctx->drawText(line, 1, pt, WHITE);
+	pt.y += 9;
+
+	c = append_P(line, STR_STATS_STEPS);
+	append_number(c, games > 0 ? stats->total(StatsTotalSteps) / games : 0);
+	ctx->drawText(line, 1, pt, WHITE);
+	pt.y += 9;
+
+	c = append_P(line, STR_STATS_COIN_RATE);
+	append_tenths(c, seconds > 0 ? stats->total(StatsTotalCoins) * 600 / seconds : 0);
+	ctx->drawText(line, 1, pt, WHITE);
+	pt.y += 9;
+
+	c = append_P(line, STR_STATS_WALL);
+	c = append_number(c, stats->counter(StatsWallDeaths));
+	c = append_P(c, STR_STATS_SELF);
+	append_number(c, stats->counter(StatsSelfDeaths));
+	ctx->drawText(line, 1, pt, WHITE);
+	pt.y += 9;
+
+	c = append_P(line, STR_STATS_WINS);
+	c = append_number(c, stats->counter(StatsWins));
+	c = append_P(c, STR_STATS_QUITS);
+	append_number(c, stats->counter(StatsQuits));
+	ctx->drawText(line, 1, pt, WHITE);
+	pt.y += 12;
+
+	//Un gráfico por histograma, repartidos a lo ancho de la pantalla
+	int width = ctx->width / StatsHistogramCount;
+	for (byte h = 0; h < StatsHistogramCount; h++){
+		renderHistogram(stats->histogram((StatsHistogram)h), (const char*)pgm_read_ptr(&statsLabels[h]), {h * width, pt.y, width, STATS_CHART_HEIGHT + 10});
+	}
+
+	this->ListScreen::onInit();
+}
+
+/*
+ * Dibuja la etiqueta y, debajo, una barra por cubo, con la altura relativa al
+ * cubo mayor (los cubos ya guardan frecuencias relativas).
+ */
+void StatsScreen::renderHistogram(const byte* buckets, const char* label, Rect area){
+	char text[8];
+	strcpy_P(text, label);
+	ctx->drawText(text, 1, {area.x + (area.w - ctx->getTextSize(text, 1).w) / 2, area.y}, LIGHT_GRAY);
+
+	byte highest = 0;
+	for (byte b = 0; b < GAME_STATS_BUCKETS; b++){
+		if (buckets[b] > highest) highest = buckets[b];
+	}
+	int barWidth = area.w / GAME_STATS_BUCKETS;
+	int bottom = area.y + area.h - 1;
+	ctx->fillRect({area.x + 1, bottom, barWidth * GAME_STATS_BUCKETS - 2, 1}, GREY);
+	if (highest == 0) return;
+	for (byte b = 0; b < GAME_STATS_BUCKETS; b++){
+		int h = (buckets[b] * STATS_CHART_HEIGHT + highest - 1) / highest;
+		if (h > 0){
+			ctx->fillRect({area.x + b * barWidth + 1, bottom - h, barWidth - 1, h}, GREEN);
+		}
+	}
+}
+
+void StatsScreen::render(){
+	this->ListScreen::render();
+	if (ctx->game->input->start){
+		ctx->game->initScreen(new MainMenuScreen(ctx));
+	}
+}
+void StatsScreen::onEnd(){}
+
 //GameScreen
-GameScreen::GameScreen(Context* ctx) : Screen(ctx) {}
+GameScreen::GameScreen(Context* ctx, GameMode mode, bool restore) : Screen(ctx) {
+	this->mode = mode;
+	this->restore = restore;
+}
 GameScreen::~GameScreen(){
-	delete[] itemMatrix;
-	delete snakeBlocks;
+	delete board;
+	if (player != null)
+		delete player;
+	if (pilot != null)
+		delete pilot;
 	if (pauseScreen != null)
 		delete pauseScreen;
+#ifdef ASSIST_MODE
+	delete assist;
+	delete[] assistTint;
+#endif
 }
 
 void GameScreen::onInit() {
-	//Calcular el rectángulo de juego, dejando 12 píxeles en la parte superior
-	//para mostrar la puntuación y logrando que el tamaño de éste sea
-	//divisible entre el tamaño del bloque de la serpiente
-	gameRect = {0, 12, ctx->width, ctx->height - 12};
-
-	//coord -2 => tener en cuenta los bordes del rectángulo!
-	while ((gameRect.h - 2) % blockSize > 0){
-		gameRect.y++;
-		gameRect.h--;
+	//Cada partida tiene su propia semilla, que se guarda en la tabla de puntuaciones
+	//y que, junto con los giros de la serpiente, permite reproducirla.
+	byte snakeCount = mode == TwoPlayers ? 2 : 1;
+	if (mode == Replaying){
+		player = new ReplayPlayer(ctx->game->replay.bestOffset());
+		seed = player->seed;
+	}else{
+		seed = random(1, 0x7FFFFFFF);
 	}
 
-	while ((gameRect.w - 2) % blockSize > 0){
-		gameRect.w--;
+#ifdef BOARD_SETTINGS
+	ctx->game->settings.apply(&geometry);
+	level = ctx->game->settings.level;
+	wrap = ctx->game->settings.wrap;
+#endif
+	gameRect = geometry.rect();
+	board = new Board(geometry.horizontalCount, geometry.verticalCount, wrap, snakeCount);
+	board->reset(seed, level);
+	if (restore){
+		//Las partidas continuadas no se graban, pues la repetición debe empezar
+		//desde el principio de la partida
+		ctx->game->replay.cancel();
+		if (ctx->game->snapshot.restore(board, level, &seed, &playTime)){
+			nextDir[0] = board->snakes[0].direction;
+		}else{
+			playTime = 0;
+			board->reset(seed, level);
+		}
+	}else if (mode == Playing){
+		ctx->game->replay.begin(seed);
 	}
-	//Posicionar en el medio del eje X
-	gameRect.x = (ctx->width - gameRect.w) / 2;
-
-
-	//Calcular el número de bloques que caben en la pantalla
-	horizontalBlockCount = (gameRect.w - 2) / blockSize;
-	verticalBlockCount = (gameRect.h - 2) / blockSize;
-	totalBlockCount = horizontalBlockCount * verticalBlockCount;
-
-	//Inicializar serpiente
-	snakeBlocks = new BufferedQueue<int>(totalBlockCount);
-	//Iniciar matriz de objetos de la partida
-	itemMatrix = new InGameItemType[totalBlockCount];
-	memset(itemMatrix, 0, totalBlockCount);
-	//Introducir 3 bloques iniciales
-	for (int i = 0; i < 3; i++){
-		itemMatrix[i] = SnakeObject;
-		snakeBlocks->push(i);
+	if (mode == Playing){
+		ctx->game->stats.gameStarted(restore && playTime > 0, playTime);
+	}
+	if (mode == Demo){
+		//Como el modo de ayuda, el núcleo de alcanzabilidad solo se reserva si cabe
+		int available = free_ram() - BOARD_RAM_RESERVE;
+		pilot = new Autopilot(board, available > 0 &&
+				Reachability::ramNeeded(board->horizontalCount, board->verticalCount) <= (unsigned int)available);
+	}
+#ifdef ASSIST_MODE
+	if (mode == Playing){
+		unsigned int tintBytes = (board->totalCount + 7) / 8;
+		int available = free_ram() - BOARD_RAM_RESERVE;
+		if (available > 0 && Reachability::ramNeeded(board->horizontalCount, board->verticalCount) + tintBytes <= (unsigned int)available){
+			assist = new Reachability(board->horizontalCount, board->verticalCount, board->wrap);
+			assistTint = new byte[tintBytes]();
+		}
 	}
-	this->regenCoin();
+#endif
+#ifdef SERIAL_REMOTE
+	ctx->game->remote.gameStarted(board, seed, level);
+#endif
+	updateCoinPos();
+#ifdef SMOOTH_MOVEMENT
+	smoothDrawn = geometry.blockSize;
+#endif
 	this->fullRender();
+	ctx->game->wakeAfter(0);
 }
 
 void GameScreen::render() {
@@ -457,9 +950,30 @@ void GameScreen::render() {
 	}
 	Input* input = ctx->game->input;
 
-	if (input->currentDir != None && nextDir != direction_opposite(input->currentDir)
-			&& lastDir != direction_opposite(input->currentDir)){
-		nextDir = input->currentDir;
+	if (mode == Replaying || mode == Demo){
+		//Durante una repetición o una demostración, cualquier control vuelve al menú
+		if (input->start || input->dir != None){
+			ctx->game->initScreen(new MainMenuScreen(ctx));
+			return;
+		}
+	}else{
+#ifdef ASSIST_MODE
+		Direction assistDir = nextDir[0];
+#endif
+		//Cada jugador controla su serpiente con su propia entrada
+		for (byte s = 0; s < board->snakeCount; s++){
+			Direction dir = ctx->game->inputs[s]->currentDir;
+			if (dir != None && nextDir[s] != direction_opposite(dir)
+					&& board->snakes[s].direction != direction_opposite(dir)){
+				nextDir[s] = dir;
+			}
+		}
+#ifdef ASSIST_MODE
+		//Avisar en cuanto se elige un giro peligroso, sin esperar al paso
+		if (assist != null && nextDir[0] != assistDir){
+			updateAssist(false);
+		}
+#endif
 	}
 
 	if (input->start){ //Pausar juego
@@ -471,80 +985,139 @@ void GameScreen::render() {
 	//valor		3	2	1	0	-1			-2
 	//accion	3!	2!	1!	Go!	Borrar go!	Primer loop del juego
 	if (countdown == -2){
-		if (millis() - lastMillis > movementDelay){
-			lastDir = nextDir;
-			lastMillis = millis();
-			int headIndex= *snakeBlocks->tail;
+		unsigned long period = stepDelay();
+		if (millis() - lastMillis >= period){
+			unsigned long stepStart = micros();
+			if (stepWork != 0){
+				budget.measured(BudgetStep, stepWork);
+				stepWork = 0;
+			}
 
-			switch(nextDir){
-			case Left:
-				if (headIndex % horizontalBlockCount == 0)
-					headIndex = -1;
-				else headIndex--;
+			//Cada paso va a su hora aunque el anterior se haya retrasado, salvo si
+			//se ha perdido uno entero (o después de la cuenta atrás)
+			unsigned long stepTime = lastMillis + period;
+			if (lastMillis == 0 || millis() - stepTime >= period){
+				stepTime = millis();
+			}
+			if (lastMillis != 0){
+				playTime += stepTime - lastMillis;
+			}
+			Direction direction = board->snakes[0].direction;
+			if (player != null){
+				nextDir[0] = direction_turn(direction, player->step());
+			}else if (pilot != null){
+				nextDir[0] = pilot->decide(direction, board->coinIndex);
+			}else if (mode == Playing){
+				ctx->game->replay.step(direction_relative(direction, nextDir[0]));
+			}
+			lastMillis = stepTime;
+#ifdef SMOOTH_MOVEMENT
+			//Terminar de dibujar el paso anterior antes de mover las serpientes
+			renderSmooth(geometry.blockSize);
+#endif
 
-				break;
-			case Right:
-				if (headIndex % horizontalBlockCount == horizontalBlockCount - 1)
-					headIndex = -1;
-				else headIndex++;
-				break;
-			case Up:
-				if (headIndex / horizontalBlockCount == 0)
-					headIndex = -1;
-				else headIndex -= horizontalBlockCount;
-				break;
-			case Down:
-				if (headIndex / horizontalBlockCount == verticalBlockCount - 1)
-					headIndex = -1;
-				else headIndex += horizontalBlockCount;
-				break;
-			case None:
-				break;
+			//Todas las serpientes se mueven a la vez sobre el mismo tablero
+			StepResult results[BOARD_MAX_SNAKES];
+			board->stepAll(nextDir, results);
+#ifdef SERIAL_REMOTE
+			ctx->game->remote.ack(board->steps, board->hash());
+#endif
+			bool collision = false;
+			bool coinChanged = false;
+			for (byte s = 0; s < board->snakeCount; s++){
+				collision |= results[s] == Collision;
+				coinChanged |= results[s] != Moved;
 			}
-			if (headIndex == -1 || itemMatrix[headIndex] == SnakeObject){ //Setear itemAtCell tras estar seguros de que el nuevo objeto está dentro del recinto de juego!
+			if (collision){
 				//Game over
+#ifdef TWO_PLAYERS
+				if (mode == TwoPlayers){
+					callVersusOver(results);
+					return;
+				}
+#endif
 				callGameOver(false);
 				return;
-			}else{
-				snakeBlocks->push(headIndex);
-				ctx->fillRect(rectForMatrixIndex(headIndex), GREEN);
-
-				if (itemMatrix[headIndex] == Coin){
-					score += 20 * snakeBlocks->size();
-					//Resetear la coin
-					regenCoin();
-
-					//Disminuir el delay, para aumentar la velocidad del juego
-					if ((movementDelay += movementDelta) < minMovementDelay){
-						movementDelay = minMovementDelay;
-					}
-				}else{
-					score += snakeBlocks->size();
-					int tail = *snakeBlocks->pop();
-					ctx->fillRect(rectForMatrixIndex(tail), BLACK);
-					itemMatrix[tail] = Empty;
+			}
+			//Un piloto que da vueltas sin comer no debe mantener la demostración para siempre
+			if (pilot != null && pilot->stalled()){
+				callGameOver(false);
+				return;
+			}
+
+#ifdef SMOOTH_MOVEMENT
+			beginSmooth();
+#else
+			//Las colas liberadas se borran juntas, con un solo cambio de color,
+			//y después se dibujan las cabezas
+			Rect freed[BOARD_MAX_SNAKES];
+			int freedCount = 0;
+			for (byte s = 0; s < board->snakeCount; s++){
+				if (board->snakes[s].tailFreed){
+					freed[freedCount++] = geometry.cellRect(board->snakes[s].freedTail);
+				}
+			}
+			ctx->fillRects(freed, freedCount, BLACK);
+			for (byte s = 0; s < board->snakeCount; s++){
+				ctx->fillRect(geometry.cellRect(board->snakes[s].head), snakeColor(s));
+			}
+#endif
+			if (coinChanged){
+				updateCoinPos();
+				if (mode == Playing && results[0] == CoinEaten){
+					ctx->game->stats.coinEaten(playTime);
 				}
-				itemMatrix[headIndex] = SnakeObject;
-				renderScoreValue();
-				if ((int)snakeBlocks->size() == totalBlockCount){
-					//Pantalla sin espacio (El jugador ha ganado (olé sus huevos))
-					callGameOver(true);
+			}
+			scoreDirty = true;
+			if (results[0] == BoardFull){
+#ifdef SMOOTH_MOVEMENT
+				renderSmooth(geometry.blockSize);
+#endif
+#ifdef TWO_PLAYERS
+				if (mode == TwoPlayers){
+					callVersusOver(results);
+					return;
 				}
+#endif
+				callGameOver(true);
+				return;
 			}
+#ifdef ASSIST_MODE
+			if (assist != null){
+				updateAssist(true);
+			}
+#endif
+			stepWork += micros() - stepStart;
 		}
+#ifdef SMOOTH_MOVEMENT
+		unsigned long smoothStart = micros();
+		renderSmooth(smoothDepth());
+		stepWork += micros() - smoothStart;
+#endif
 
-		if (millis() - coinLastTilt > 100){
+		//El marcador y el parpadeo de la moneda solo se dibujan si caben antes del
+		//siguiente paso; si no, esperan a después de éste
+		unsigned long deadline = lastMillis + stepDelay();
+		if (scoreDirty && budget.fits(BudgetScore, deadline)){
+			unsigned long start = micros();
+			renderScoreValue();
+			budget.measured(BudgetScore, micros() - start);
+			scoreDirty = false;
+		}
+		if (millis() - coinLastTilt > 100 && budget.fits(BudgetCoinBlink, deadline)){
+			unsigned long start = micros();
 			coinLastTilt = millis();
 			if ((coinVisible = !coinVisible)){
 				ctx->fillRect(coinPos, BLACK);
 			}else{
 				ctx->fillRect(coinPos, AQUA);
 			}
+			budget.measured(BudgetCoinBlink, micros() - start);
 		}
 	}else{
 		if (millis() - lastMillis > 1000){
 			lastMillis = millis();
-			ctx->fillRect(countdownRect, BLACK);
+			repaintRegion(countdownRect);
 			char* title;
 			switch(countdown--){
 			case 3:
@@ -563,11 +1136,7 @@ void GameScreen::render() {
 				//El siguiente loop iniciará el movimiento de la serpiente,
 				//asi que reseteamos esta variable aquí para evitar retrasos.
 				lastMillis = 0;
-
-				//Renderizar todo de nuevo, para evitar que la serpiente
-				//u otros elementos salgan cortados despues de salir del
-				//pausa
-				fullRender(false, false, true);
+				ctx->game->wakeAfter(0);
 				return;
 			}
 			Size sz = ctx->getTextSize(title, 3);
@@ -577,109 +1146,516 @@ void GameScreen::render() {
 			delete[] title;
 		}
 	}
-	delay(50);
+
+	//Despertar cuando venza el siguiente paso, parpadeo o número de la cuenta atrás
+	if (countdown == -2){
+		unsigned long stepAt = lastMillis + stepDelay();
+		unsigned long blinkAt = coinLastTilt + 101;
+		ctx->game->wakeAt(stepAt);
+		//Un parpadeo aplazado espera al siguiente paso
+		ctx->game->wakeAt((long)(blinkAt - millis()) > 0 ? blinkAt : stepAt);
+#ifdef SMOOTH_MOVEMENT
+		if (smoothDrawn < geometry.blockSize){
+			//La siguiente franja, al empezar su fracción del paso
+			unsigned long frames = (geometry.blockSize + SMOOTH_MOVEMENT - 1) / SMOOTH_MOVEMENT;
+			unsigned long frame = smoothDrawn / SMOOTH_MOVEMENT;
+			ctx->game->wakeAt(lastMillis + (frame * stepDelay() + frames - 1) / frames);
+		}
+#endif
+	}else{
+		ctx->game->wakeAt(lastMillis + 1001);
+	}
 }
 
 void GameScreen::fullRender(bool clean, bool drawBorder, bool drawSnake) {
 	if (clean)
 		ctx->clear(BLACK);
-	if (drawBorder)
-		ctx->drawRect(gameRect, WHITE);
-	if (drawSnake && snakeBlocks->size() > 0){
-		for (unsigned int i = 0; i < snakeBlocks->size(); i++){
-			ctx->fillRect(rectForMatrixIndex(*snakeBlocks->itemAtHeadOffset(i)), GREEN);
+	if (drawBorder){
+		//Sin bordes, el rectángulo solo marca los límites del tablero
+		if (board->wrap){
+			ctx->drawRect(gameRect, GREY);
+		}else{
+			ctx->drawRect(gameRect, WHITE);
+		}
+	}
+	if (drawSnake)
+		renderWalls();
+	if (drawSnake){
+		//Los bloques de cada serpiente se dibujan por lotes, con un solo cambio de color por lote
+		Rect batch[SNAKE_RENDER_BATCH];
+		for (byte s = 0; s < board->snakeCount; s++){
+			BufferedQueue<Cell>* blocks = board->snakes[s].blocks;
+			int count = 0;
+			for (unsigned int i = 0; i < blocks->size(); i++){
+				batch[count++] = geometry.cellRect(*blocks->itemAtHeadOffset(i));
+				if (count == SNAKE_RENDER_BATCH){
+					ctx->fillRects(batch, count, snakeColor(s));
+					count = 0;
+				}
+			}
+			ctx->fillRects(batch, count, snakeColor(s));
+		}
+#ifdef ASSIST_MODE
+		if (assist != null){
+			memset(assistTint, 0, (board->totalCount + 7) / 8);
+			assistWarning = -1;
+			updateAssist(true);
 		}
+#endif
 	}
 
-	char* scoreText = lstr(STR_GAME_SCORE);
-	scoreRenderRect = {gameRect.x + 1, (gameRect.y - 10) / 2, 0, 0};
-	ctx->drawText(scoreText, 1, {scoreRenderRect.x, scoreRenderRect.y}, WHITE);
-	scoreRenderRect.x += ctx->getTextSize(scoreText, 1).w;
-	delete[] scoreText;
+	renderScoreBar();
+}
+
+void GameScreen::renderScoreBar(){
+	//Con dos jugadores, la puntuación de cada uno ocupa la mitad del marcador
+	for (byte s = 0; s < board->snakeCount; s++){
+		char* scoreText;
+		Color color = WHITE;
+#ifdef TWO_PLAYERS
+		if (mode == TwoPlayers){
+			scoreText = lstr(s == 0 ? STR_VERSUS_P1 : STR_VERSUS_P2);
+			color = snakeColor(s);
+		}else
+#endif
+		{
+			scoreText = lstr(STR_GAME_SCORE);
+		}
+		Rect* scoreRect = &scoreRenderRect[s];
+		*scoreRect = {gameRect.x + 1 + s * gameRect.w / 2, (gameRect.y - 10) / 2, 0, 0};
+		ctx->drawText(scoreText, 1, {scoreRect->x, scoreRect->y}, color);
+		scoreRect->x += ctx->getTextSize(scoreText, 1).w;
+		delete[] scoreText;
+	}
 	renderScoreValue();
 }
 
+/*
+ * Vuelve a dibujar solo lo que hay dentro de region a partir del estado de la
+ * partida: el marcador, el borde, los muros (de itemMatrix), las serpientes (de
+ * sus colas de bloques) y la moneda. Las celdas que cortan el borde de la
+ * región se dibujan enteras.
+ */
+void GameScreen::repaintRegion(Rect region){
+	region = rect_intersection(region, {0, 0, ctx->width, ctx->height});
+	if (region.w <= 0 || region.h <= 0) return;
+	ctx->fillRect(region, BLACK);
+
+	if (region.y < gameRect.y){
+		renderScoreBar();
+	}
+
+	Rect edges[4] = {
+			{gameRect.x, gameRect.y, gameRect.w, 1},
+			{gameRect.x, gameRect.y + gameRect.h - 1, gameRect.w, 1},
+			{gameRect.x, gameRect.y, 1, gameRect.h},
+			{gameRect.x + gameRect.w - 1, gameRect.y, 1, gameRect.h}
+	};
+	for (byte i = 0; i < 4; i++){
+		Rect edge = rect_intersection(edges[i], region);
+		if (edge.w > 0 && edge.h > 0){
+			if (board->wrap){
+				ctx->fillRect(edge, GREY);
+			}else{
+				ctx->fillRect(edge, WHITE);
+			}
+		}
+	}
+
+	Rect inner = rect_intersection(region, {gameRect.x + 1, gameRect.y + 1, gameRect.w - 2, gameRect.h - 2});
+	if (inner.w <= 0 || inner.h <= 0) return;
+	Cell from = geometry.cellAt(inner.x, inner.y);
+	Cell to = geometry.cellAt(inner.x + inner.w - 1, inner.y + inner.h - 1);
+
+	Rect batch[SNAKE_RENDER_BATCH];
+	int count = 0;
+	for (byte y = from.y; y <= to.y; y++){
+		for (byte x = from.x; x <= to.x; x++){
+			Cell cell = {x, y};
+			if ((board->itemMatrix[board->indexOf(cell)] & ITEM_TYPE_MASK) == Wall){
+				batch[count++] = geometry.cellRect(cell);
+				if (count == SNAKE_RENDER_BATCH){
+					ctx->fillRects(batch, count, GREY);
+					count = 0;
+				}
+			}
+		}
+	}
+	ctx->fillRects(batch, count, GREY);
+
+	for (byte s = 0; s < board->snakeCount; s++){
+		BufferedQueue<Cell>* blocks = board->snakes[s].blocks;
+		count = 0;
+		for (unsigned int i = 0; i < blocks->size(); i++){
+			Cell cell = *blocks->itemAtHeadOffset(i);
+			if (cell.x >= from.x && cell.x <= to.x && cell.y >= from.y && cell.y <= to.y){
+				batch[count++] = geometry.cellRect(cell);
+				if (count == SNAKE_RENDER_BATCH){
+					ctx->fillRects(batch, count, snakeColor(s));
+					count = 0;
+				}
+			}
+		}
+		ctx->fillRects(batch, count, snakeColor(s));
+	}
+
+	Cell coin = board->coin;
+	if (board->coinIndex != -1 && coin.x >= from.x && coin.x <= to.x && coin.y >= from.y && coin.y <= to.y){
+		ctx->fillRect(coinPos, AQUA);
+	}
+#ifdef ASSIST_MODE
+	if (assist != null){
+		renderAssist(from, to);
+	}
+#endif
+}
+
 void GameScreen::renderScoreValue(){
-	ctx->fillRect(scoreRenderRect, BLACK);
-	char* cscore = new char[ctx->getNumberLength(score) + 1]();
-	ultoa(score, cscore, 10);
-
-	Size sz = ctx->getTextSize(cscore, 1);
-	scoreRenderRect.w = sz.w;
-	scoreRenderRect.h = sz.h;
-
-	ctx->drawText(cscore, 1, {scoreRenderRect.x, scoreRenderRect.y}, WHITE);
-
-	delete[] cscore;
-}
-
-void GameScreen::regenCoin(){
-	int randIndex = random(0, totalBlockCount - snakeBlocks->size());
-	int c = 0;
-
-	int cellx = 0;
-	int celly = 0;
-	int coinIndex = 0;
-
-	/*
-	 * Teniendo en cuenta que la moneda no puede aparecer sobre un bloque ocupado
-	 * por una parte de la serpiente, en los momentos avanzados de la partida,
-	 * cuando la serpiente es muy larga, un algoritmo que genere posiciones aleatorias
-	 * puede producir retrasos en el juego debido al elevado número de posibilidades
-	 * de que las coordenadas generadas puedan chocar con los bloques de la serpiente.
-	 *
-	 * Como alternativa se utilizará este método que, pese a que su complejidad es de O(n),
-	 * donde n es el número de bloques máximo de la pantalla de juego, consigue buenos
-	 * resultados en cuanto a rendimiento (En la Arduino Mega rev3 tarda < 1 ms).
-	 */
-	for (int i = 0; i < totalBlockCount; i++){
-		if (itemMatrix[i] == Empty){
-			if ((c++) == randIndex) {
-				celly = i / horizontalBlockCount;
-				cellx = i % horizontalBlockCount;
-				coinIndex = i;
-				break;
+	for (byte s = 0; s < board->snakeCount; s++){
+		unsigned long score = board->snakes[s].score;
+		Rect* scoreRect = &scoreRenderRect[s];
+		char* cscore = new char[ctx->getNumberLength(score) + 1]();
+		ultoa(score, cscore, 10);
+
+		//El texto es opaco: solo hay que borrar lo que sobre de la puntuación anterior
+		Size sz = ctx->getTextSize(cscore, 1);
+		if (scoreRect->w > sz.w){
+			ctx->fillRect({scoreRect->x + sz.w, scoreRect->y, scoreRect->w - sz.w, scoreRect->h}, BLACK);
+		}
+		scoreRect->w = sz.w;
+		scoreRect->h = sz.h;
+
+		ctx->drawText(cscore, 1, {scoreRect->x, scoreRect->y}, WHITE);
+
+		delete[] cscore;
+	}
+}
+
+/*
+ * Dibuja los muros del nivel a medida que se leen de la memoria flash, con un
+ * rectángulo por cada tramo de muros en vez de uno por celda. Los tramos en los
+ * que Board::reset ha quitado algún muro (bajo las serpientes) se dibujan fila a
+ * fila, saltando esas celdas.
+ */
+void GameScreen::renderWalls(){
+	LevelDecoder walls(level, geometry.horizontalCount, geometry.verticalCount);
+	WallRun run;
+	while (walls.next(&run)){
+		bool whole = true;
+		for (byte y = run.y; y < run.y + run.h && whole; y++){
+			const InGameItemType* row = board->itemMatrix + board->indexOf({run.x, y});
+			for (byte x = 0; x < run.w && whole; x++){
+				whole = (row[x] & ITEM_TYPE_MASK) == Wall;
+			}
+		}
+		if (whole){
+			Point pt = geometry.point({run.x, run.y});
+			ctx->fillRect({pt.x, pt.y, run.w * geometry.blockSize, run.h * geometry.blockSize}, GREY);
+			continue;
+		}
+
+		for (byte y = run.y; y < run.y + run.h; y++){
+			const InGameItemType* row = board->itemMatrix + board->indexOf({run.x, y});
+			for (byte x = 0; x < run.w; x++){
+				if ((row[x] & ITEM_TYPE_MASK) != Wall) continue;
+				byte end = x;
+				while (end < run.w && (row[end] & ITEM_TYPE_MASK) == Wall) end++;
+				Point pt = geometry.point({(byte)(run.x + x), y});
+				ctx->fillRect({pt.x, pt.y, (end - x) * geometry.blockSize, geometry.blockSize}, GREY);
+				x = end;
 			}
 		}
 	}
+}
 
-	itemMatrix[coinIndex] = Coin;
+#ifdef ASSIST_MODE
+/*
+ * El tinte de una celda inalcanzable: un cuadrado centrado de la mitad del tamaño
+ * del bloque, que no pisa ni la marca de peligro (el contorno) ni la moneda.
+ */
+static Rect assistTintRect(Rect cell){
+	int inset = cell.w / 4;
+	return {cell.x + inset, cell.y + inset, cell.w - 2 * inset, cell.h - 2 * inset};
+}
 
-	//2 => 1 + 1 => 1 pixel del borde + 1 pixel de diferencia con respecto a la posición obtenida,
-	//para que éste siempre aparezca en un punto centrado respecto a los bloques de la serpiente
-	coinPos = {cellx * blockSize + gameRect.x + 2, celly * blockSize + gameRect.y + 2, coinSize, coinSize};
+/*
+ * Actualiza el modo de ayuda: si tint es true, vuelve a calcular las celdas
+ * libres que la cabeza ya no puede alcanzar y redibuja solo las que cambian; en
+ * cualquier caso, marca la celda siguiente si el giro elegido encierra a la serpiente.
+ */
+void GameScreen::updateAssist(bool tint){
+	Snake* snake = &board->snakes[0];
+	if (tint){
+		assist->load(board->itemMatrix);
+		assist->fill(snake->headIndex);
+
+		//Las celdas que se tiñen y las que dejan de estarlo se dibujan por lotes
+		Rect tinted[SNAKE_RENDER_BATCH];
+		Rect cleared[SNAKE_RENDER_BATCH];
+		int tintedCount = 0;
+		int clearedCount = 0;
+		int index = 0;
+		for (byte y = 0; y < board->verticalCount; y++){
+			for (byte x = 0; x < board->horizontalCount; x++, index++){
+				bool unreachable = assist->isFree(x, y) && !assist->reached(x, y) && index != board->coinIndex;
+				byte bit = 1 << (index & 7);
+				if (unreachable == ((assistTint[index >> 3] & bit) != 0)) continue;
+				assistTint[index >> 3] ^= bit;
+				Rect rect = geometry.cellRect({x, y});
+				if (unreachable){
+					tinted[tintedCount++] = assistTintRect(rect);
+				}else if ((board->itemMatrix[index] & ITEM_TYPE_MASK) == Empty){
+					//Las celdas que ya ocupa la serpiente no se borran
+					cleared[clearedCount++] = assistTintRect(rect);
+				}
+				if (tintedCount == SNAKE_RENDER_BATCH){
+					ctx->fillRects(tinted, tintedCount, DARK_RED);
+					tintedCount = 0;
+				}
+				if (clearedCount == SNAKE_RENDER_BATCH){
+					ctx->fillRects(cleared, clearedCount, BLACK);
+					clearedCount = 0;
+				}
+			}
+		}
+		ctx->fillRects(tinted, tintedCount, DARK_RED);
+		ctx->fillRects(cleared, clearedCount, BLACK);
+	}
+
+	//Celda siguiente: solo se marca si está libre (los choques no son encierros)
+	int warning = -1;
+	Cell next = snake->head;
+	int nextIndex = snake->headIndex;
+	if (board->neighbor(nextDir[0], &next, &nextIndex) && (board->itemMatrix[nextIndex] & ITEM_TYPE_MASK) < SnakeObject
+			&& !assist->safeMove(board, snake, nextIndex)){
+		warning = nextIndex;
+	}
+	if (warning == assistWarning) return;
+	if (assistWarning != -1 && (board->itemMatrix[assistWarning] & ITEM_TYPE_MASK) < SnakeObject){
+		Cell cell = {(byte)(assistWarning % board->horizontalCount), (byte)(assistWarning / board->horizontalCount)};
+		ctx->drawRect(geometry.cellRect(cell), BLACK);
+	}
+	if (warning != -1){
+		ctx->drawRect(geometry.cellRect(next), RED);
+	}
+	assistWarning = warning;
+}
+
+/*
+ * Vuelve a dibujar el tinte y la marca de peligro de las celdas entre from y to.
+ */
+void GameScreen::renderAssist(Cell from, Cell to){
+	Rect batch[SNAKE_RENDER_BATCH];
+	int count = 0;
+	for (byte y = from.y; y <= to.y; y++){
+		int index = board->indexOf({from.x, y});
+		for (byte x = from.x; x <= to.x; x++, index++){
+			if (assistTint[index >> 3] & (1 << (index & 7))){
+				batch[count++] = assistTintRect(geometry.cellRect({x, y}));
+				if (count == SNAKE_RENDER_BATCH){
+					ctx->fillRects(batch, count, DARK_RED);
+					count = 0;
+				}
+			}
+			if (index == assistWarning){
+				ctx->drawRect(geometry.cellRect({x, y}), RED);
+			}
+		}
+	}
+	ctx->fillRects(batch, count, DARK_RED);
+}
+#endif
+
+#ifdef SMOOTH_MOVEMENT
+//Dirección en la que se pasa de la celda from a su vecina to (también a través de los bordes)
+static Direction step_direction(Board* board, Cell from, Cell to){
+	if (from.x == to.x){
+		return to.y == (from.y + 1) % board->verticalCount ? Down : Up;
+	}
+	return to.x == (from.x + 1) % board->horizontalCount ? Right : Left;
+}
+
+/*
+ * Empieza a dibujar el paso que se acaba de dar: las cabezas entran en su celda
+ * y las colas salen de la suya hacia el bloque que pasa a ser la cola. Las colas
+ * liberadas que ya ocupa otra cabeza no se borran, y las que ocupa la moneda
+ * nueva se borran de golpe.
+ */
+void GameScreen::beginSmooth(){
+	smoothTailCount = 0;
+	for (byte s = 0; s < board->snakeCount; s++){
+		Snake* snake = &board->snakes[s];
+		if (!snake->tailFreed) continue;
+		switch (board->itemMatrix[board->indexOf(snake->freedTail)] & ITEM_TYPE_MASK){
+		case Empty:
+			smoothTails[smoothTailCount] = snake->freedTail;
+			smoothTailDirs[smoothTailCount++] = step_direction(board, snake->freedTail, *snake->blocks->itemAtHeadOffset(0));
+			break;
+		case Coin:
+			ctx->fillRect(geometry.cellRect(snake->freedTail), BLACK);
+			break;
+		default:
+			break;
+		}
+	}
+	smoothDrawn = 0;
+	renderSmooth(smoothDepth());
+}
+
+//Píxeles de las cabezas y las colas que deberían estar dibujados en este instante
+int GameScreen::smoothDepth(){
+	unsigned long frames = (geometry.blockSize + SMOOTH_MOVEMENT - 1) / SMOOTH_MOVEMENT;
+	unsigned long frame = (millis() - lastMillis) * frames / stepDelay();
+	if (frame + 1 >= frames) return geometry.blockSize;
+	return (frame + 1) * SMOOTH_MOVEMENT;
+}
+
+/*
+ * Dibuja las franjas de las cabezas y las colas hasta la profundidad depth. Las
+ * colas van primero, con un solo cambio de color, por si alguna cabeza entra en
+ * la celda de al lado.
+ */
+void GameScreen::renderSmooth(int depth){
+	if (depth <= smoothDrawn) return;
+	Rect tails[BOARD_MAX_SNAKES];
+	for (byte i = 0; i < smoothTailCount; i++){
+		tails[i] = geometry.cellRect(smoothTails[i]);
+	}
+	ctx->fillSlivers(tails, smoothTailDirs, smoothTailCount, smoothDrawn, depth, BLACK);
+	for (byte s = 0; s < board->snakeCount; s++){
+		Snake* snake = &board->snakes[s];
+		ctx->fillSliver(geometry.cellRect(snake->head), snake->direction, smoothDrawn, depth, snakeColor(s));
+	}
+	smoothDrawn = depth;
+#ifdef ASSIST_MODE
+	//El tinte de una cola que ha quedado encerrada se dibuja al terminar de borrarla
+	if (assist != null && depth == geometry.blockSize){
+		for (byte i = 0; i < smoothTailCount; i++){
+			renderAssist(smoothTails[i], smoothTails[i]);
+		}
+	}
+#endif
+}
+#endif
+
+//El retraso entre pasos: el de las reglas, salvo si la pantalla no da para tanto
+unsigned int GameScreen::stepDelay(){
+	unsigned int rules = board->movementDelay;
+	return rules > budget.minDelay ? rules : budget.minDelay;
+}
+
+void GameScreen::updateCoinPos(){
+	if (board->coinIndex == -1){
+		coinPos = {0, 0, 0, 0};
+		return;
+	}
+	Point pt = geometry.point(board->coin);
+
+	//+1 => 1 pixel de diferencia con respecto a la posición del bloque, para que
+	//éste siempre aparezca en un punto centrado respecto a los bloques de la serpiente
+	coinPos = {pt.x + 1, pt.y + 1, geometry.blockSize - 2, geometry.blockSize - 2};
+}
+
+/*
+ * Recorre la serpiente desde la cabeza hasta la cola pintándola de rojo y borrándola.
+ */
+void GameScreen::animateCrash(BufferedQueue<Cell>* blocks){
+	Rect* prev = null;
+	for (unsigned int i = 0; i < blocks->size(); i++){
+		Rect current = geometry.cellRect(*blocks->itemAtHeadOffset(blocks->size() - 1 - i));
+		if (prev != null){
+			ctx->fillRect(*prev, DARK_RED);
+		}
+		ctx->fillRect(current, RED);
+		delay(50);
+		if (prev == null){
+			prev = (Rect*)malloc(sizeof(Rect));
+		}else{
+			ctx->fillRect(*prev, BLACK);
+		}
+		memcpy(prev, &current, sizeof(Rect));
+	}
+	delay(50);
+	ctx->fillRect(*prev, BLACK);
+	free(prev);
 }
 
 void GameScreen::callGameOver(bool win){
+	BufferedQueue<Cell>* snakeBlocks = board->snakes[0].blocks;
+	unsigned long score = board->snakes[0].score;
 	delay(500);
 	if (!win){
-		Rect* prev = null;
-		for (unsigned int i = 0; i < snakeBlocks->size(); i++){
-			Rect current = rectForMatrixIndex(*snakeBlocks->itemAtTailOffset(-i));
-			if (prev != null){
-				ctx->fillRect(*prev, DARK_RED);
-			}
-			ctx->fillRect(current, RED);
-			delay(50);
-			if (prev == null){
-				prev = (Rect*)malloc(sizeof(Rect));
-			}else{
-				ctx->fillRect(*prev, BLACK);
+		animateCrash(snakeBlocks);
+		delay(500);
+	}
+	if (mode == Demo){
+#ifdef AUTOPILOT_SOAK
+#ifdef BEGIN_SERIAL
+		Serial.print("Autopilot score: ");
+		Serial.print(score);
+		Serial.print(", length: ");
+		Serial.print(snakeBlocks->size());
+		Serial.print(", max decision time (us): ");
+		Serial.print(pilot->maxDecisionTime);
+		Serial.print(", max fill time (us): ");
+		Serial.println(pilot->maxFillTime());
+#endif
+		ctx->game->initScreen(new GameScreen(ctx, Demo));
+#else
+		ctx->game->initScreen(new MainMenuScreen(ctx));
+#endif
+		return;
+	}
+	if (mode == Replaying){
+		ctx->game->initScreen(new MainMenuScreen(ctx));
+		return;
+	}
+	ctx->game->snapshot.clear();
+	ctx->game->stats.gameEnded(board, win ? EndBoardFull : EndCollision, playTime);
+	HighScore entry = {score, (unsigned int)snakeBlocks->size(), (unsigned int)(playTime / 1000), seed};
+	byte rank = ctx->game->notifyScore(&entry);
+	ctx->game->replay.finish(rank == 0);
+	ctx->game->initScreen(new GameEndScreen(ctx, win, score, rank));
+}
+
+#ifdef TWO_PLAYERS
+void GameScreen::callVersusOver(const StepResult* results){
+	Snake* snakes = board->snakes;
+	char winner = -1;
+	delay(500);
+	if (results[0] == BoardFull){
+		//Tablero lleno: gana la mayor puntuación
+		if (snakes[0].score != snakes[1].score){
+			winner = snakes[0].score > snakes[1].score ? 0 : 1;
+		}
+	}else{
+		//Gana el que no ha chocado; si chocan los dos (o de frente), es un empate
+		for (byte s = 0; s < 2; s++){
+			if (results[s] == Collision){
+				animateCrash(snakes[s].blocks);
 			}
-			memcpy(prev, &current, sizeof(Rect));
 		}
-		delay(50);
-		ctx->fillRect(*prev, BLACK);
-		free(prev);
+		if (results[0] != Collision){
+			winner = 0;
+		}else if (results[1] != Collision){
+			winner = 1;
+		}
 		delay(500);
 	}
-	ctx->game->notifyScore(score);
-	ctx->game->initScreen(new GameEndScreen(ctx, win, score));
+	ctx->game->initScreen(new VersusEndScreen(ctx, winner, snakes[0].score, snakes[1].score));
 }
+#endif
 
 void GameScreen::pauseGame(){
 	if (pauseScreen != null)
 		return;
+	if (mode == Playing){
+		ctx->game->snapshot.save(board, level, seed, playTime);
+	}
+#ifdef SMOOTH_MOVEMENT
+	//La ventana de pausa solo repinta bloques enteros al cerrarse
+	renderSmooth(geometry.blockSize);
+#endif
 	pauseScreen = new PauseScreen(this);
 	pauseScreen->onInit();
 }
@@ -689,62 +1665,76 @@ void GameScreen::resumeGame(){
 		return;
 	pauseScreen->onEnd();
 
+	//Solo hay que repintar lo que tapaba la ventana de pausa
+	Rect window = pauseScreen->windowRect();
 	delete pauseScreen;
 	pauseScreen = null;
 
 	countdown = 3;
-	fullRender(true, true, true);
-}
-
-int GameScreen::matrixIndexAtCoord(int x, int y){
-	int ox = (x - gameRect.x + 1) / blockSize;
-	int oy = (y - gameRect.y + 1) / blockSize;
-	return oy * horizontalBlockCount + ox;
-}
-Point GameScreen::pointForMatrixIndex(int index){
-	return {(index % horizontalBlockCount) * blockSize + gameRect.x + 1,
-		(index / horizontalBlockCount) * blockSize + gameRect.y + 1};
-}
-Rect GameScreen::rectForMatrixIndex(int index){
-	return {(index % horizontalBlockCount) * blockSize + gameRect.x + 1,
-		(index / horizontalBlockCount) * blockSize + gameRect.y + 1,
-		blockSize, blockSize};
+	repaintRegion(window);
+	ctx->game->wakeAfter(0);
 }
 
 void GameScreen::onEnd() {}
 
 //PauseScreen
-PauseScreen::PauseScreen(GameScreen* game) : ListScreen(game->getContext()) {
+//Ventana centrada en la pantalla, con el título arriba y dos botones debajo
+#define PAUSE_WINDOW_WIDTH (TFT_WIDTH * 3 / 4)
+#define PAUSE_WINDOW_HEIGHT 72
+#define PAUSE_WINDOW_X ((TFT_WIDTH - PAUSE_WINDOW_WIDTH) / 2)
+#define PAUSE_WINDOW_Y ((TFT_HEIGHT - PAUSE_WINDOW_HEIGHT) / 2)
+#define PAUSE_TITLE_HEIGHT 34
+#define PAUSE_ITEM(text, i) {text, \
+		{PAUSE_WINDOW_X + 2, PAUSE_WINDOW_Y + PAUSE_TITLE_HEIGHT + 18 * (i), PAUSE_WINDOW_WIDTH - 4, 16}, \
+		LIST_PREV(i, 2), LIST_NEXT(i, 2), LIST_PREV(i, 2), LIST_NEXT(i, 2)}
+
+static const MenuItem pauseMenu[] PROGMEM = {
+	PAUSE_ITEM(STR_GAME_RESUME, 0),
+	PAUSE_ITEM(STR_GAME_EXIT_GAME, 1),
+};
+static const MenuItem pauseConfirmMenu[] PROGMEM = {
+	PAUSE_ITEM(STR_YES, 0),
+	PAUSE_ITEM(STR_NO, 1),
+};
+
+PauseScreen::PauseScreen(GameScreen* game) : ListScreen(game->getContext(), pauseMenu, 2) {
 	this->game = game;
-	itemCount = 2;
 }
 void PauseScreen::onInit() {
-	initScreen(lstr(STR_GAME_PAUSE), lstr(STR_GAME_RESUME), lstr(STR_GAME_EXIT_GAME));
+	initScreen(STR_GAME_PAUSE, pauseMenu);
+#ifdef ARDUINO_AVR_ESPLORA
+	ctx->game->wakeAfter(0);
+#endif
 }
 
-void PauseScreen::initScreen(char* title, char* button1, char* button2){
-	Rect titleRect = {0,0,ctx->width, (int)(ctx->height * 0.7)};
-	ctx->fillRect(titleRect, BLACK);
-	ctx->drawText(title, 2, CENTER(titleRect, ctx->getTextSize(title, 2)), ORANGE);
-	delete[] title;
+Rect PauseScreen::windowRect(){
+	return {PAUSE_WINDOW_X, PAUSE_WINDOW_Y, PAUSE_WINDOW_WIDTH, PAUSE_WINDOW_HEIGHT};
+}
 
-	ctx->fillRect({0,titleRect.h, ctx->width, ctx->height - titleRect.h}, BLACK);
-	itemCount = 2;
-	buildItemMatrix();
-	int buttonHeight = (ctx->height - titleRect.h) / itemCount;
-	int buttonY = titleRect.h;
-	items[0] = ListItem::create(ctx, button1, 1, {0, buttonY, ctx->width, buttonHeight}, 1,1,1,1, false);
-	items[1] = ListItem::create(ctx, button2, 1, {0, buttonY + buttonHeight, ctx->width, buttonHeight},0,0,0,0, false);
+void PauseScreen::initScreen(const char* title, const MenuItem* menu){
+	Rect window = windowRect();
+	ctx->fillRect(window, ORANGE, BLACK);
+
+	Rect titleRect = {window.x, window.y, window.w, PAUSE_TITLE_HEIGHT};
+	char* text = lstr(title);
+	ctx->drawText(text, 2, CENTER(titleRect, ctx->getTextSize(text, 2)), ORANGE);
+	delete[] text;
+
+	setMenu(menu, 2);
 	this->ListScreen::onInit();
 }
 
 void PauseScreen::render() {
 	this->ListScreen::render();
 	if (ctx->game->input->start){
-		delay(100);
 		switch(chosenItem){
 		case 0:
 			if (confirm){
+				//La partida abandonada ya no se puede continuar
+				if (game->mode == Playing){
+					ctx->game->snapshot.clear();
+					ctx->game->stats.gameEnded(game->board, EndQuit, game->playTime);
+				}
 				ctx->game->initScreen(new MainMenuScreen(ctx));
 			}else{
 				game->resumeGame();
@@ -754,16 +1744,14 @@ void PauseScreen::render() {
 #endif
 			break;
 		case 1:
-			deleteItems();
-
 			if (confirm){
 				confirm = false;
 				defaultItem = 0;
-				initScreen(lstr(STR_GAME_PAUSE), lstr(STR_GAME_RESUME), lstr(STR_GAME_EXIT_GAME));
+				initScreen(STR_GAME_PAUSE, pauseMenu);
 			}else{
 				confirm = true;
 				defaultItem = 1;
-				initScreen(lstr(STR_GAME_EXIT_CONFIRM), lstr(STR_YES), lstr(STR_NO));
+				initScreen(STR_GAME_EXIT_CONFIRM, pauseConfirmMenu);
 			}
 			break;
 		}
@@ -779,20 +1767,23 @@ void PauseScreen::render() {
 		}
 		Esplora.writeRGB(200 * ledPower,50 * ledPower, 0);
 		ledPower += 0.025f * ledDir;
-		delay(10);
+		ctx->game->wakeAfter(10);
 	}
-#else
-	delay(50);
 #endif
-
 }
 
 void PauseScreen::onEnd() {}
 
 //GameEndScreen
-GameEndScreen::GameEndScreen(Context* ctx, bool win, unsigned long score) : ListScreen(ctx) {
+static const MenuItem gameEndMenu[] PROGMEM = {
+	LIST_ITEM(STR_GAME_RETRY, 0, 2, DIALOG_TITLE_HEIGHT),
+	LIST_ITEM(STR_GAME_BACK_MENU, 1, 2, DIALOG_TITLE_HEIGHT),
+};
+
+GameEndScreen::GameEndScreen(Context* ctx, bool win, unsigned long score, byte rank) : ListScreen(ctx, gameEndMenu, 2) {
 	this->win = win;
 	this->score = score;
+	this->rank = rank;
 }
 void GameEndScreen::onInit() {
 	char* title;
@@ -806,9 +1797,9 @@ void GameEndScreen::onInit() {
 		titleColor = RED;
 	}
 
-	Rect titleRect = {0,0,ctx->width, (int)(ctx->height * 0.7)};
+	Rect titleRect = {0,0,ctx->width, DIALOG_TITLE_HEIGHT};
 	Size txtSize = ctx->getTextSize(title, 2);
-	Point titleLoc = CENTER(titleRect, txtSize);
+	Point titleLoc = {(ctx->width - txtSize.w) / 2, 4};
 
 	ctx->fillRect(titleRect, BLACK);
 	ctx->drawText(title, 2, titleLoc, titleColor);
@@ -816,8 +1807,7 @@ void GameEndScreen::onInit() {
 
 	ctx->fillRect({0,titleRect.h, ctx->width, ctx->height - titleRect.h}, BLACK);
 
-	Rect scoreRect = {0, titleLoc.y + txtSize.h, ctx->width, 0};
-	scoreRect.h = titleRect.h - scoreRect.y;
+	Rect scoreRect = {0, titleLoc.y + txtSize.h, ctx->width, 10};
 
 	char* scorePrefix = lstr(STR_GAME_SCORE);
 	int prefixLen = strlen(scorePrefix);
@@ -829,22 +1819,17 @@ void GameEndScreen::onInit() {
 	delete[] scoreText;
 	delete[] scorePrefix;
 
-	delay(500);
+	int tableY = scoreRect.y + scoreRect.h + 2;
+	renderHighScores(ctx, {4, tableY, ctx->width - 8, titleRect.h - tableY}, rank);
 
-	itemCount = 2;
-	buildItemMatrix();
-	int buttonHeight = (ctx->height - titleRect.h) / itemCount;
-	int buttonY = titleRect.h;
+	delay(500);
 
-	items[0] = ListItem::create(ctx, lstr(STR_GAME_RETRY), 1, {0, buttonY, ctx->width, buttonHeight}, 1,1,1,1, false);
-	items[1] = ListItem::create(ctx, lstr(STR_GAME_BACK_MENU), 1, {0, buttonY + buttonHeight, ctx->width, buttonHeight},0,0,0,0, false);
 	this->ListScreen::onInit();
 }
 
 void GameEndScreen::render() {
 	this->ListScreen::render();
 	if (ctx->game->input->start){
-		delay(100);
 		switch(chosenItem){
 		case 0:
 			ctx->game->initScreen(new GameScreen(ctx));
@@ -854,7 +1839,73 @@ void GameEndScreen::render() {
 			break;
 		}
 	}
-	delay(50);
 }
 
 void GameEndScreen::onEnd() {}
+
+//VersusEndScreen
+#ifdef TWO_PLAYERS
+static const MenuItem versusEndMenu[] PROGMEM = {
+	LIST_ITEM(STR_VERSUS_REMATCH, 0, 2, DIALOG_TITLE_HEIGHT),
+	LIST_ITEM(STR_GAME_BACK_MENU, 1, 2, DIALOG_TITLE_HEIGHT),
+};
+
+VersusEndScreen::VersusEndScreen(Context* ctx, char winner, unsigned long score1, unsigned long score2) : ListScreen(ctx, versusEndMenu, 2) {
+	this->winner = winner;
+	this->scores[0] = score1;
+	this->scores[1] = score2;
+}
+void VersusEndScreen::onInit() {
+	char* title;
+	Color titleColor = WHITE;
+	if (winner == 0){
+		title = lstr(STR_VERSUS_P1_WINS);
+		titleColor = snakeColor(0);
+	}else if (winner == 1){
+		title = lstr(STR_VERSUS_P2_WINS);
+		titleColor = snakeColor(1);
+	}else{
+		title = lstr(STR_VERSUS_DRAW);
+	}
+
+	Rect titleRect = {0,0,ctx->width, DIALOG_TITLE_HEIGHT};
+	Size txtSize = ctx->getTextSize(title, 2);
+	Point titleLoc = {(ctx->width - txtSize.w) / 2, 4};
+
+	ctx->fillRect(titleRect, BLACK);
+	ctx->drawText(title, 2, titleLoc, titleColor);
+	delete[] title;
+
+	ctx->fillRect({0,titleRect.h, ctx->width, ctx->height - titleRect.h}, BLACK);
+
+	//"J1: puntuación" y "J2: puntuación", cada una en el color de su serpiente
+	Rect scoreRect = {0, titleLoc.y + txtSize.h + 6, ctx->width, 10};
+	for (byte s = 0; s < 2; s++){
+		char text[sizeof(STR_VERSUS_P1) + 11];
+		strcpy_P(text, s == 0 ? STR_VERSUS_P1 : STR_VERSUS_P2);
+		append_number(text + strlen(text), scores[s]);
+		ctx->drawText(text, 1, CENTER(scoreRect, ctx->getTextSize(text, 1)), snakeColor(s));
+		scoreRect.y += scoreRect.h + 2;
+	}
+
+	delay(500);
+
+	this->ListScreen::onInit();
+}
+
+void VersusEndScreen::render() {
+	this->ListScreen::render();
+	if (ctx->game->input->start){
+		switch(chosenItem){
+		case 0:
+			ctx->game->initScreen(new GameScreen(ctx, TwoPlayers));
+			break;
+		case 1:
+			ctx->game->initScreen(new MainMenuScreen(ctx));
+			break;
+		}
+	}
+}
+
+void VersusEndScreen::onEnd() {}
+#endif
@@ -32,32 +32,35 @@
 
 #include "snake.hpp"
 #include "types.hpp"
+#include "replay.hpp"
+#include "autopilot.hpp"
+#include "reach.hpp"
+#include "board.hpp"
+#include "geometry.hpp"
+#include "settings.hpp"
+#include "levels.hpp"
+#include "budget.hpp"
 
 class Context; 
 class Game;
 
 /*
- * Representa un elemento de una pantalla que soporte la renderización de listas.
+ * Representa un elemento seleccionable de un menú. Los menús son tablas constantes
+ * guardadas en la memoria flash (PROGMEM), cuya posición se calcula al compilar:
+ * text es una cadena de la flash, y left, right, up y down, el índice del elemento
+ * al que se pasa al mover el control en cada dirección (-1 si no hay ninguno).
  */
-class ListItem {
-public:
-	~ListItem();
-	static ListItem* createAt(Context* ctx, char* text, char textSize, Point pochar, char left, char right, char up, char down, bool stroke = true);
-	static ListItem* create(Context* ctx, char* text, char textSize, Rect rect, char left, char right, char up, char down, bool stroke = true);
-	char* text;
+typedef struct {
+	const char* text;
 	Rect rect;
-	Point txtPos;
-	Context* ctx;
 	char left;
 	char right;
 	char up;
 	char down;
-	char textSize;
-	bool stroke;
-	void render(ListItemState state);
-private:
-	ListItem(Context* ctx, char* text, Rect rect, Point txtPos, char left, char right, char up, char down, char textSize, bool stroke);
-};
+} MenuItem;
+
+//Longitud máxima del texto de un elemento de un menú (una línea de la pantalla)
+#define MENU_TEXT_LENGTH (TFT_WIDTH / 6 + 1)
 
 /*
  * Superclase que representa una pantalla o fase dentro del programa.
@@ -71,6 +74,12 @@ public:
 	virtual ~Screen();
 	virtual void onInit();
 	virtual void onEnd();
+	/*
+	 * Atiende los eventos de la pantalla. Game solo la llama cuando cambian los
+	 * controles o cuando vence el temporizador que la pantalla haya programado
+	 * con Game::wakeAt o Game::wakeAfter, así que las pantallas que se animan
+	 * solas deben volver a programarlo en cada llamada.
+	 */
 	virtual void render();
 	Context* getContext();
 protected:
@@ -84,19 +93,25 @@ protected:
  */
 class ListScreen : public Screen {
 public:
-	ListScreen(Context* ctx);
-	~ListScreen();
+	ListScreen(Context* ctx, const MenuItem* menu = null, byte itemCount = 0);
 	void moveListCursor(Direction dir, bool startButtonPressed);
-	void buildItemMatrix();
 	void onInit();
 	void onEnd();
 	void render();
-	void deleteItems();
+	//Cambia el menú de la pantalla (sin volver a dibujarlo)
+	void setMenu(const MenuItem* menu, byte itemCount);
+	void renderItem(byte index, ListItemState state);
+	Rect itemRect(byte index);
 protected:
-	ListItem** items;
+	//Escribe en buffer el texto del elemento; por defecto, el de la tabla
+	virtual void itemText(byte index, const MenuItem* item, char* buffer);
+	//Los elementos deshabilitados se dibujan en gris y no se pueden seleccionar
+	virtual bool itemEnabled(byte index);
+
+	const MenuItem* menu;
+	byte itemCount;
 	int defaultItem = 0;
 	bool itemPressed = false;
-	int itemCount;
 	int chosenItem = 0;
 };
 
@@ -126,6 +141,11 @@ public:
 	void onInit();
 	void onEnd();
 	void render();
+protected:
+	bool itemEnabled(byte index);
+private:
+	//El último instante en el que se tocó algún control
+	unsigned long lastActivity;
 };
 /*
  * Clase derivada de la clase ListScreen capaz de renderizar una pantalla que
@@ -154,6 +174,31 @@ public:
 };
 #endif
 
+/*
+ * Clase derivada de la clase ListScreen que permite elegir el tamaño de los
+ * bloques y el número de columnas y filas del tablero, mostrando la memoria
+ * que necesitan. Los valores se cambian moviendo el control a izquierda y derecha.
+ */
+#ifdef BOARD_SETTINGS
+class BoardSettingsScreen : public ListScreen {
+public:
+	BoardSettingsScreen(Context* ctx);
+	void onInit();
+	void onEnd();
+	void render();
+protected:
+	void itemText(byte index, const MenuItem* item, char* buffer);
+private:
+	BoardSettings settings;
+
+	void changeValue(byte row, int delta);
+	Rect ramRect();
+	void renderRam();
+	//Indica si el tablero elegido cabe en la memoria libre
+	bool fits();
+};
+#endif
+
 /*
  * Clase derivada de la clase ListScreen capaz de renderizar un mensaje
  * de confirmación que aparecerá justo antes de tratar de borrar la
@@ -167,6 +212,32 @@ public:
 	void render();
 };
 
+/*
+ * Clase derivada de la clase ListScreen que muestra las estadísticas de juego
+ * guardadas en la EEPROM (véase stats.hpp): varios promedios y un pequeño
+ * gráfico de barras por cada histograma.
+ */
+class StatsScreen : public ListScreen {
+public:
+	StatsScreen(Context* ctx);
+	void onInit();
+	void onEnd();
+	void render();
+private:
+	void renderHistogram(const byte* buckets, const char* label, Rect area);
+};
+
+/*
+ * Geometría del tablero de juego. Con BOARD_SETTINGS se elige en la pantalla de
+ * ajustes; si no, se usan bloques de 8 píxeles en toda la pantalla, dejando
+ * 12 píxeles en la parte superior para mostrar la puntuación.
+ */
+#ifdef BOARD_SETTINGS
+typedef RuntimeGeometry GameGeometry;
+#else
+typedef StaticGeometry<TFT_WIDTH, TFT_HEIGHT, BOARD_DEFAULT_BLOCK_SIZE, BOARD_TOP_MARGIN> GameGeometry;
+#endif
+
 /*
  * Clase derivada de Screen que controla la dinámica del juego en sí.
  */
@@ -174,69 +245,103 @@ class PauseScreen;
 
 class GameScreen : public Screen {
 public:
-	GameScreen(Context* ctx);
+	GameScreen(Context* ctx, GameMode mode = Playing, bool restore = false);
 	~GameScreen();
 	void onInit();
 	void onEnd();
 	void render();
 	void fullRender(bool clean = true, bool drawBorder = true, bool drawSnake = true);
+	void repaintRegion(Rect region);
+	void renderScoreBar();
 	void renderScoreValue();
-	void regenCoin();
+	void renderWalls();
+	void updateCoinPos();
+	void animateCrash(BufferedQueue<Cell>* blocks);
 	void callGameOver(bool win);
+#ifdef TWO_PLAYERS
+	void callVersusOver(const StepResult* results);
+#endif
 	void pauseGame();
 	void resumeGame();
-
-	int matrixIndexAtCoord(int x, int y);
-	Point pointForMatrixIndex(int index);
-	Rect rectForMatrixIndex(int index);
-
-	//InGameItemType getItemAtCoord(int x, int y);
-	//void setItemAtCoord(int x, int y, InGameItemType t);
-
-	//Constantes
-	const int blockSize = 8;
-	const int coinSize = blockSize - 2;
-	const int minMovementDelay = 50;
-	const int maxMovementDelay = 500;
-	const float movementDelta = -10.0f;
+	unsigned int stepDelay();
+#ifdef ASSIST_MODE
+	void updateAssist(bool tint);
+	void renderAssist(Cell from, Cell to);
+#endif
+#ifdef SMOOTH_MOVEMENT
+	void beginSmooth();
+	int smoothDepth();
+	void renderSmooth(int depth);
+#endif
 
 	//Tiempo (multiusos :P)
 	unsigned long lastMillis = 0;
 
 	//Área de juego
+	GameGeometry geometry;
 	Rect gameRect;
-	int horizontalBlockCount;
-	int verticalBlockCount;
-	int totalBlockCount;
 
-	InGameItemType* itemMatrix;
+	//Reglas y estado de la partida
+	Board* board;
+	//El nivel de la partida (véase levels.hpp)
+	byte level = 0;
+	//Si la serpiente atraviesa los bordes del tablero
+	bool wrap = false;
 
 	//Inicio del juego
 	int countdown = 3;
-	Rect countdownRect;
+	Rect countdownRect = {0, 0, 0, 0};
 
 	//Pausa
 	PauseScreen* pauseScreen = null;
 
+	//Presupuesto de tiempo de los pasos (véase budget.hpp), el trabajo del paso
+	//actual, en microsegundos, y si falta dibujar el marcador
+	FrameBudget budget;
+	unsigned long stepWork = 0;
+	bool scoreDirty = false;
+
 	//Moneda
 	Rect coinPos;
 	bool coinVisible = false;
 	unsigned long coinLastTilt = 0;
 
-	//Serpiente
-	Direction nextDir = Right;
-	Direction lastDir = Right;
-	BufferedQueue<int>* snakeBlocks;
-
-	float movementDelay = maxMovementDelay;
-
-	//Puntuación
-	unsigned long score = 0;
-	Rect scoreRenderRect;
+	//Serpientes (la segunda solo en el modo de dos jugadores)
+	Direction nextDir[BOARD_MAX_SNAKES] = {Right, Left};
+
+	//Puntuación de cada serpiente
+	Rect scoreRenderRect[BOARD_MAX_SNAKES];
+
+	//Datos de la partida para la tabla de puntuaciones
+	unsigned long seed;
+	unsigned long playTime = 0;
+
+	//Modo de juego y repetición
+	GameMode mode;
+	//Si la partida continúa la guardada en la EEPROM al pausar (véase snapshot.hpp)
+	bool restore;
+	ReplayPlayer* player = null;
+	Autopilot* pilot = null;
+
+#ifdef ASSIST_MODE
+	//Modo de ayuda: el núcleo de alcanzabilidad, las celdas teñidas (un bit por
+	//celda) y la celda marcada como peligrosa (-1 => ninguna)
+	Reachability* assist = null;
+	byte* assistTint = null;
+	int assistWarning = -1;
+#endif
+#ifdef SMOOTH_MOVEMENT
+	//Movimiento suave: píxeles ya dibujados de las cabezas y las colas del último
+	//paso, y las colas que se están borrando y la dirección en la que salen
+	int smoothDrawn = 0;
+	Cell smoothTails[BOARD_MAX_SNAKES];
+	Direction smoothTailDirs[BOARD_MAX_SNAKES];
+	byte smoothTailCount = 0;
+#endif
 };
 /*
- * Clase derivada de ListScreen que controla la pantalla de pausa
- * durante el juego.
+ * Clase derivada de ListScreen que controla la ventana de pausa, que se
+ * dibuja sobre el tablero durante el juego.
  */
 class PauseScreen : public ListScreen {
 public:
@@ -247,7 +352,9 @@ public:
 
 	bool confirm = false;
 
-	void initScreen(char* title, char* button1, char* button2);
+	void initScreen(const char* title, const MenuItem* menu);
+	//El rectángulo de la ventana, que el juego repinta al reanudar la partida
+	Rect windowRect();
 
 private:
 	float ledPower = 0.0f;
@@ -261,13 +368,33 @@ private:
  */
 class GameEndScreen : public ListScreen {
 public:
-	GameEndScreen(Context* ctx, bool win, unsigned long score);
+	GameEndScreen(Context* ctx, bool win, unsigned long score, byte rank);
 	void onInit();
 	void onEnd();
 	void render();
 private:
 	bool win;
 	unsigned long score;
+	//La posición obtenida en la tabla de puntuaciones
+	byte rank;
+};
+
+/*
+ * Clase derivada de ListScreen que muestra el resultado de una partida de
+ * dos jugadores y permite jugar la revancha.
+ */
+#ifdef TWO_PLAYERS
+class VersusEndScreen : public ListScreen {
+public:
+	//winner es el jugador que ha ganado (0 o 1), o -1 si hay empate
+	VersusEndScreen(Context* ctx, char winner, unsigned long score1, unsigned long score2);
+	void onInit();
+	void onEnd();
+	void render();
+private:
+	char winner;
+	unsigned long scores[2];
 };
+#endif
 
 #endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de los ajustes del tablero de juego.
+ */
+
+#include "settings.hpp"
+#include "storage.hpp"
+#include "board.hpp"
+
+//Valor del primer byte cuando los ajustes están presentes en la EEPROM
+#define BOARD_SETTINGS_FORMAT 0xB3
+
+void BoardSettings::load(unsigned int offset, int screenWidth, int screenHeight){
+	this->offset = offset;
+	this->screenWidth = screenWidth;
+	this->screenHeight = screenHeight;
+
+	for (byte i = 0; i < BOARD_SETTINGS_EEPROM_SIZE; i++){
+		data[i] = eeprom_read_byte_safe(offset + i);
+	}
+	blockSize = data[1];
+	columns = data[2];
+	rows = data[3];
+	level = data[4];
+	wrap = data[5] == 1;
+
+	if (data[0] != BOARD_SETTINGS_FORMAT || blockSize < BOARD_MIN_BLOCK_SIZE || blockSize > BOARD_MAX_BLOCK_SIZE
+			|| columns < BOARD_MIN_COLUMNS || columns > maxColumns() || rows < BOARD_MIN_ROWS || rows > maxRows() || level > LEVEL_COUNT || data[5] > 1){
+		setBlockSize(BOARD_DEFAULT_BLOCK_SIZE);
+		level = 0;
+		wrap = false;
+	}
+}
+
+void BoardSettings::save(){
+	data[0] = BOARD_SETTINGS_FORMAT;
+	data[1] = blockSize;
+	data[2] = columns;
+	data[3] = rows;
+	data[4] = level;
+	data[5] = wrap;
+	eeprom_queue_write(offset, data, BOARD_SETTINGS_EEPROM_SIZE);
+}
+
+bool BoardSettings::sameBoard(BoardSettings* other){
+	return blockSize == other->blockSize && columns == other->columns && rows == other->rows
+			&& level == other->level && wrap == other->wrap;
+}
+
+void BoardSettings::setBlockSize(byte blockSize){
+	this->blockSize = blockSize;
+	columns = maxColumns();
+	rows = maxRows();
+}
+
+int BoardSettings::maxColumns(){
+	int max = RuntimeGeometry::maxColumns(screenWidth, blockSize);
+	return max > 255 ? 255 : max;
+}
+
+int BoardSettings::maxRows(){
+	int max = RuntimeGeometry::maxRows(screenHeight, BOARD_TOP_MARGIN, blockSize);
+	return max > 255 ? 255 : max;
+}
+
+unsigned int BoardSettings::ramNeeded(){
+	return Board::ramNeeded((unsigned int)columns * rows, 1);
+}
+
+void BoardSettings::apply(RuntimeGeometry* geometry){
+	geometry->init(screenWidth, screenHeight, BOARD_TOP_MARGIN, blockSize, columns, rows);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de los ajustes del tablero de juego (el
+ * tamaño de los bloques, el número de columnas y filas, el nivel y si la serpiente
+ * atraviesa los bordes), que se eligen en la
+ * pantalla de ajustes y se guardan en la EEPROM.
+ */
+
+#ifndef settings_hpp
+#define settings_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "geometry.hpp"
+#include "levels.hpp"
+
+//El tamaño de los ajustes en la EEPROM (formato + bloque + columnas + filas + nivel + sin bordes)
+#define BOARD_SETTINGS_EEPROM_SIZE 6
+
+//Los límites del tamaño de bloque, en píxeles, y su incremento en la pantalla de ajustes
+#define BOARD_MIN_BLOCK_SIZE 4
+#define BOARD_MAX_BLOCK_SIZE 32
+#define BOARD_BLOCK_SIZE_STEP 2
+#define BOARD_DEFAULT_BLOCK_SIZE 8
+
+//El tablero más pequeño permitido (la serpiente empieza ocupando 3 columnas)
+#define BOARD_MIN_COLUMNS 4
+#define BOARD_MIN_ROWS 2
+
+//Los píxeles de la parte superior de la pantalla reservados para la puntuación
+#define BOARD_TOP_MARGIN 12
+
+class BoardSettings {
+public:
+	byte blockSize;
+	byte columns;
+	byte rows;
+	//El nivel (mapa de muros) de las partidas; 0 => sin muros
+	byte level;
+	//Si es true, la serpiente que sale por un borde reaparece por el opuesto
+	bool wrap;
+
+	/*
+	 * Carga los ajustes de la EEPROM. Si no existen o no caben en una pantalla
+	 * del tamaño especificado, se utiliza el tamaño de bloque por defecto con
+	 * el tablero ocupando toda la pantalla.
+	 */
+	void load(unsigned int offset, int screenWidth, int screenHeight);
+	void save();
+	//Indica si los ajustes producen el mismo tablero que los especificados
+	bool sameBoard(BoardSettings* other);
+
+	//Cambia el tamaño de bloque y ajusta el tablero a toda la pantalla
+	void setBlockSize(byte blockSize);
+	int maxColumns();
+	int maxRows();
+
+	/*
+	 * La memoria, en bytes, que necesita el tablero con estos ajustes: la matriz
+	 * de objetos (1 byte por celda) y la cola de la serpiente (una Cell por celda).
+	 */
+	unsigned int ramNeeded();
+
+	void apply(RuntimeGeometry* geometry);
+private:
+	unsigned int offset;
+	int screenWidth;
+	int screenHeight;
+	//Copia de los datos guardados, leída por la cola de escritura de la EEPROM
+	byte data[BOARD_SETTINGS_EEPROM_SIZE];
+};
+
+#endif
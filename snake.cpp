@@ -25,6 +25,42 @@
 
 #include "snake.hpp"
 
+//Distribución de los datos en la EEPROM
+#define EEPROM_CALIBRATION_OFFSET (EEPROM_SAVE_OFFSET)
+#define EEPROM_HIGHSCORES_OFFSET (EEPROM_SAVE_OFFSET + 5)
+#define EEPROM_REPLAY_OFFSET (EEPROM_HIGHSCORES_OFFSET + HIGHSCORE_EEPROM_SIZE)
+#define EEPROM_SETTINGS_OFFSET (EEPROM_REPLAY_OFFSET + REPLAY_EEPROM_SIZE)
+#define EEPROM_SNAPSHOT_OFFSET (EEPROM_SETTINGS_OFFSET + BOARD_SETTINGS_EEPROM_SIZE)
+#define EEPROM_STATS_OFFSET (EEPROM_SNAPSHOT_OFFSET + SNAPSHOT_EEPROM_SIZE)
+
+//Las direcciones de la EEPROM dan la vuelta al pasar del final: si los datos no
+//cupieran, las estadísticas sobrescribirían la calibración y las puntuaciones
+static_assert(EEPROM_STATS_OFFSET + GAME_STATS_EEPROM_SIZE <= E2END + 1, "The saved data does not fit in the EEPROM");
+
+//Coste de dibujo (véase DRAW_STATS)
+#ifdef DRAW_STATS
+#define DRAW_COST(p, px, st) {stats.primitives += (p); stats.pixels += (px); stats.stateChanges += (st);}
+
+//Píxeles del área y del borde de un rectángulo
+static unsigned long rect_area(Rect rect){
+	if (rect.w <= 0 || rect.h <= 0) return 0;
+	return (unsigned long)rect.w * rect.h;
+}
+static unsigned long rect_outline(Rect rect){
+	if (rect.w <= 0 || rect.h <= 0) return 0;
+	return 2UL * (rect.w + rect.h) - 4;
+}
+#else
+#define DRAW_COST(p, px, st)
+#endif
+
+//Flujo para espectadores (véase SPECTATOR_STREAM)
+#ifdef SPECTATOR_STREAM
+#define SPECTATE(call) spectator.call
+#else
+#define SPECTATE(call)
+#endif
+
 //Context
 Context::Context(Game* game, TFT* scr, int w, int h) {
 	this->game = game;
@@ -37,40 +73,137 @@ Context::Context(Game* game, TFT* scr, int w, int h) {
 
 void Context::clear(Color c) {
 	screen->background(c.r, c.g, c.b);
+	DRAW_COST(1, (unsigned long)width * height, 0);
+	SPECTATE(clear(c));
 }
 
-void Context::drawText(char* text, int size, Point p, Color color) {
+void Context::drawText(char* text, int size, Point p, Color color, Color background) {
+	uint16_t fore = screen->newColor(color.r, color.g, color.b);
+	uint16_t back = screen->newColor(background.r, background.g, background.b);
+	if (drawGlyphs(text, size, p, fore, back)){
+		SPECTATE(text(text, size, p, color, &background));
+		return;
+	}
+
 	screen->stroke(color.r, color.g, color.b);
 	screen->textSize(size);
 	screen->text(text, p.x, p.y);
+	DRAW_COST(1, strlen(text) * 48UL * size * size, 2);
+	SPECTATE(text(text, size, p, color, null));
 }
 
-void Context::drawLines(char** lines, int count, int size, Point p, Color color) {
-	screen->stroke(color.r, color.g, color.b);
-	screen->textSize(size);
+void Context::drawLines(char** lines, int count, int size, Point p, Color color, Color background) {
 	int y = p.y;
 	for (int i = 0; i < count; i++){
-		screen->text(lines[i], p.x, y);
+		drawText(lines[i], size, {p.x, y}, color, background);
 		y += 10 * size + size;
 	}
 }
 
+/*
+ * Dibuja el texto con la fuente de font.hpp: cada carácter abre una ventana en
+ * la pantalla y le envía seguidas todas sus filas, ya escaladas, en lugar de
+ * dibujar un rectángulo por cada píxel encendido como hace la librería. Por eso
+ * el texto es opaco. Avanza FONT_ADVANCE * size píxeles por carácter, como
+ * getTextSize(); la columna de separación no se dibuja.
+ *
+ * Devuelve false, sin dibujar nada, si el texto no cabe entero en la pantalla
+ * (la librería lo parte en varias líneas).
+ */
+bool Context::drawGlyphs(const char* text, int size, Point p, uint16_t fore, uint16_t back){
+	int length = strlen(text);
+	if (length == 0 || p.x < 0 || p.y < 0
+			|| p.x + length * FONT_ADVANCE * size - size > width
+			|| p.y + FONT_GLYPH_HEIGHT * size > height){
+		return false;
+	}
+
+	int x = p.x;
+	byte columns[FONT_GLYPH_WIDTH];
+	for (const char* c = text; *c != 0; c++){
+		memcpy_P(columns, font_glyph(*c), FONT_GLYPH_WIDTH);
+		screen->setAddrWindow(x, p.y, x + FONT_GLYPH_WIDTH * size - 1, p.y + FONT_GLYPH_HEIGHT * size - 1);
+		for (byte row = 0; row < FONT_GLYPH_HEIGHT; row++){
+			byte mask = 1 << row;
+			for (int sy = 0; sy < size; sy++){
+				for (byte col = 0; col < FONT_GLYPH_WIDTH; col++){
+					uint16_t color = (columns[col] & mask) ? fore : back;
+					for (int sx = 0; sx < size; sx++){
+						screen->pushColor(color);
+					}
+				}
+			}
+		}
+		x += FONT_ADVANCE * size;
+	}
+	DRAW_COST(length, (unsigned long)length * FONT_GLYPH_WIDTH * FONT_GLYPH_HEIGHT * size * size, 0);
+	return true;
+}
+
 void Context::drawRect(Rect rect, Color color){
 	screen->stroke(color.r, color.g, color.b);
 	screen->noFill();
 	screen->rect(rect.x,rect.y,rect.w,rect.h);
+	DRAW_COST(1, rect_outline(rect), 2);
+	SPECTATE(outline(rect, color));
 }
 
 void Context::fillRect(Rect rect, Color color){
 	screen->noStroke();
 	screen->fill(color.r,color.g,color.b);
 	screen->rect(rect.x,rect.y,rect.w,rect.h);
+	DRAW_COST(1, rect_area(rect), 2);
+	SPECTATE(fill(rect, color));
+}
+
+void Context::fillRects(const Rect* rects, int count, Color color){
+	screen->noStroke();
+	screen->fill(color.r,color.g,color.b);
+	DRAW_COST(0, 0, 2);
+	for (int i = 0; i < count; i++){
+		screen->rect(rects[i].x,rects[i].y,rects[i].w,rects[i].h);
+		DRAW_COST(1, rect_area(rects[i]), 0);
+		SPECTATE(fill(rects[i], color));
+	}
+}
+
+Rect Context::sliverRect(Rect rect, Direction dir, int from, int to){
+	switch (dir){
+	case Right:
+		return {rect.x + from, rect.y, to - from, rect.h};
+	case Left:
+		return {rect.x + rect.w - to, rect.y, to - from, rect.h};
+	case Down:
+		return {rect.x, rect.y + from, rect.w, to - from};
+	case Up:
+		return {rect.x, rect.y + rect.h - to, rect.w, to - from};
+	default:
+		return rect;
+	}
+}
+
+void Context::fillSliver(Rect rect, Direction dir, int from, int to, Color color){
+	fillRect(sliverRect(rect, dir, from, to), color);
+}
+
+void Context::fillSlivers(const Rect* rects, const Direction* dirs, int count, int from, int to, Color color){
+	screen->noStroke();
+	screen->fill(color.r,color.g,color.b);
+	DRAW_COST(0, 0, 2);
+	for (int i = 0; i < count; i++){
+		Rect sliver = sliverRect(rects[i], dirs[i], from, to);
+		screen->rect(sliver.x,sliver.y,sliver.w,sliver.h);
+		DRAW_COST(1, rect_area(sliver), 0);
+		SPECTATE(fill(sliver, color));
+	}
 }
 
 void Context::fillRect(Rect rect, Color stroke, Color fill){
 	screen->stroke(stroke.r, stroke.g, stroke.b);
 	screen->fill(fill.r,fill.g,fill.b);
 	screen->rect(rect.x,rect.y,rect.w,rect.h);
+	DRAW_COST(1, rect_area(rect) + rect_outline(rect), 2);
+	SPECTATE(framed(rect, stroke, fill));
 }
 
 int Context::getNumberLength(long long n){
@@ -90,32 +223,13 @@ Size Context::getTextSize(char* text, int size) {
 	return this->getTextSize(strlen(text), size);
 }
 
-//Game
-//Algunas funciones útiles para la EEPROM
-int eeprom_read_int(int offset){
-	return ((int)EEPROM.read(offset)) << 8 | EEPROM.read(offset + 1);
-}
-long eeprom_read_long(int offset){
-	long l = 0;
-	for (int i = 0; i < 4; i++){
-		l <<= 8;
-		l |= EEPROM.read(offset + i);
-	}
-	return l;
-}
-void eeprom_write_int(int offset, int value){
-	byte mostSignificantBits = (value >> 8);
-	byte leastSignificantBits = (value & 0xFF);
-	EEPROM.write(offset, mostSignificantBits);
-	EEPROM.write(offset + 1, leastSignificantBits);
-}
-void eeprom_write_long(int offset, long value){
-	EEPROM.write(offset, value >> 24);
-	EEPROM.write(offset + 1, (value >> 16) & 0xFF);
-	EEPROM.write(offset + 2, (value >> 8) & 0xFF);
-	EEPROM.write(offset + 3, (value) & 0xFF);
+#ifdef DRAW_STATS
+void Context::resetStats(){
+	stats = {0, 0, 0};
 }
+#endif
 
+//Game
 void Game::init(){
 #ifdef ARDUINO_AVR_ESPLORA
 	randomSeed(Esplora.readAccelerometer(X_AXIS) ^ Esplora.readAccelerometer(Y_AXIS) ^ Esplora.readAccelerometer(Z_AXIS) ^ Esplora.readLightSensor() ^ Esplora.readJoystickSwitch());
@@ -124,39 +238,50 @@ void Game::init(){
 	randomSeed(analogRead(RANDOM_ANALOG_PIN));
 	context = new Context(this, new TFT(TFT_LCD, TFT_DC, TFT_RST), TFT_WIDTH, TFT_HEIGHT);
 #endif
-	input = new Input();
+	for (byte p = 0; p < PLAYER_COUNT; p++){
+		inputs[p] = new Input();
+	}
+	input = inputs[0];
 
-#ifndef ARDUINO_AVR_ESPLORA
-#ifdef USE_JOYSTICK
-	pinMode(X_AXIS_INPUT, INPUT);
-	pinMode(Y_AXIS_INPUT, INPUT);
-#else
-	pinMode(BUTTON_LEFT_PIN, INPUT);
-	pinMode(BUTTON_RIGHT_PIN, INPUT);
-	pinMode(BUTTON_UP_PIN, INPUT);
-	pinMode(BUTTON_DOWN_PIN, INPUT);
-#endif
-	pinMode(BUTTON_START_PIN, INPUT);
+	StartDevice::begin();
+	Player1Device::begin();
+#ifdef TWO_PLAYERS
+	Player2Device::begin();
 #endif
 
-#if defined(BEGIN_SERIAL) || defined(DEBUG_MEMORY)
+#if defined(BEGIN_SERIAL) || defined(DEBUG_MEMORY) || defined(SERIAL_REMOTE) || defined(SPECTATOR_STREAM)
 	Serial.begin(SERIAL_BAUD_RATE);
 #endif
+#ifdef SPECTATOR_STREAM
+	context->spectator.begin(context->width, context->height);
+#endif
 
 	//Cargar datos de la EEPROM
+	for (int i = 0; i < 5; i++){
+		saveData[i] = eeprom_read_byte_safe(EEPROM_CALIBRATION_OFFSET + i);
+	}
 #ifdef EXTERN_JOYSTICK
-	if (EEPROM.read(EEPROM_SAVE_OFFSET) == 1) { //Los datos de calibración están presentes en la EEPROM
-		joyCenterX = eeprom_read_int(EEPROM_SAVE_OFFSET + 1);
-		joyCenterY =  eeprom_read_int(EEPROM_SAVE_OFFSET + 3);
+	if (saveData[0] == 1) { //Los datos de calibración están presentes en la EEPROM
+		joyCenterX = eeprom_read_int(EEPROM_CALIBRATION_OFFSET + 1);
+		joyCenterY =  eeprom_read_int(EEPROM_CALIBRATION_OFFSET + 3);
 	}
 #endif
 
-	if (EEPROM.read(EEPROM_SAVE_OFFSET + 5) == 1){ //La score está presente en la EEPROM
-		maxScore = (unsigned long)eeprom_read_long(EEPROM_SAVE_OFFSET + 6);
-	}else{
-		maxScore = 0;
-	}
+	highScores.load(EEPROM_HIGHSCORES_OFFSET);
+	replay.load(EEPROM_REPLAY_OFFSET);
+#ifdef BOARD_SETTINGS
+	settings.load(EEPROM_SETTINGS_OFFSET, context->width, context->height);
+#endif
+	snapshot.load(EEPROM_SNAPSHOT_OFFSET);
+	stats.load(EEPROM_STATS_OFFSET);
+
+	//El modo de bajo consumo más ligero: los temporizadores y el ADC siguen
+	//funcionando y cualquier interrupción despierta al microcontrolador
+	set_sleep_mode(SLEEP_MODE_IDLE);
 	initScreen(new SplashScreen(context));
+#ifdef SPECTATOR_STREAM
+	context->spectator.frame();
+#endif
 }
 
 #ifdef EXTERN_JOYSTICK
@@ -164,22 +289,20 @@ void Game::calibrate(int centerX, int centerY){
 	joyCenterX = centerX;
 	joyCenterY = centerY;
 
-	EEPROM.write(EEPROM_SAVE_OFFSET, 1); //Establece que los datos de calibración están presentes en la EEPROM
-	eeprom_write_int(EEPROM_SAVE_OFFSET + 1, centerX);
-	eeprom_write_int(EEPROM_SAVE_OFFSET + 3, centerY);
+	saveData[0] = 1; //Establece que los datos de calibración están presentes en la EEPROM
+	pack_int(saveData + 1, centerX);
+	pack_int(saveData + 3, centerY);
+	eeprom_queue_write(EEPROM_CALIBRATION_OFFSET, saveData, 5);
 }
 #endif
 
-void Game::notifyScore(unsigned long score){
-	if (maxScore < score){
-		EEPROM.write(EEPROM_SAVE_OFFSET + 5, 1); //Establece que hay una puntuación guardada en la EEPROM
-		eeprom_write_long(EEPROM_SAVE_OFFSET + 6, score);
-		maxScore = score;
-	}
+byte Game::notifyScore(HighScore* entry){
+	if (entry->score == 0) return HIGHSCORE_COUNT;
+	return highScores.insert(entry);
 }
 void Game::resetMaxScore(){
-	EEPROM.write(EEPROM_SAVE_OFFSET + 5, 0);
-	maxScore = 0;
+	highScores.clear();
+	replay.clear();
 }
 
 void Game::initScreen(Screen* scr) {
@@ -188,32 +311,89 @@ void Game::initScreen(Screen* scr) {
 		delete cscreen;
 	}
 	cscreen = scr;
+	wakePending = false;
 	cscreen->onInit();
 }
 
+void Game::wakeAt(unsigned long when){
+	if (!wakePending || (long)(when - wakeTime) < 0){
+		wakeTime = when;
+		wakePending = true;
+	}
+}
+
+void Game::wakeAfter(unsigned long ms){
+	wakeAt(millis() + ms);
+}
+
+/*
+ * Entrega a la pantalla actual los eventos pendientes: un cambio en los
+ * controles o el vencimiento de su temporizador (los cambios de pantalla se
+ * notifican con onInit y onEnd). Si no hay ninguno, el microcontrolador duerme
+ * hasta la siguiente interrupción (la del reloj de millis() salta cada
+ * milisegundo), en vez de volver a llamar a render() sin motivo.
+ */
 void Game::tick(){
-	readInput();
-	if (cscreen != null){
+	bool inputChanged = false;
+#ifdef SERIAL_REMOTE
+	//Los controles que llegan por el puerto serial se atienden sin esperar
+	if (remote.update()){
+		lastInputPoll = millis() - INPUT_POLL_INTERVAL;
+	}
+#endif
+	if (millis() - lastInputPoll >= INPUT_POLL_INTERVAL){
+		lastInputPoll = millis();
+		inputChanged = readInput();
+	}
+	bool timerDue = wakePending && (long)(millis() - wakeTime) >= 0;
+	if (timerDue){
+		wakePending = false;
+	}
+
+	if ((inputChanged || timerDue) && cscreen != null){
 		cscreen->render();
+#ifdef SPECTATOR_STREAM
+		context->spectator.frame();
+#endif
+	}
+
+	//Las pulsaciones y los cambios de dirección solo se entregan una vez
+	for (byte p = 0; p < PLAYER_COUNT; p++){
+		inputs[p]->start = false;
+		inputs[p]->dir = None;
+	}
+	snapshot.update();
+
+#if defined(BEGIN_SERIAL) && !defined(SERIAL_REMOTE)
+	if (Serial.available() > 0 && Serial.read() == STATS_DUMP_COMMAND){
+		stats.dump();
 	}
+#endif
 
 #ifdef DEBUG_MEMORY
 	if (millis() - lastMemReport > 1000){
 		lastMemReport = millis();
 		Serial.print("Available memory on board (bytes): ");
-		Serial.println(freeRam());
+		Serial.println(free_ram());
+		Serial.print("Dropped EEPROM writes: ");
+		Serial.println(eeprom_queue_dropped());
 	}
 #endif
+
+	if (!inputChanged && !timerDue){
+		sleep_mode();
+	}
 }
 
 
-Input* Game::readInput() {
-#ifdef ARDUINO_AVR_ESPLORA
-	bool btnstate = (Esplora.readJoystickButton() & Esplora.readButton(SWITCH_LEFT) & Esplora.readButton(SWITCH_RIGHT) & Esplora.readButton(SWITCH_UP) & Esplora.readButton(SWITCH_DOWN)) == LOW;
-#else
-	bool btnstate = digitalRead(BUTTON_START_PIN);
-#endif
+/*
+ * Lee los controles de todos los jugadores. Devuelve true si algo ha cambiado
+ * desde la lectura anterior (el botón de start o la dirección de algún jugador).
+ */
+bool Game::readInput() {
+	bool btnstate = StartDevice::read();
 
+	bool changed = input->currentStart != btnstate;
 	input->currentStart = btnstate;
 	if (btnstate) { //Si el botón está presionado
 		if (input->prevstart) {
@@ -231,71 +411,18 @@ Input* Game::readInput() {
 	}
 
 #ifdef USE_JOYSTICK
-#ifdef ARDUINO_AVR_ESPLORA
-	input->rawX = Esplora.readJoystickX();
-	input->rawY = Esplora.readJoystickY();
-#else
-	input->rawX = analogRead(X_AXIS_INPUT);
-	input->rawY = analogRead(Y_AXIS_INPUT);
+	changed |= input_read_direction<Player1Device>(inputs[0], {joyCenterX, joyCenterY});
+#ifdef TWO_PLAYERS
+	//Solo el joystick del primer jugador puede calibrarse
+	changed |= input_read_direction<Player2Device>(inputs[1], {X_AXIS_CENTER, Y_AXIS_CENTER});
 #endif
-	input->x = (input->rawX - joyCenterX) * X_AXIS_LEFT;
-	input->y = (input->rawY - joyCenterY) * Y_AXIS_UP;
-
-	if (input->x > X_AXIS_MAX_VALUE){
-		input->x = X_AXIS_MAX_VALUE;
-	}else if (input->x < -X_AXIS_MAX_VALUE){
-		input->x = -X_AXIS_MAX_VALUE;
-	}
-
-	if (input->y > Y_AXIS_MAX_VALUE){
-		input->y = Y_AXIS_MAX_VALUE;
-	}else if (input->y < -Y_AXIS_MAX_VALUE){
-		input->y = -Y_AXIS_MAX_VALUE;
-	}
-
-	int xabs = abs(input->x);
-	int yabs = abs(input->y);
-	if (xabs > yabs && xabs >= JOY_DETECT_THRESHOLD) {
-		if (input->x > 0) input->currentDir = Right; else input->currentDir = Left;
-	} else if (yabs > xabs && yabs > JOY_DETECT_THRESHOLD) {
-		if (input->y > 0) input->currentDir = Up; else input->currentDir = Down;
-	} else {
-		input->currentDir = None;
-	}
 #else
-	if (digitalRead(BUTTON_LEFT_PIN) == HIGH){
-		input->x = -512;
-		input->y = 0;
-		input->currentDir = Left;
-	}else if (digitalRead(BUTTON_RIGHT_PIN) == HIGH){
-		input->x = 512;
-		input->y = 0;
-		input->currentDir = Right;
-	}else if (digitalRead(BUTTON_UP_PIN) == HIGH){
-		input->x = 0;
-		input->y = 512;
-		input->currentDir = Up;
-	}else if (digitalRead(BUTTON_DOWN_PIN) == HIGH){
-		input->x = 0;
-		input->y = -512;
-		input->currentDir = Down;
-	}else{
-		input->x = 0;
-		input->y = 0;
-		input->currentDir = None;
-	}
-	input->rawX = input->x;
-	input->rawY = input->y;
+	//Los botones no tienen centro
+	changed |= input_read_direction<Player1Device>(inputs[0], {0, 0});
+#ifdef TWO_PLAYERS
+	changed |= input_read_direction<Player2Device>(inputs[1], {0, 0});
+#endif
 #endif
 
-	if (input->lastDir == input->currentDir){
-		input->dir = None;
-	}else{
-		input->dir = input->currentDir;
-		input->lastDir = input->currentDir;
-	}
-
-	return input;
+	return changed;
 }
-
-
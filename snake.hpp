@@ -64,6 +64,30 @@
  */
 //#define BEGIN_SERIAL
 
+/*
+ * Con BEGIN_SERIAL, al recibir este byte por el puerto serial la placa envía
+ * las estadísticas de juego como texto, una por línea (véase stats.hpp).
+ */
+#define STATS_DUMP_COMMAND 'S'
+
+/*
+ * Si está definido, un ordenador controla el juego a través del puerto serial
+ * (véase remote.hpp para el protocolo) en lugar del joystick o los botones, y la
+ * placa le envía un acuse tras cada paso de la partida. Útil para pruebas de
+ * larga duración y de latencia en la placa real. No debe usarse junto con
+ * BEGIN_SERIAL, DEBUG_MEMORY o AUTOPILOT_SOAK, que escriben texto en el puerto.
+ */
+//#define SERIAL_REMOTE
+
+/*
+ * Si está definido, Context envía además por el puerto serial cada primitiva
+ * que dibuja, como un flujo binario compacto (véase spectator.hpp), para que
+ * otros puedan ver la partida en un ordenador con host/spectate.cpp. Ocupa unos
+ * 100 bytes de RAM. No debe usarse junto con BEGIN_SERIAL, SERIAL_REMOTE o
+ * DEBUG_MEMORY, que también escriben en el puerto.
+ */
+//#define SPECTATOR_STREAM
+
 /*
  * Si está definido, el programa enviará cada segundo la cantidad de
  * ram libre en la placa por el puerto serial. Esta opción puede
@@ -73,13 +97,110 @@
  */
 //#define DEBUG_MEMORY
 
-#if defined(BEGIN_SERIAL) || defined(DEBUG_MEMORY)
 /*
- * La velocidad en baudios del puerto serial, solo aplicable si
- * BEGIN_SERIAL o DEBUG_MEMORY están definidos.
+ * Si está definido, el menú principal iniciará una partida controlada por el
+ * piloto automático (modo demostración) tras este número de milisegundos sin
+ * que se toque ningún control. Coméntelo para deshabilitar el modo demostración.
+ */
+#define ATTRACT_MODE_DELAY 20000
+
+/*
+ * Si está definido, las partidas de un jugador muestran el modo de ayuda: las
+ * celdas libres a las que la serpiente ya no puede llegar se tiñen de rojo
+ * oscuro, y la celda a la que va a entrar se marca en rojo si el giro elegido
+ * la encerraría (véase reach.hpp). Solo se activa si cabe en la memoria libre.
+ */
+//#define ASSIST_MODE
+
+/*
+ * Si está definido, la serpiente avanza de forma suave: en vez de saltar un
+ * bloque entero en cada paso, la cabeza y la cola avanzan este número de
+ * píxeles cada vez, repartidos a lo largo del paso, y solo se dibujan las
+ * franjas que cambian (véase Context::fillSliver), por lo que cada paso envía
+ * a la pantalla los mismos píxeles que sin él. Las reglas del juego siguen
+ * moviendo la serpiente de celda en celda.
+ */
+//#define SMOOTH_MOVEMENT 2
+
+/*
+ * Cada cuántos milisegundos se leen los controles. Entre lectura y lectura, si
+ * la pantalla no tiene ningún temporizador pendiente, el microcontrolador duerme
+ * (véase Game::tick). Valores más bajos reducen la latencia de los controles a
+ * costa de dormir menos tiempo.
+ */
+#define INPUT_POLL_INTERVAL 10
+
+/*
+ * Si está definido, las partidas del modo demostración se encadenarán
+ * indefinidamente en lugar de volver al menú. Útil para pruebas de larga
+ * duración. Si BEGIN_SERIAL también está definido, al final de cada partida
+ * se enviará por el puerto serial la puntuación y el tiempo máximo de decisión
+ * del piloto automático.
+ */
+//#define AUTOPILOT_SOAK
+
+/*
+ * Si está definido, el menú principal incluirá una pantalla de ajustes para
+ * elegir el tamaño de los bloques y el número de columnas y filas del tablero,
+ * que se guardan en la EEPROM. Útil para pantallas grandes (320x240, 480x320...).
+ * Si no está definido, el tablero ocupa toda la pantalla con bloques de 8 píxeles
+ * y su geometría se calcula al compilar.
+ *
+ * Está definido por defecto, así que la versión normal usa RuntimeGeometry: el
+ * tamaño del tablero solo se conoce al empezar cada partida, sus medidas se leen
+ * de la memoria en vez de ser constantes, y pasar de píxeles a una celda divide
+ * por una variable. Quien no necesite cambiar el tablero
+ * puede comentarlo para usar StaticGeometry (véase geometry.hpp), en la que
+ * todas las divisiones son por constantes y los tamaños se conocen al compilar.
+ */
+#define BOARD_SETTINGS
+
+/*
+ * Si está definido, el menú principal incluirá partidas de dos jugadores en el
+ * mismo tablero. El segundo jugador necesita su propio joystick o sus propios
+ * botones de dirección (véase "Controles - Segundo jugador"); el botón de start
+ * es compartido. No disponible en la Arduino Esplora.
+ */
+#define TWO_PLAYERS
+
+//NO MODIFICAR ESTA ENTRADA - La Arduino Esplora solo tiene un joystick
+#ifdef ARDUINO_AVR_ESPLORA
+#undef TWO_PLAYERS
+#endif
+
+#ifdef TWO_PLAYERS
+#define PLAYER_COUNT 2
+#else
+#define PLAYER_COUNT 1
+#endif
+
+/*
+ * La memoria, en bytes, que debe quedar libre además de la del tablero para que
+ * se acepte un tamaño de tablero o una partida de dos jugadores (la pila y el
+ * resto de objetos que se crean durante la partida: pausa, repetición, piloto...).
+ */
+#define BOARD_RAM_RESERVE 256
+
+/*
+ * Si está definido, Context contará las primitivas de dibujo, los píxeles que
+ * cubren y los cambios de estado (color, relleno, tamaño del texto) que envía a
+ * la pantalla. Lo utiliza la herramienta host/golden.cpp para detectar cambios
+ * que aumenten el coste de dibujo de cada fotograma.
  */
+//#define DRAW_STATS
+
+#if defined(BEGIN_SERIAL) || defined(DEBUG_MEMORY) || defined(SERIAL_REMOTE) || defined(SPECTATOR_STREAM)
+/*
+ * La velocidad en baudios del puerto serial, solo aplicable si BEGIN_SERIAL,
+ * DEBUG_MEMORY, SERIAL_REMOTE o SPECTATOR_STREAM están definidos. El flujo para
+ * espectadores necesita más velocidad para no retrasar el dibujo.
+ */
+#ifdef SPECTATOR_STREAM
+#define SERIAL_BAUD_RATE 115200
+#else
 #define SERIAL_BAUD_RATE 57600
 #endif
+#endif
 
 //Controles
 #ifdef USE_JOYSTICK
@@ -143,6 +264,23 @@
 #endif
 #endif
 
+/*
+ * Controles - Segundo jugador (solo si TWO_PLAYERS está definido). Utiliza el
+ * mismo tipo de control que el primero; su joystick no se puede calibrar, por lo
+ * que se utilizan X_AXIS_CENTER e Y_AXIS_CENTER.
+ */
+#ifdef TWO_PLAYERS
+#ifdef USE_JOYSTICK
+#define X2_AXIS_INPUT A3
+#define Y2_AXIS_INPUT A4
+#else
+#define BUTTON2_LEFT_PIN 7
+#define BUTTON2_RIGHT_PIN A3
+#define BUTTON2_UP_PIN A4
+#define BUTTON2_DOWN_PIN A5
+#endif
+#endif
+
 //Controles - Botón de start (no aplicable si el sketch corre en una Arduino Esplora)
 #ifndef ARDUINO_AVR_ESPLORA
 #define BUTTON_START_PIN 2
@@ -162,6 +300,10 @@
 #define TFT_LCD 10    	  //Pin LCD
 #define TFT_DC 9          //Pin D/C
 #define TFT_RST 8         //Pin RESET
+#else
+//NO MODIFICAR ESTA ENTRADA - La pantalla de la Arduino Esplora es de 160x128 px
+#define TFT_WIDTH 160
+#define TFT_HEIGHT 128
 #endif
 
 //EEPROM
@@ -213,9 +355,21 @@
 #include "Arduino.h"
 #include "screens.hpp"
 #include "types.hpp"
+#include "storage.hpp"
+#include "highscores.hpp"
+#include "replay.hpp"
+#include "autopilot.hpp"
+#include "settings.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "input.hpp"
+#include "remote.hpp"
+#include "spectator.hpp"
+#include "font.hpp"
 #include <TFT.h>
 #include <EEPROM.h>
 #include <avr/pgmspace.h>
+#include <avr/sleep.h>
 #ifdef ARDUINO_AVR_ESPLORA
 #include <Esplora.h>
 #endif
@@ -230,12 +384,20 @@ const char STR_YES[] PROGMEM = "Zi";
 const char STR_NO[] PROGMEM = "No";
 
 //Strings - Menu
-const char STR_MENU_MAX_SCORE_PREFIX[] PROGMEM = "Puntuacion Max: ";
 const char STR_MENU_PLAY[] PROGMEM = "Jugar";
+const char STR_MENU_CONTINUE[] PROGMEM = "Continuar";
+const char STR_MENU_REPLAY[] PROGMEM = "Ver mejor partida";
+#ifdef TWO_PLAYERS
+const char STR_MENU_VERSUS[] PROGMEM = "2 jugadores";
+#endif
+#ifdef BOARD_SETTINGS
+const char STR_MENU_BOARD[] PROGMEM = "Tablero";
+#endif
 #ifdef USE_JOYSTICK
 const char STR_MENU_CALIBRATE[] PROGMEM = "Calibrar joystick";
 #endif
 const char STR_MENU_RESET_SCORE[] PROGMEM = "Resetear puntuacion";
+const char STR_MENU_STATS[] PROGMEM = "Estadisticas";
 const char STR_MENU_REBOOT[] PROGMEM = "Reiniciar";
 
 //Strings - Reinicio
@@ -249,12 +411,27 @@ const char STR_CALIBRATE_RETURN[] PROGMEM = "Volver";
 //String - Reset Score
 const char STR_RESET_TITLE[] PROGMEM = "Cuidado!";
 const char STR_RESET_L0[] PROGMEM = "Esta operacion eliminara";
-const char STR_RESET_L1[] PROGMEM = "la puntuacion maxima";
-const char STR_RESET_L2[] PROGMEM = "que esta guardada en la";
-const char STR_RESET_L3[] PROGMEM = "memoria de la placa.";
+const char STR_RESET_L1[] PROGMEM = "las puntuaciones y la";
+const char STR_RESET_L2[] PROGMEM = "mejor partida guardadas";
+const char STR_RESET_L3[] PROGMEM = "en la memoria de la placa.";
 const char STR_RESET_L4[] PROGMEM = "";
 const char STR_RESET_L5[] PROGMEM = "Deseas continuar?";
 const char STR_RESET_DONE[] PROGMEM = "Borrado!";
+
+//Strings - Ajustes del tablero
+const char STR_BOARD_NO_FIT[] PROGMEM = "No cabe en la RAM!";
+#ifdef BOARD_SETTINGS
+const char STR_BOARD_TITLE[] PROGMEM = "Tablero";
+const char STR_BOARD_BLOCK[] PROGMEM = "Bloque: ";
+const char STR_BOARD_COLUMNS[] PROGMEM = "Columnas: ";
+const char STR_BOARD_ROWS[] PROGMEM = "Filas: ";
+const char STR_BOARD_LEVEL[] PROGMEM = "Nivel: ";
+const char STR_BOARD_WRAP[] PROGMEM = "Sin bordes: ";
+const char STR_BOARD_RAM[] PROGMEM = "RAM: ";
+const char STR_BOARD_SAVE[] PROGMEM = "Guardar";
+const char STR_BOARD_BACK[] PROGMEM = "Volver";
+#endif
+
 //Strings - Juego
 const char STR_GAME_3[] PROGMEM = "3";
 const char STR_GAME_2[] PROGMEM = "2";
@@ -269,6 +446,31 @@ const char STR_GAME_WIN[] PROGMEM = "Has Ganado!";
 const char STR_GAME_OVER[] PROGMEM = "Game Over";
 const char STR_GAME_RETRY[] PROGMEM = "Reintentar";
 const char STR_GAME_BACK_MENU[] PROGMEM = "Volver al menu";
+#ifdef TWO_PLAYERS
+//Strings - Dos jugadores
+const char STR_VERSUS_P1_WINS[] PROGMEM = "Gana J1!";
+const char STR_VERSUS_P2_WINS[] PROGMEM = "Gana J2!";
+const char STR_VERSUS_DRAW[] PROGMEM = "Empate!";
+const char STR_VERSUS_P1[] PROGMEM = "J1: ";
+const char STR_VERSUS_P2[] PROGMEM = "J2: ";
+const char STR_VERSUS_REMATCH[] PROGMEM = "Revancha";
+#endif
+//Strings - Estadísticas
+const char STR_STATS_GAMES[] PROGMEM = "Partidas: ";
+const char STR_STATS_PER_SESSION[] PROGMEM = "/sesion";
+const char STR_STATS_STEPS[] PROGMEM = "Pasos/partida: ";
+const char STR_STATS_COIN_RATE[] PROGMEM = "Monedas/min: ";
+const char STR_STATS_WALL[] PROGMEM = "Muro: ";
+const char STR_STATS_SELF[] PROGMEM = "  Cuerpo: ";
+const char STR_STATS_WINS[] PROGMEM = "Ganadas: ";
+const char STR_STATS_QUITS[] PROGMEM = "  Salidas: ";
+const char STR_STATS_HIST_STEPS[] PROGMEM = "Pasos";
+const char STR_STATS_HIST_GAP[] PROGMEM = "Hueco";
+const char STR_STATS_HIST_RATE[] PROGMEM = "Ritmo";
+const char STR_STATS_HIST_SPEED[] PROGMEM = "Veloc";
+const char STR_STATS_BACK[] PROGMEM = "Volver";
+//Strings - Tabla de puntuaciones
+const char STR_HIGHSCORES_EMPTY[] PROGMEM = "Sin puntuaciones";
 
 /*
  * Devuelve la cadena cargada en memoria contenida en el puntero
@@ -283,10 +485,38 @@ extern inline char* lstr(const char* ptr){
 	return buffer;
 }
 
+/*
+ * Devuelve la memoria libre, en bytes, entre el heap y la pila. No tiene en
+ * cuenta los huecos que hayan quedado libres dentro del heap. Fuera de los AVR
+ * no se puede calcular de esta manera, así que se supone que sobra memoria.
+ */
+extern inline int free_ram(){
+#ifdef __AVR__
+	extern int __heap_start, *__brkval;
+	int v;
+	return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+#else
+	return 0x7FFF;
+#endif
+}
+
 //Clases
 class Game;
 class Screen;
 
+#ifdef DRAW_STATS
+/*
+ * Coste de dibujo acumulado por Context. Los píxeles son los que cubre cada
+ * primitiva (en el texto, la celda completa de cada carácter), contando dos
+ * veces los que se dibujan encima de otros.
+ */
+typedef struct {
+	unsigned long primitives;
+	unsigned long pixels;
+	unsigned long stateChanges;
+} DrawStats;
+#endif
+
 /*
  * Contiene métodos que funcionan como un "Wrapper" para algunas funciones de la
  * librería de dibujo en las pantallas TFT incluída por Arduino, extendiendo
@@ -304,13 +534,37 @@ public:
 	void clear(Color c);
 	//text
 	int getNumberLength(long long n);
-	void drawText(char* text, int size, Point p, Color color);
-	void drawLines(char** text,int count, int size, Point p, Color color);
+	//El texto se dibuja opaco, sobre el color background
+	void drawText(char* text, int size, Point p, Color color, Color background = BLACK);
+	void drawLines(char** text,int count, int size, Point p, Color color, Color background = BLACK);
 	void drawRect(Rect rect, Color color);
 	void fillRect(Rect rect, Color color);
 	void fillRect(Rect rect, Color stroke, Color fill);
+	//Rellena varios rectángulos del mismo color cambiando el estado una sola vez
+	void fillRects(const Rect* rects, int count, Color color);
+	/*
+	 * Franjas (slivers) para el movimiento suave: la parte de rect entre las
+	 * profundidades from y to, en píxeles, medidas desde el lado por el que se
+	 * entra en rect al moverse en la dirección dir. Dibujar las franjas [0, a),
+	 * [a, b)... hasta el tamaño del bloque rellena el bloque entero, con los
+	 * mismos píxeles que fillRect.
+	 */
+	static Rect sliverRect(Rect rect, Direction dir, int from, int to);
+	void fillSliver(Rect rect, Direction dir, int from, int to, Color color);
+	//Una franja de cada rectángulo, todas del mismo color y a la misma profundidad
+	void fillSlivers(const Rect* rects, const Direction* dirs, int count, int from, int to, Color color);
 	Size getTextSize(int length, int size);
 	Size getTextSize(char* text, int size);
+
+#ifdef DRAW_STATS
+	DrawStats stats = {0, 0, 0};
+	void resetStats();
+#endif
+#ifdef SPECTATOR_STREAM
+	SpectatorStream spectator;
+#endif
+private:
+	bool drawGlyphs(const char* text, int size, Point p, uint16_t fore, uint16_t back);
 };
 
 /*
@@ -319,7 +573,23 @@ public:
  */
 class Game {
 public:
-	unsigned long maxScore = 0;
+	HighScoreTable highScores;
+	ReplayRecorder replay;
+#ifdef BOARD_SETTINGS
+	BoardSettings settings;
+#endif
+	GameSnapshot snapshot;
+	GameStats stats;
+#ifdef SERIAL_REMOTE
+	SerialRemote remote;
+#endif
+
+	/*
+	 * Copia en RAM de los datos de calibración guardados en la EEPROM. La cola
+	 * de escritura lee de aquí los bytes a medida que los escribe, por lo que
+	 * este buffer debe mantenerse mientras haya escrituras pendientes.
+	 */
+	byte saveData[5];
 
 #ifdef USE_JOYSTICK
 	int joyCenterX = X_AXIS_CENTER;
@@ -327,30 +597,42 @@ public:
 #endif
 
 	Screen* cscreen = null;
+	//Los controles de cada jugador (input == inputs[0]). El botón de start solo
+	//se lee en los del primer jugador.
+	Input* inputs[PLAYER_COUNT];
 	Input* input;
 	Context* context;
 
 #ifdef EXTERN_JOYSTICK
 	void calibrate(int centerX, int centerY);
 #endif
-	void notifyScore(unsigned long score);
+	byte notifyScore(HighScore* entry);
 	void resetMaxScore();
 
 	void init();
 	void tick();
 	void (*reset)(void) = 0x0;
 
-	Input* readInput();
+	bool readInput();
 	void initScreen(Screen* screen);
 
-#ifdef DEBUG_MEMORY
+	/*
+	 * Programan un evento de temporizador para la pantalla actual en el instante
+	 * when (según millis()) o dentro de ms milisegundos. Si ya había uno pendiente,
+	 * se mantiene el más próximo. Cambiar de pantalla cancela el evento pendiente.
+	 */
+	void wakeAt(unsigned long when);
+	void wakeAfter(unsigned long ms);
+
 private:
+	//Temporizador de la pantalla actual
+	bool wakePending = false;
+	unsigned long wakeTime;
+	//Última lectura de los controles
+	unsigned long lastInputPoll = 0;
+
+#ifdef DEBUG_MEMORY
 	unsigned long lastMemReport = 0;
-	inline int freeRam () {
-	  extern int __heap_start, *__brkval;
-	  int v;
-	  return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
-	}
 #endif
 };
 
@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la codificación de las partidas guardadas.
+ */
+
+#include "snapshot.hpp"
+#include "storage.hpp"
+
+//Valor del primer byte cuando hay una partida guardada
+#define SNAPSHOT_FORMAT 0xC5
+#define SNAPSHOT_NO_COIN 0xFF
+#define SNAPSHOT_WRAP 0x80
+
+void GameSnapshot::load(unsigned int offset){
+	this->offset = offset;
+	valid = eeprom_read_byte_safe(offset) == SNAPSHOT_FORMAT;
+	for (byte i = 0; i < 3; i++){
+		header[i] = eeprom_read_byte_safe(offset + 1 + i);
+	}
+}
+
+void GameSnapshot::packHeader(byte* dst, byte columns, byte rows, byte level, bool wrap){
+	dst[0] = columns;
+	dst[1] = rows;
+	dst[2] = level | (wrap ? SNAPSHOT_WRAP : 0);
+}
+
+bool GameSnapshot::available(byte columns, byte rows, byte level, bool wrap){
+	byte expected[3];
+	packHeader(expected, columns, rows, level, wrap);
+	return valid && memcmp(header, expected, 3) == 0;
+}
+
+/*
+ * Dirección que lleva de la celda a a la celda b, que deben ser vecinas (también
+ * a través de los bordes en el modo sin bordes).
+ */
+static Direction direction_between(Board* board, Cell a, Cell b){
+	if (a.x == b.x){
+		return b.y == (a.y + 1) % board->verticalCount ? Down : Up;
+	}
+	return b.x == (a.x + 1) % board->horizontalCount ? Right : Left;
+}
+
+bool GameSnapshot::save(Board* board, byte level, unsigned long seed, unsigned long playTime){
+	BufferedQueue<Cell>* blocks = board->snakes[0].blocks;
+	unsigned int length = blocks->size();
+	if (length > SNAPSHOT_MAX_LENGTH){
+		clear();
+		return false;
+	}
+
+	//Los datos anteriores pueden estar escribiéndose todavía, así que la partida
+	//se codifica en un buffer aparte (véase writePending)
+	delete[] pending;
+	pendingSize = SNAPSHOT_HEADER_SIZE + (length + 2) / 4;
+	pending = new byte[pendingSize]();
+	byte* buffer = pending;
+
+	packHeader(buffer + 1, board->horizontalCount, board->verticalCount, level, board->wrap);
+	pack_long(buffer + 4, board->rng.state);
+	pack_long(buffer + 8, seed);
+	pack_long(buffer + 12, board->snakes[0].score);
+	pack_long(buffer + 16, playTime);
+	pack_int(buffer + 20, (int)board->movementDelay);
+	buffer[22] = board->coinIndex == -1 ? SNAPSHOT_NO_COIN : board->coin.x;
+	buffer[23] = board->coinIndex == -1 ? SNAPSHOT_NO_COIN : board->coin.y;
+	Cell tail = *blocks->itemAtHeadOffset(0);
+	buffer[24] = tail.x;
+	buffer[25] = tail.y;
+	pack_int(buffer + 26, length);
+
+	//Desde la cola: la dirección absoluta del primer bloque y después los giros
+	byte* codes = buffer + SNAPSHOT_HEADER_SIZE;
+	Cell prev = tail;
+	Direction prevDir = None;
+	for (unsigned int i = 1; i < length; i++){
+		Cell cell = *blocks->itemAtHeadOffset(i);
+		Direction dir = direction_between(board, prev, cell);
+		byte code = prevDir == None ? dir - Left : direction_relative(prevDir, dir);
+		codes[(i - 1) / 4] |= code << ((i - 1) % 4 * 2);
+		prev = cell;
+		prevDir = dir;
+	}
+
+	memcpy(header, buffer + 1, 3);
+	valid = true;
+	writePending();
+	return true;
+}
+
+/*
+ * Encola la escritura de la partida pendiente cuando la cola ya no necesita los
+ * datos de la anterior.
+ */
+void GameSnapshot::writePending(){
+	if (invalidate){
+		invalidate = !eeprom_queue_write_byte(offset, 0);
+	}
+	if (pending == null) return;
+	if (data != null){
+		if (eeprom_queue_busy()) return;
+		delete[] data;
+		data = null;
+	}
+	//Las tres escrituras deben ir juntas; si no caben, se reintenta en update()
+	if (eeprom_queue_room() < 3) return;
+	data = pending;
+	size = pendingSize;
+	pending = null;
+	eeprom_queue_write_byte(offset, 0);
+	eeprom_queue_write(offset + 1, data + 1, size - 1);
+	eeprom_queue_write_byte(offset, SNAPSHOT_FORMAT);
+}
+
+bool GameSnapshot::restore(Board* board, byte level, unsigned long* seed, unsigned long* playTime){
+	if (!available(board->horizontalCount, board->verticalCount, level, board->wrap)) return false;
+
+	//La partida se puede haber guardado hace un momento: esperar a que se escriba
+	if (data != null || pending != null){
+		eeprom_queue_flush();
+		writePending();
+		eeprom_queue_flush();
+	}
+
+	unsigned int length = eeprom_read_int(offset + 26);
+	Cell tail = {eeprom_read_byte_safe(offset + 24), eeprom_read_byte_safe(offset + 25)};
+	int movementDelay = eeprom_read_int(offset + 20);
+	if (length < 2 || length > SNAPSHOT_MAX_LENGTH || length > (unsigned int)board->openCount
+			|| tail.x >= board->horizontalCount || tail.y >= board->verticalCount
+			|| movementDelay < Board::minMovementDelay || movementDelay > Board::maxMovementDelay){
+		return false;
+	}
+
+	//Colocar la serpiente bloque a bloque, comprobando que no pisa nada
+	board->clearSnake(0);
+	Cell cell = tail;
+	int index = board->indexOf(cell);
+	Direction dir = None;
+	unsigned int codeOffset = offset + SNAPSHOT_HEADER_SIZE;
+	byte codes = 0;
+	for (unsigned int i = 0; i < length; i++){
+		if (i > 0){
+			if ((i - 1) % 4 == 0){
+				codes = eeprom_read_byte_safe(codeOffset++);
+			}
+			byte code = codes & 0x03;
+			codes >>= 2;
+			dir = dir == None ? (Direction)(Left + code) : direction_turn(dir, (Turn)code);
+			if (dir == None || !board->neighbor(dir, &cell, &index)) return false;
+		}
+		if (board->itemMatrix[index] >= SnakeObject) return false;
+		board->growSnake(0, cell, dir);
+	}
+
+	Cell coin = {eeprom_read_byte_safe(offset + 22), eeprom_read_byte_safe(offset + 23)};
+	if (coin.x == SNAPSHOT_NO_COIN){
+		if (board->coinIndex != -1){
+			board->itemMatrix[board->coinIndex] = Empty;
+			board->coinIndex = -1;
+		}
+	}else{
+		if (coin.x >= board->horizontalCount || coin.y >= board->verticalCount
+				|| board->itemMatrix[board->indexOf(coin)] >= SnakeObject){
+			return false;
+		}
+		board->placeCoin(coin);
+	}
+
+	board->rng.state = eeprom_read_long(offset + 4);
+	board->snakes[0].score = eeprom_read_long(offset + 12);
+	board->movementDelay = movementDelay;
+	*seed = eeprom_read_long(offset + 8);
+	*playTime = eeprom_read_long(offset + 16);
+	return true;
+}
+
+void GameSnapshot::clear(){
+	delete[] pending;
+	pending = null;
+	if (!valid) return;
+	valid = false;
+	//Si la cola está llena, se reintenta en update()
+	invalidate = !eeprom_queue_write_byte(offset, 0);
+}
+
+void GameSnapshot::update(){
+	writePending();
+	if (data != null && !eeprom_queue_busy()){
+		delete[] data;
+		data = null;
+	}
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de la clase que guarda la partida en curso
+ * en la EEPROM al pausarla, para poder continuarla después de un corte de
+ * corriente o de un reinicio.
+ *
+ * Formato (SNAPSHOT_HEADER_SIZE bytes de cabecera y los giros de la serpiente):
+ *
+ *   0      formato (SNAPSHOT_FORMAT si la partida guardada es válida)
+ *   1-3    columnas, filas y nivel (el bit 7 indica el modo sin bordes)
+ *   4-7    estado del generador de números aleatorios del tablero
+ *   8-11   semilla de la partida (para la tabla de puntuaciones)
+ *   12-15  puntuación
+ *   16-19  tiempo de juego, en milisegundos
+ *   20-21  retraso entre pasos, en milisegundos
+ *   22-23  celda de la moneda (0xFF, 0xFF si no hay moneda)
+ *   24-25  celda de la cola
+ *   26-27  longitud de la serpiente
+ *   28-    la dirección del primer bloque desde la cola y, para cada bloque
+ *          siguiente, el giro respecto al anterior (véase el enum Turn), todo en
+ *          códigos de 2 bits, 4 por byte
+ *
+ * Así, una serpiente de 200 bloques ocupa 28 + 50 = 78 bytes. Las serpientes que
+ * no caben en SNAPSHOT_EEPROM_SIZE bytes no se guardan.
+ *
+ * La escritura pasa por la cola de la EEPROM (véase storage.hpp), sin bloquear
+ * el juego: primero se invalida el byte de formato, después se escriben los datos
+ * y, por último, se vuelve a escribir el formato, de modo que un corte durante la
+ * escritura nunca deja una partida a medias. Si se guarda otra partida antes de
+ * que termine la escritura anterior, sus datos esperan en un segundo buffer hasta
+ * que la cola los pueda leer.
+ */
+
+#ifndef snapshot_hpp
+#define snapshot_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "board.hpp"
+
+#define SNAPSHOT_HEADER_SIZE 28
+#define SNAPSHOT_EEPROM_SIZE 96
+//Longitud máxima de la serpiente guardada (un código por bloque salvo la cola)
+#define SNAPSHOT_MAX_LENGTH ((SNAPSHOT_EEPROM_SIZE - SNAPSHOT_HEADER_SIZE) * 4 + 1)
+
+/*
+ * La partida guardada en la EEPROM. La instancia pertenece a Game, pues los
+ * datos deben seguir existiendo mientras se escriben tras salir de la partida.
+ */
+class GameSnapshot {
+public:
+	void load(unsigned int offset);
+
+	//Devuelve true si hay una partida guardada para el tablero especificado
+	bool available(byte columns, byte rows, byte level, bool wrap);
+
+	/*
+	 * Guarda el estado de la primera serpiente del tablero. Devuelve false si la
+	 * serpiente es demasiado larga (en ese caso se borra la partida guardada).
+	 */
+	bool save(Board* board, byte level, unsigned long seed, unsigned long playTime);
+
+	/*
+	 * Reconstruye la partida guardada sobre board, que debe acabar de colocarse
+	 * con reset() en el mismo nivel. Devuelve false si los datos no son válidos
+	 * para el tablero; en ese caso el tablero puede quedar a medias.
+	 */
+	bool restore(Board* board, byte level, unsigned long* seed, unsigned long* playTime);
+
+	//Borra la partida guardada
+	void clear();
+
+	//Empieza a escribir la partida pendiente (o su borrado) y libera los datos ya escritos
+	void update();
+private:
+	unsigned int offset;
+	bool valid;
+	//Falta encolar el borrado de la partida guardada (la cola estaba llena)
+	bool invalidate = false;
+	byte header[3];
+	//Los datos que está escribiendo la cola de la EEPROM (null si no hay ninguno)
+	byte* data = null;
+	unsigned int size;
+	//Una partida guardada mientras la anterior se escribía todavía, que espera su turno
+	byte* pending = null;
+	unsigned int pendingSize;
+
+	void packHeader(byte* dst, byte columns, byte rows, byte level, bool wrap);
+	void writePending();
+};
+
+#endif
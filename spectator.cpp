@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación del flujo para espectadores.
+ */
+
+#include "snake.hpp"
+
+#ifdef SPECTATOR_STREAM
+
+void SpectatorStream::begin(int width, int height){
+	this->width = width;
+	this->height = height;
+	coordSize = width > 255 || height > 255 ? 2 : 1;
+	paletteCount = 0;
+	paletteNext = 0;
+	batchCount = 0;
+
+	byte message[SPECTATOR_HELLO_SIZE] = {SPECTATOR_HELLO, 'S', 'N', SPECTATOR_VERSION, coordSize};
+	pack_int(message + 5, width);
+	pack_int(message + 7, height);
+	write(message, SPECTATOR_HELLO_SIZE);
+}
+
+void SpectatorStream::clear(Color color){
+	byte message[1] = {(byte)(SPECTATOR_CLEAR | colorIndex(color))};
+	write(message, 1);
+}
+
+void SpectatorStream::fill(Rect rect, Color color){
+	rect = rect_intersection(rect, {0, 0, width, height});
+	if (rect.w <= 0 || rect.h <= 0) return;
+
+	byte c = colorIndex(color);
+	if (batchCount > 0 && (c != batchColor || batchCount == SPECTATOR_BATCH)){
+		flush();
+	}
+	if (batchCount == 0){
+		batchColor = c;
+		batchSize = 2;
+	}
+	batchSize += putRect(batch + batchSize, rect);
+	batchCount++;
+	dirty = true;
+}
+
+void SpectatorStream::outline(Rect rect, Color color){
+	if (rect.w <= 0 || rect.h <= 0) return;
+	if (!inside(rect)){
+		//Los mismos lados que dibuja TFT::rect
+		fill({rect.x, rect.y, rect.w, 1}, color);
+		fill({rect.x, rect.y + rect.h - 1, rect.w, 1}, color);
+		fill({rect.x, rect.y, 1, rect.h}, color);
+		fill({rect.x + rect.w - 1, rect.y, 1, rect.h}, color);
+		return;
+	}
+	byte message[1 + 4 * 2];
+	message[0] = SPECTATOR_OUTLINE | colorIndex(color);
+	write(message, 1 + putRect(message + 1, rect));
+}
+
+void SpectatorStream::framed(Rect rect, Color stroke, Color fill){
+	if (rect.w <= 0 || rect.h <= 0) return;
+	if (!inside(rect)){
+		this->fill(rect, fill);
+		outline(rect, stroke);
+		return;
+	}
+	byte message[2 + 4 * 2];
+	message[0] = SPECTATOR_FRAMED | colorIndex(fill);
+	message[1] = colorIndex(stroke);
+	write(message, 2 + putRect(message + 2, rect));
+}
+
+void SpectatorStream::text(const char* text, int size, Point p, Color color, const Color* background){
+	int length = strlen(text);
+	long limit = coordSize == 1 ? 0xFF : 0xFFFF;
+	if (length == 0 || length > 0xFF || size < 1 || size > 0x0F
+			|| p.x < 0 || p.y < 0 || p.x > limit || p.y > limit){
+		return;
+	}
+
+	byte message[2 + 2 * 2 + 1];
+	message[0] = SPECTATOR_TEXT | colorIndex(color);
+	message[1] = (background != null ? colorIndex(*background) : SPECTATOR_NO_COLOR) | size << 4;
+	byte n = 2;
+	n += putCoord(message + n, p.x);
+	n += putCoord(message + n, p.y);
+	message[n++] = length;
+	write(message, n);
+	Serial.write((const byte*)text, length);
+	sent += length;
+}
+
+void SpectatorStream::frame(){
+	if (!dirty) return;
+	byte message[1] = {SPECTATOR_FRAME};
+	write(message, 1);
+	dirty = false;
+}
+
+/*
+ * Devuelve el índice del color en la paleta. Si no está, lo añade (o sustituye
+ * la entrada más antigua) y lo envía.
+ */
+byte SpectatorStream::colorIndex(Color color){
+	uint16_t value = ((color.r & 0xF8) << 8) | ((color.g & 0xFC) << 3) | (color.b >> 3);
+	for (byte i = 0; i < paletteCount; i++){
+		if (palette[i] == value) return i;
+	}
+
+	byte i = paletteNext;
+	paletteNext = (paletteNext + 1) % SPECTATOR_PALETTE_SIZE;
+	if (paletteCount < SPECTATOR_PALETTE_SIZE){
+		paletteCount++;
+	}
+	palette[i] = value;
+
+	byte message[3] = {(byte)(SPECTATOR_PALETTE | i), (byte)(value >> 8), (byte)value};
+	write(message, 3);
+	return i;
+}
+
+//Escriben una coordenada o un rectángulo y devuelven los bytes que ocupan
+byte SpectatorStream::putCoord(byte* dst, int value){
+	if (coordSize == 2){
+		*dst++ = value >> 8;
+	}
+	*dst = value;
+	return coordSize;
+}
+
+byte SpectatorStream::putRect(byte* dst, Rect rect){
+	dst += putCoord(dst, rect.x);
+	dst += putCoord(dst, rect.y);
+	dst += putCoord(dst, rect.w);
+	putCoord(dst, rect.h);
+	return 4 * coordSize;
+}
+
+bool SpectatorStream::inside(Rect rect){
+	return rect.x >= 0 && rect.y >= 0 && rect.x + rect.w <= width && rect.y + rect.h <= height;
+}
+
+/*
+ * Envía una orden. Los rellenos pendientes van antes, porque la orden puede
+ * cambiar la paleta o tapar lo que dibujan.
+ */
+void SpectatorStream::write(const byte* data, byte size){
+	flush();
+	Serial.write(data, size);
+	sent += size;
+	dirty = true;
+}
+
+void SpectatorStream::flush(){
+	if (batchCount == 0) return;
+	batch[0] = SPECTATOR_FILL | batchColor;
+	batch[1] = batchCount;
+	Serial.write(batch, batchSize);
+	sent += batchSize;
+	batchCount = 0;
+}
+
+#endif
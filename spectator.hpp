@@ -0,0 +1,122 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene el flujo para espectadores (véase SPECTATOR_STREAM en
+ * snake.hpp): Context envía por el puerto serial cada primitiva que dibuja, de
+ * forma que un ordenador puede reproducir la pantalla (host/spectate.cpp).
+ *
+ * Cada orden empieza con un byte: los 4 bits altos son la orden y los 4 bajos,
+ * en las que llevan color, su índice en la paleta. Las coordenadas ocupan
+ * SpectatorStream::coordSize bytes (1 si la pantalla cabe en 255x255 píxeles, 2
+ * en otro caso, en big endian) y los rectángulos son x, y, w, h.
+ *
+ *   SPECTATOR_HELLO   'S' 'N' versión coordSize ancho(2) alto(2)
+ *     Inicio del flujo. Vacía la paleta. El espectador busca esta secuencia
+ *     para sincronizarse, por lo que puede conectarse en cualquier momento.
+ *   SPECTATOR_PALETTE | i   color(2)
+ *     El color (RGB565, como TFT::newColor) de la entrada i de la paleta.
+ *   SPECTATOR_FILL | c   n   n rectángulos
+ *     Rellena los rectángulos con el color c. Los rellenos seguidos del mismo
+ *     color se agrupan en una sola orden de hasta SPECTATOR_BATCH rectángulos.
+ *   SPECTATOR_OUTLINE | c   rectángulo
+ *     El borde de un rectángulo (Context::drawRect).
+ *   SPECTATOR_FRAMED | c   borde   rectángulo
+ *     Un rectángulo relleno de c con el borde del color de índice borde.
+ *   SPECTATOR_TEXT | c   fondo | tamaño << 4   x   y   n   n caracteres
+ *     Texto del color c. Con la fuente de font.hpp es opaco sobre el color de
+ *     índice fondo; con fondo SPECTATOR_NO_COLOR se ha dibujado con la librería,
+ *     transparente y partido en líneas en el borde derecho.
+ *   SPECTATOR_CLEAR | c
+ *     Toda la pantalla del color c.
+ *   SPECTATOR_FRAME
+ *     Fin de un fotograma: el espectador puede mostrar la pantalla.
+ *
+ * La paleta tiene SPECTATOR_PALETTE_SIZE entradas; al agotarse, se reutilizan
+ * por turno. Las primitivas que se salen de la pantalla se recortan o se
+ * descomponen en rellenos, para no necesitar coordenadas negativas.
+ *
+ * A diferencia de SERIAL_REMOTE, las órdenes no se descartan nunca: si el
+ * buffer de salida está lleno, Serial.write espera, y un puerto lento retrasa
+ * el dibujo como lo haría una pantalla lenta (véase FrameBudget).
+ */
+
+#ifndef spectator_hpp
+#define spectator_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+
+#define SPECTATOR_VERSION 1
+
+#define SPECTATOR_FILL 0x00
+#define SPECTATOR_OUTLINE 0x10
+#define SPECTATOR_FRAMED 0x20
+#define SPECTATOR_TEXT 0x30
+#define SPECTATOR_CLEAR 0x40
+#define SPECTATOR_PALETTE 0x50
+#define SPECTATOR_FRAME 0x60
+#define SPECTATOR_HELLO 0xF0
+#define SPECTATOR_HELLO_SIZE 9
+
+#define SPECTATOR_PALETTE_SIZE 15
+#define SPECTATOR_NO_COLOR 0x0F
+//Rectángulos por orden de relleno
+#define SPECTATOR_BATCH 8
+
+class SpectatorStream {
+public:
+	//Envía la cabecera del flujo. El puerto serial ya debe estar abierto.
+	void begin(int width, int height);
+
+	void clear(Color color);
+	void fill(Rect rect, Color color);
+	void outline(Rect rect, Color color);
+	void framed(Rect rect, Color stroke, Color fill);
+	//background es null si el texto se ha dibujado con la librería
+	void text(const char* text, int size, Point p, Color color, const Color* background);
+	//Fin del fotograma, si se ha dibujado algo desde el anterior
+	void frame();
+
+	byte coordSize = 1;
+	//Bytes enviados desde el inicio
+	unsigned long sent = 0;
+private:
+	byte colorIndex(Color color);
+	byte putCoord(byte* dst, int value);
+	byte putRect(byte* dst, Rect rect);
+	bool inside(Rect rect);
+	void write(const byte* data, byte size);
+	//Envía los rellenos agrupados pendientes
+	void flush();
+
+	int width = 0;
+	int height = 0;
+	uint16_t palette[SPECTATOR_PALETTE_SIZE];
+	byte paletteCount = 0;
+	byte paletteNext = 0;
+	bool dirty = false;
+	//Orden de relleno en construcción: cabecera, número y rectángulos
+	byte batch[2 + SPECTATOR_BATCH * 8];
+	byte batchColor = SPECTATOR_NO_COLOR;
+	byte batchCount = 0;
+	byte batchSize = 0;
+};
+
+#endif
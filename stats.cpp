@@ -0,0 +1,221 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de las estadísticas de juego.
+ */
+
+#include "stats.hpp"
+#include "storage.hpp"
+
+//Valor del primer byte cuando hay estadísticas en la EEPROM
+#define GAME_STATS_FORMAT 0x57
+
+//Posición de cada sección en los datos
+#define STATS_COUNTERS 1
+#define STATS_TOTALS (STATS_COUNTERS + 2 * StatsCounterCount)
+#define STATS_HISTOGRAMS (STATS_TOTALS + 4 * StatsTotalCount)
+
+//El primer límite de los histogramas de cubos crecientes: 16 pasos, 500 ms y
+//1 moneda por minuto (en dieciseisavos)
+#define STATS_FIRST_STEPS 16
+#define STATS_FIRST_COIN_GAP 500
+#define STATS_FIRST_COIN_RATE 16
+
+//Nombres de cada valor en el volcado por el puerto serial
+static const char STATS_NAME_SESSIONS[] PROGMEM = "sessions";
+static const char STATS_NAME_GAMES[] PROGMEM = "games";
+static const char STATS_NAME_WALL[] PROGMEM = "wall_deaths";
+static const char STATS_NAME_SELF[] PROGMEM = "self_deaths";
+static const char STATS_NAME_WINS[] PROGMEM = "wins";
+static const char STATS_NAME_QUITS[] PROGMEM = "quits";
+static const char STATS_NAME_STEPS[] PROGMEM = "steps";
+static const char STATS_NAME_SECONDS[] PROGMEM = "seconds";
+static const char STATS_NAME_COINS[] PROGMEM = "coins";
+static const char STATS_NAME_STEPS_HIST[] PROGMEM = "steps_per_game";
+static const char STATS_NAME_GAP_HIST[] PROGMEM = "coin_gap";
+static const char STATS_NAME_RATE_HIST[] PROGMEM = "coins_per_minute";
+static const char STATS_NAME_SPEED_HIST[] PROGMEM = "death_delay";
+
+static const char* const STATS_COUNTER_NAMES[StatsCounterCount] PROGMEM = {
+	STATS_NAME_SESSIONS, STATS_NAME_GAMES, STATS_NAME_WALL, STATS_NAME_SELF, STATS_NAME_WINS, STATS_NAME_QUITS
+};
+static const char* const STATS_TOTAL_NAMES[StatsTotalCount] PROGMEM = {
+	STATS_NAME_STEPS, STATS_NAME_SECONDS, STATS_NAME_COINS
+};
+static const char* const STATS_HISTOGRAM_NAMES[StatsHistogramCount] PROGMEM = {
+	STATS_NAME_STEPS_HIST, STATS_NAME_GAP_HIST, STATS_NAME_RATE_HIST, STATS_NAME_SPEED_HIST
+};
+
+void GameStats::load(unsigned int offset){
+	this->offset = offset;
+	for (byte i = 0; i < GAME_STATS_EEPROM_SIZE; i++){
+		data[i] = eeprom_read_byte_safe(offset + i);
+	}
+	if (data[0] != GAME_STATS_FORMAT){
+		memset(data, 0, GAME_STATS_EEPROM_SIZE);
+		data[0] = GAME_STATS_FORMAT;
+	}
+}
+
+void GameStats::gameStarted(bool continued, unsigned long playTime){
+	if (sessionGames == 0){
+		addCounter(StatsSessions);
+	}
+	if (!continued){
+		addCounter(StatsGames);
+	}
+	sessionGames++;
+	startTime = lastCoinTime = playTime;
+}
+
+void GameStats::coinEaten(unsigned long playTime){
+	//Cubo b: menos de STATS_FIRST_COIN_GAP << b milisegundos
+	unsigned long gap = (playTime - lastCoinTime) / STATS_FIRST_COIN_GAP;
+	byte bucket = 0;
+	while (gap > 0 && bucket < GAME_STATS_BUCKETS - 1){
+		gap >>= 1;
+		bucket++;
+	}
+	addSample(StatsCoinGap, bucket);
+	lastCoinTime = playTime;
+	addTotal(StatsTotalCoins, 1);
+}
+
+void GameStats::gameEnded(Board* board, GameEnd end, unsigned long playTime){
+	Snake* snake = &board->snakes[0];
+	switch (end){
+	case EndCollision:
+		{
+			//La celda en la que ha intentado entrar la cabeza
+			Cell next = snake->head;
+			int index = snake->headIndex;
+			if (!board->neighbor(snake->direction, &next, &index) || (board->itemMatrix[index] & ITEM_TYPE_MASK) == Wall){
+				addCounter(StatsWallDeaths);
+			}else{
+				addCounter(StatsSelfDeaths);
+			}
+			int range = Board::maxMovementDelay - Board::minMovementDelay + 1;
+			int bucket = ((int)Board::maxMovementDelay - (int)board->movementDelay) * GAME_STATS_BUCKETS / range;
+			addSample(StatsDeathSpeed, bucket < 0 ? 0 : bucket);
+		}
+		break;
+	case EndBoardFull:
+		addCounter(StatsWins);
+		break;
+	default:
+		addCounter(StatsQuits);
+		break;
+	}
+
+	byte bucket = 0;
+	for (unsigned long steps = board->steps / STATS_FIRST_STEPS; steps > 0 && bucket < GAME_STATS_BUCKETS - 1; steps >>= 1){
+		bucket++;
+	}
+	addSample(StatsSteps, bucket);
+
+	//Monedas por minuto en coma fija (dieciseisavos): 60000 ms * 16. Cada moneda
+	//alarga la serpiente, que empieza con 3 bloques, también en las continuadas.
+	if (playTime > 0){
+		bucket = 0;
+		unsigned long coins = snake->blocks->size() - 3;
+		unsigned long rate = coins * 960000UL / playTime / STATS_FIRST_COIN_RATE;
+		for (; rate > 0 && bucket < GAME_STATS_BUCKETS - 1; rate >>= 1){
+			bucket++;
+		}
+		addSample(StatsCoinRate, bucket);
+	}
+
+	addTotal(StatsTotalSteps, board->steps);
+	addTotal(StatsTotalSeconds, (playTime - startTime) / 1000);
+	eeprom_queue_write(offset, data, GAME_STATS_EEPROM_SIZE);
+}
+
+unsigned int GameStats::counter(StatsCounter c){
+	const byte* p = data + STATS_COUNTERS + 2 * c;
+	return (unsigned int)p[0] << 8 | p[1];
+}
+
+unsigned long GameStats::total(StatsTotal t){
+	const byte* p = data + STATS_TOTALS + 4 * t;
+	return ((unsigned long)p[0]) << 24 | ((unsigned long)p[1]) << 16 | ((unsigned long)p[2]) << 8 | p[3];
+}
+
+const byte* GameStats::histogram(StatsHistogram h){
+	return data + STATS_HISTOGRAMS + h * GAME_STATS_BUCKETS;
+}
+
+void GameStats::addCounter(StatsCounter c){
+	unsigned int value = counter(c);
+	if (value < 0xFFFF){
+		pack_int(data + STATS_COUNTERS + 2 * c, value + 1);
+	}
+}
+
+void GameStats::addTotal(StatsTotal t, unsigned long value){
+	pack_long(data + STATS_TOTALS + 4 * t, total(t) + value);
+}
+
+void GameStats::addSample(StatsHistogram h, byte bucket){
+	byte* buckets = data + STATS_HISTOGRAMS + h * GAME_STATS_BUCKETS;
+	if (buckets[bucket] == 0xFF){
+		//Redondeando hacia arriba, para que ningún cubo con muestras quede a 0
+		for (byte i = 0; i < GAME_STATS_BUCKETS; i++){
+			buckets[i] = (buckets[i] + 1) / 2;
+		}
+	}
+	buckets[bucket]++;
+}
+
+/*
+ * Escribe una línea "nombre valor..." en el puerto serial. name apunta a una
+ * entrada de una tabla de nombres en la memoria flash.
+ */
+static void dump_line(const char* const* name, const unsigned long* values, byte count){
+	//El nombre más largo, 8 números de hasta 10 cifras y el salto de línea
+	char line[24 + GAME_STATS_BUCKETS * 11];
+	strcpy_P(line, (const char*)pgm_read_ptr(name));
+	char* c = line + strlen(line);
+	for (byte i = 0; i < count; i++){
+		*c++ = ' ';
+		ultoa(values[i], c, 10);
+		c += strlen(c);
+	}
+	*c++ = '\n';
+	Serial.write((const uint8_t*)line, c - line);
+}
+
+void GameStats::dump(){
+	unsigned long values[GAME_STATS_BUCKETS];
+	for (byte i = 0; i < StatsCounterCount; i++){
+		values[0] = counter((StatsCounter)i);
+		dump_line(&STATS_COUNTER_NAMES[i], values, 1);
+	}
+	for (byte i = 0; i < StatsTotalCount; i++){
+		values[0] = total((StatsTotal)i);
+		dump_line(&STATS_TOTAL_NAMES[i], values, 1);
+	}
+	for (byte i = 0; i < StatsHistogramCount; i++){
+		const byte* buckets = histogram((StatsHistogram)i);
+		for (byte b = 0; b < GAME_STATS_BUCKETS; b++){
+			values[b] = buckets[b];
+		}
+		dump_line(&STATS_HISTOGRAM_NAMES[i], values, GAME_STATS_BUCKETS);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la declaración de las estadísticas de juego, que
+ * muestran cómo se juega además de cuánto se puntúa: partidas por sesión, pasos
+ * por partida, monedas por minuto, tiempo entre monedas, causa de cada muerte y
+ * velocidad alcanzada. Solo cuentan las partidas de un jugador.
+ *
+ * GameScreen las alimenta con eventos (inicio y final de partida y cada moneda,
+ * nunca en cada paso), que se acumulan en RAM; al terminar cada partida, el
+ * bloque entero pasa a la EEPROM por la cola de escritura, que solo escribe los
+ * bytes que cambian.
+ *
+ * Formato (GAME_STATS_EEPROM_SIZE bytes, números en big endian):
+ *
+ *   0      formato (GAME_STATS_FORMAT si hay estadísticas guardadas)
+ *   1-12   contadores de 16 bits (véase StatsCounter)
+ *   13-24  totales de 32 bits (véase StatsTotal)
+ *   25-56  histogramas de GAME_STATS_BUCKETS cubos de 1 byte (véase StatsHistogram)
+ *
+ * Los cubos guardan frecuencias relativas en coma fija: cuando uno va a pasar de
+ * 255, todos los del histograma se dividen entre 2, de modo que la forma de la
+ * distribución se conserva sin que los cubos crezcan.
+ */
+
+#ifndef stats_hpp
+#define stats_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+#include "board.hpp"
+
+#define GAME_STATS_BUCKETS 8
+#define GAME_STATS_EEPROM_SIZE 57
+
+//Contadores de 16 bits (se saturan en 65535)
+enum StatsCounter : byte {
+	StatsSessions,
+			StatsGames,
+			//Muertes contra un muro o un borde
+			StatsWallDeaths,
+			//Muertes contra la propia serpiente
+			StatsSelfDeaths,
+			//Partidas ganadas (tablero lleno)
+			StatsWins,
+			//Partidas abandonadas desde la pausa
+			StatsQuits,
+			StatsCounterCount
+};
+
+//Totales de 32 bits
+enum StatsTotal : byte {
+	StatsTotalSteps,
+			//Tiempo de juego, en segundos
+			StatsTotalSeconds,
+			StatsTotalCoins,
+			StatsTotalCount
+};
+
+/*
+ * Histogramas. Los tres primeros tienen cubos de tamaño creciente (cada uno el
+ * doble que el anterior); el último reparte el intervalo de velocidades en cubos
+ * iguales.
+ */
+enum StatsHistogram : byte {
+	//Pasos por partida: < 16, < 32... < 1024 y el resto
+	StatsSteps,
+			//Tiempo entre monedas: < 0.5 s, < 1 s... < 32 s y el resto
+			StatsCoinGap,
+			//Monedas por minuto de cada partida: < 1, < 2... < 64 y el resto
+			StatsCoinRate,
+			//Retraso entre pasos al morir, desde el máximo (el primer cubo) hasta el mínimo
+			StatsDeathSpeed,
+			StatsHistogramCount
+};
+
+//Cómo termina una partida
+enum GameEnd : byte {
+	EndCollision,
+			EndBoardFull,
+			EndQuit
+};
+
+class GameStats {
+public:
+	void load(unsigned int offset);
+
+	//Eventos de la partida. playTime es el tiempo de juego, en milisegundos, sin pausas.
+	//Una partida continuada (véase snapshot.hpp) cuenta para la sesión pero no como otra partida.
+	void gameStarted(bool continued, unsigned long playTime);
+	void coinEaten(unsigned long playTime);
+	//Con end == EndCollision, la causa se deduce del tablero, que no cambia al chocar.
+	//Los pasos de una partida continuada se cuentan desde que se continuó, pues
+	//la partida guardada no los incluye.
+	void gameEnded(Board* board, GameEnd end, unsigned long playTime);
+
+	unsigned int counter(StatsCounter c);
+	unsigned long total(StatsTotal t);
+	const byte* histogram(StatsHistogram h);
+
+	//Envía todas las estadísticas como texto por el puerto serial, una por línea
+	void dump();
+
+	//Partidas jugadas desde que se encendió la placa
+	unsigned int sessionGames = 0;
+private:
+	unsigned int offset;
+	//Copia de los datos guardados, leída por la cola de escritura de la EEPROM
+	byte data[GAME_STATS_EEPROM_SIZE];
+	//Tiempo de juego al empezar (o continuar) la partida y al comer la última moneda
+	unsigned long startTime = 0;
+	unsigned long lastCoinTime = 0;
+
+	void addCounter(StatsCounter c);
+	void addTotal(StatsTotal t, unsigned long value);
+	void addSample(StatsHistogram h, byte bucket);
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene la implementación de la cola de escritura asíncrona
+ * de la EEPROM y de algunas funciones útiles para leer de ella.
+ */
+
+#include "storage.hpp"
+#include <EEPROM.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+/*
+ * Una escritura pendiente. Si src es null, el byte a escribir es value.
+ */
+typedef struct {
+	unsigned int offset;
+	const byte* src;
+	byte len;
+	byte value;
+} EepromJob;
+
+static EepromJob jobs[EEPROM_QUEUE_SIZE];
+static volatile byte jobHead = 0;
+static volatile byte jobCount = 0;
+static unsigned int dropped = 0;
+
+//Quien llama debe haber comprobado que queda algún hueco libre
+static void eeprom_queue_push(unsigned int offset, const byte* src, byte len, byte value){
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+		EepromJob* job = &jobs[(jobHead + jobCount) % EEPROM_QUEUE_SIZE];
+		job->offset = offset;
+		job->src = src;
+		job->len = len;
+		job->value = value;
+		jobCount++;
+
+		//Habilitar la interrupción. Si la EEPROM está libre, saltará inmediatamente.
+		EECR |= _BV(EERIE);
+	}
+}
+
+bool eeprom_queue_write(unsigned int offset, const void* src, unsigned int len){
+	//Cada trabajo guarda su longitud en un byte
+	if ((len + 0xFE) / 0xFF > eeprom_queue_room()){
+		dropped++;
+		return false;
+	}
+	const byte* bytes = (const byte*)src;
+	while (len > 0){
+		byte part = len > 0xFF ? 0xFF : len;
+		eeprom_queue_push(offset, bytes, part, 0);
+		offset += part;
+		bytes += part;
+		len -= part;
+	}
+	return true;
+}
+
+bool eeprom_queue_write_byte(unsigned int offset, byte value){
+	if (eeprom_queue_room() == 0){
+		dropped++;
+		return false;
+	}
+	eeprom_queue_push(offset, null, 1, value);
+	return true;
+}
+
+byte eeprom_queue_room(){
+	return EEPROM_QUEUE_SIZE - jobCount;
+}
+
+unsigned int eeprom_queue_dropped(){
+	return dropped;
+}
+
+bool eeprom_queue_busy(){
+	return jobCount > 0 || (EECR & _BV(EEPE));
+}
+
+void eeprom_queue_flush(){
+	while (eeprom_queue_busy());
+}
+
+/*
+ * Salta cada vez que la EEPROM está lista para una nueva escritura. En cada
+ * llamada se escribe un único byte (los que no cambian se saltan); cuando la
+ * cola queda vacía, la interrupción se deshabilita.
+ */
+ISR(EE_READY_vect){
+	while (jobCount > 0){
+		EepromJob* job = &jobs[jobHead];
+		if (job->len == 0){
+			jobHead = (jobHead + 1) % EEPROM_QUEUE_SIZE;
+			jobCount--;
+			continue;
+		}
+
+		unsigned int offset = job->offset++;
+		byte value = job->src == null ? job->value : *(job->src++);
+		job->len--;
+
+		EEAR = offset;
+		EECR |= _BV(EERE);
+		if (EEDR != value){
+			EEDR = value;
+			EECR |= _BV(EEMPE);
+			EECR |= _BV(EEPE);
+			return;
+		}
+	}
+	EECR &= ~_BV(EERIE);
+}
+
+/*
+ * La cola se detiene mientras se lee (la interrupción empezaría otra escritura
+ * en cuanto termine la actual), pero la espera a que termine la escritura en
+ * curso, de hasta 3.3 ms, se hace con las interrupciones habilitadas para no
+ * perder las del reloj de millis(). La cola solo se modifica desde el loop
+ * principal, así que nadie vuelve a habilitar la interrupción mientras tanto.
+ */
+byte eeprom_read_byte_safe(unsigned int offset){
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+		EECR &= ~_BV(EERIE);
+	}
+	while (EECR & _BV(EEPE));
+	byte b = EEPROM.read(offset);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+		if (jobCount > 0){
+			EECR |= _BV(EERIE);
+		}
+	}
+	return b;
+}
+
+int eeprom_read_int(unsigned int offset){
+	return ((int)eeprom_read_byte_safe(offset)) << 8 | eeprom_read_byte_safe(offset + 1);
+}
+
+long eeprom_read_long(unsigned int offset){
+	long l = 0;
+	for (int i = 0; i < 4; i++){
+		l <<= 8;
+		l |= eeprom_read_byte_safe(offset + i);
+	}
+	return l;
+}
+
+void pack_int(byte* dst, int value){
+	dst[0] = (value >> 8) & 0xFF;
+	dst[1] = value & 0xFF;
+}
+
+void pack_long(byte* dst, long value){
+	dst[0] = (value >> 24) & 0xFF;
+	dst[1] = (value >> 16) & 0xFF;
+	dst[2] = (value >> 8) & 0xFF;
+	dst[3] = value & 0xFF;
+}
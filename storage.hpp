@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2016 Roberto Guillén
+ *
+ * This file is part of ArduSnake.
+ *
+ * ArduSnake is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ArduSnake is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ArduSnake.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Este archivo contiene las funciones de acceso a la EEPROM utilizadas por
+ * el programa. Cada escritura en la EEPROM tarda unos 3.3 ms, así que en lugar
+ * de escribir directamente, los datos se encolan y la interrupción EE_READY
+ * los va volcando byte a byte en segundo plano, sin bloquear el loop principal.
+ */
+
+#ifndef storage_hpp
+#define storage_hpp
+
+#include "Arduino.h"
+#include "types.hpp"
+
+/*
+ * El número máximo de escrituras pendientes que puede contener la cola. Cada
+ * una de ellas puede ser un bloque de bytes completo. El peor caso del juego es
+ * el fin de una partida: la cola y la cabecera de la repetición, su hueco,
+ * las estadísticas, el borrado de la partida guardada y las dos escrituras de
+ * las puntuaciones (8), más el último byte de la repetición que aún no se haya
+ * escrito. Los huecos restantes cubren una pausa o un cambio de ajustes que
+ * lleguen antes de que termine. Encolar nunca espera: si no hay hueco, la
+ * escritura se descarta (véase eeprom_queue_dropped).
+ */
+#ifndef EEPROM_QUEUE_SIZE
+#define EEPROM_QUEUE_SIZE 12
+#endif
+
+/*
+ * Encola la escritura de len bytes, leídos desde src, a partir de la posición
+ * offset de la EEPROM. Los bytes NO se copian: se leen de src en el momento en el
+ * que se escriben, por lo que la memoria apuntada debe seguir existiendo hasta que
+ * la escritura termine (véase eeprom_queue_busy). Los bytes cuyo valor no cambie
+ * no se vuelven a escribir.
+ *
+ * Las escrituras de más de 255 bytes ocupan varios huecos de la cola. Si no caben
+ * todos, no se encola nada y se devuelve false; la función nunca espera.
+ */
+bool eeprom_queue_write(unsigned int offset, const void* src, unsigned int len);
+
+/*
+ * Encola la escritura de un único byte. A diferencia de eeprom_queue_write,
+ * el valor se guarda en la propia cola. Devuelve false si la cola está llena.
+ */
+bool eeprom_queue_write_byte(unsigned int offset, byte value);
+
+/*
+ * Devuelve el número de huecos libres de la cola, para comprobar antes de
+ * encolar varias escrituras que deben ir juntas. Solo puede aumentar hasta que
+ * se encole algo.
+ */
+byte eeprom_queue_room();
+
+/*
+ * Devuelve el número de escrituras que se han descartado porque la cola estaba
+ * llena desde que se encendió la placa.
+ */
+unsigned int eeprom_queue_dropped();
+
+/*
+ * Devuelve true si aún quedan escrituras pendientes en la cola.
+ */
+bool eeprom_queue_busy();
+
+/*
+ * Espera a que todas las escrituras pendientes se completen. Es la única
+ * función de la cola que bloquea; debe llamarse antes de reiniciar la placa
+ * para no perder datos.
+ */
+void eeprom_queue_flush();
+
+/*
+ * Lee un byte de la EEPROM. No se debe utilizar EEPROM.read directamente
+ * mientras la cola esté escribiendo, pues la lectura no es posible mientras
+ * haya una escritura en curso.
+ */
+byte eeprom_read_byte_safe(unsigned int offset);
+int eeprom_read_int(unsigned int offset);
+long eeprom_read_long(unsigned int offset);
+
+/*
+ * Guardan un valor en un buffer con el mismo formato (big endian) que
+ * utilizan las funciones de lectura de arriba.
+ */
+void pack_int(byte* dst, int value);
+void pack_long(byte* dst, long value);
+
+#endif
@@ -40,10 +40,33 @@ enum ListItemState : byte {
 			Pressed = 2
 };
 
+/*
+ * Define los posibles objetos de una celda del tablero. Los que bloquean el
+ * paso de la serpiente van al final, para que la comprobación de colisiones
+ * sea una sola comparación (>= SnakeObject).
+ */
 enum InGameItemType : byte {
 	Empty = 0,
-			SnakeObject = 1,
-			Coin = 2
+			Coin = 1,
+			SnakeObject = 2,
+			Wall = 3
+};
+
+/*
+ * Los tipos de objeto solo ocupan los bits inferiores de cada celda; el resto
+ * puede utilizarse temporalmente (véase autopilot.hpp), siempre que se limpien
+ * antes de devolver el control al juego.
+ */
+#define ITEM_TYPE_MASK 0x03
+
+/*
+ * Define los posibles modos de una partida
+ */
+enum GameMode : byte {
+	Playing = 0,
+			Replaying = 1,
+			Demo = 2,
+			TwoPlayers = 3
 };
 
 /*
@@ -75,6 +98,77 @@ extern inline Direction direction_opposite(Direction d){
 	}
 }
 
+/*
+ * Define los posibles giros de la serpiente relativos a su dirección actual.
+ */
+enum Turn : byte {
+	Straight = 0,
+			TurnLeft = 1,
+			TurnRight = 2
+};
+
+/*
+ * Obtiene la dirección resultante de aplicar el giro especificado a la dirección d.
+ */
+extern inline Direction direction_turn(Direction d, Turn t){
+	if (t == Straight) return d;
+	switch (d){
+	case Left:
+		return t == TurnLeft ? Down : Up;
+	case Right:
+		return t == TurnLeft ? Up : Down;
+	case Up:
+		return t == TurnLeft ? Left : Right;
+	case Down:
+		return t == TurnLeft ? Right : Left;
+	default:
+		return None;
+	}
+}
+
+/*
+ * Obtiene el giro necesario para pasar de la dirección from a la dirección to.
+ * Si las direcciones son opuestas, devuelve Straight.
+ */
+extern inline Turn direction_relative(Direction from, Direction to){
+	if (direction_turn(from, TurnLeft) == to) return TurnLeft;
+	if (direction_turn(from, TurnRight) == to) return TurnRight;
+	return Straight;
+}
+
+/*
+ * Generador de números pseudoaleatorios (xorshift de 32 bits). A diferencia de
+ * random(), su estado es conocido, por lo que una partida queda completamente
+ * determinada por su semilla y puede reproducirse en cualquier plataforma.
+ */
+typedef struct {
+	//uint32_t y no unsigned long, para obtener la misma secuencia fuera de AVR
+	uint32_t state;
+
+	void seed(uint32_t s){
+		state = s == 0 ? 1 : s;
+	}
+	uint32_t next(){
+		uint32_t x = state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return state = x;
+	}
+	//Devuelve un número entre 0 y max - 1 (0 si max es 0)
+	uint32_t range(uint32_t max){
+		return max == 0 ? 0 : next() % max;
+	}
+} Random;
+
+/*
+ * Representa una celda del tablero de juego por su columna y su fila (el
+ * tablero no puede tener más de 255 columnas ni filas).
+ */
+typedef struct {
+	byte x;
+	byte y;
+} Cell;
 
 /*
  * Representa el tamaño de un objeto en un espacio bidimensional
@@ -103,6 +197,17 @@ typedef struct {
 	int h;
 } Rect;
 
+/*
+ * Obtiene la intersección de dos rectángulos (con ancho o alto <= 0 si no se cortan).
+ */
+extern inline Rect rect_intersection(Rect a, Rect b){
+	int x = a.x > b.x ? a.x : b.x;
+	int y = a.y > b.y ? a.y : b.y;
+	int right = a.x + a.w < b.x + b.w ? a.x + a.w : b.x + b.w;
+	int bottom = a.y + a.h < b.y + b.h ? a.y + a.h : b.y + b.h;
+	return {x, y, right - x, bottom - y};
+}
+
 /*
  * Representa un color en formato RGB y utilizando 8 bits por canal
  */
@@ -180,7 +285,7 @@ public:
     T* tail = null;
 
     inline ~BufferedQueue(){
-    	delete buffer;
+    	free(buffer);
     }
     inline BufferedQueue(size_t capacity){
         this->_capacity = capacity;
@@ -219,13 +324,13 @@ public:
     }
 
     T* itemAtHeadOffset(size_t offset){
-    	return (T*)itemAddr(((unsigned int)head) + sizeof(T) * offset);
+    	return (T*)itemAddr(((uintptr_t)head) + sizeof(T) * offset);
     }
     T* itemAtTailOffset(size_t offset){
     	if (tail == null){
     		return itemAtHeadOffset(offset);
     	}
-        return (T*)itemAddr(((unsigned int)tail) + sizeof(T) * offset);
+        return (T*)itemAddr(((uintptr_t)tail) + sizeof(T) * offset);
     }
 
     inline size_t size(){
@@ -239,17 +344,18 @@ private:
     size_t _capacity;
     size_t _size;
 
-    inline unsigned int itemAddr(unsigned int i){
+    //uintptr_t en lugar de unsigned int para que también funcione fuera de AVR
+    inline uintptr_t itemAddr(uintptr_t i){
         if (i < bufferStartAddr())
             return (i + _capacity * sizeof(T));
         else if (i > bufferEndAddr())
             return (i - _capacity * sizeof(T));
         else return i;
     }
-    inline unsigned int bufferStartAddr(){
-         return (unsigned int)buffer;
+    inline uintptr_t bufferStartAddr(){
+         return (uintptr_t)buffer;
     }
-    inline unsigned int bufferEndAddr(){
+    inline uintptr_t bufferEndAddr(){
         return bufferStartAddr() + (_capacity - 1) * sizeof(T);
     }
 };